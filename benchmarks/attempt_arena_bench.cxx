@@ -0,0 +1,117 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Allocations per transaction for the attempt-scoped staged mutation queue, with its storage on the global heap
+// (as it was) and in the attempt's arena.  Each "transaction" stages a number of documents, looks each one up
+// again as a get would, writes the ATR's document lists and then goes away.
+//
+//   attempt_arena_bench [documents per transaction] [transactions]
+
+#include "../src/transactions/attempt_arena.hxx"
+#include "../src/transactions/staged_mutation.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+static std::atomic<size_t> allocations{ 0 };
+
+void*
+operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+using namespace couchbase::transactions;
+
+struct run_result {
+    double allocations_per_txn;
+    double us_per_txn;
+};
+
+static run_result
+run(const std::vector<staged_mutation>& mutations, size_t transactions, bool use_arena)
+{
+    atr_entry_paths paths("attempt");
+    auto start_allocations = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < transactions; t++) {
+        std::unique_ptr<attempt_arena> arena;
+        if (use_arena) {
+            arena = std::make_unique<attempt_arena>();
+        }
+        staged_mutation_queue queue(arena ? static_cast<std::pmr::memory_resource*>(arena.get()) : std::pmr::new_delete_resource());
+        for (const auto& mutation : mutations) {
+            queue.add(mutation);
+        }
+        for (const auto& mutation : mutations) {
+            if (queue.find_any(mutation.id()) == nullptr) {
+                std::abort();
+            }
+        }
+        couchbase::core::operations::mutate_in_request req{ couchbase::core::document_id("default", "_default", "_default", "atr") };
+        queue.extract_to(paths, req);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return { static_cast<double>(allocations.load() - start_allocations) / static_cast<double>(transactions),
+             static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / 1000.0 /
+               static_cast<double>(transactions) };
+}
+
+int
+main(int argc, const char* argv[])
+{
+    size_t documents = argc > 1 ? std::stoul(argv[1]) : 64;
+    size_t transactions = argc > 2 ? std::stoul(argv[2]) : 10000;
+
+    std::vector<staged_mutation> mutations;
+    for (size_t i = 0; i < documents; i++) {
+        // longer than the small string buffer, as real keys usually are
+        couchbase::core::document_id id("default", "_default", "_default", "benchmark-document-" + std::to_string(i));
+        transaction_get_result doc(id, std::string(R"({"some":"content"})"), 0, {}, std::nullopt);
+        mutations.emplace_back(doc, std::string(R"({"some":"new content"})"), staged_mutation_type::REPLACE);
+    }
+
+    // once to warm up
+    run(mutations, 10, false);
+    auto heap = run(mutations, transactions, false);
+    auto arena = run(mutations, transactions, true);
+
+    std::cout << documents << " documents per transaction, " << transactions << " transactions" << std::endl;
+    std::cout << "  global heap:   " << heap.allocations_per_txn << " allocations/txn, " << heap.us_per_txn << " us/txn" << std::endl;
+    std::cout << "  attempt arena: " << arena.allocations_per_txn << " allocations/txn, " << arena.us_per_txn << " us/txn" << std::endl;
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+// Decoding the txn xattrs and $document of a staged replace, as transaction_get_result::create_from does for each
+// document read, by parsing each field with nlohmann (as it was) and with the xattr decoder.
+//
+//   xattr_decoder_bench [iterations]
+
+#include "../src/transactions/xattr_decoder.hxx"
+
+#include <couchbase/internal/nlohmann/json.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace couchbase::transactions;
+
+// txn.id.atr, txn.id.txn, txn.id.atmpt, txn.atr.bkt, txn.atr.scp, txn.atr.coll, txn.op.type, txn.op.crc32
+static const std::vector<std::string> string_fields{
+    R"("_txn:atr-42-#4a")",
+    R"("3b6ea6d0-8a93-4a2b-a3c9-94a6ad3e1d56")",
+    R"("a8a5bd0f-6d58-4d0b-ae61-0a5e6a9d0d4d")",
+    R"("default")",
+    R"("_default")",
+    R"("_default")",
+    R"("replace")",
+    R"("0x4b4c4e5c")",
+};
+static const std::string restore_field = R"({"CAS":"0x16a1ba5e7bd20000","exptime":0,"revid":"7"})";
+static const std::string document_field =
+  R"({"CAS":"0x16a1ba5e7bd20000","vbucket_uuid":"0x0000d1b6ec88d9b4","seqno":"0x0000000000000040","revid":"7","exptime":0,)"
+  R"("value_bytes":17,"value_crc32c":"0x4b4c4e5c","flags":0,"deleted":false,"datatype":["json","xattr"],)"
+  R"("last_modified":"1653578113"})";
+
+static size_t
+decode_with_json()
+{
+    size_t sink = 0;
+    for (const auto& field : string_fields) {
+        sink += nlohmann::json::parse(field).get<std::string>().size();
+    }
+    auto restore = nlohmann::json::parse(restore_field);
+    sink += restore["CAS"].get<std::string>().size() + restore["revid"].get<std::string>().size() + restore["exptime"].get<uint32_t>();
+    auto doc = nlohmann::json::parse(document_field);
+    sink += doc["CAS"].get<std::string>().size() + doc["revid"].get<std::string>().size() + doc["exptime"].get<uint32_t>() +
+            doc["value_crc32c"].get<std::string>().size();
+    return sink;
+}
+
+static size_t
+decode_with_decoder()
+{
+    size_t sink = 0;
+    for (const auto& field : string_fields) {
+        sink += decode_json_string(field).size();
+    }
+    auto restore = decode_restore(restore_field);
+    sink += restore.cas.size() + restore.revid.size() + restore.exptime;
+    auto doc = decode_document_vattr(document_field);
+    sink += doc.cas.size() + doc.revid.size() + doc.exptime + doc.value_crc32c.size();
+    return sink;
+}
+
+template<typename Fn>
+static double
+ns_per_document(Fn&& fn, size_t iterations, size_t& sink)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        sink += fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / static_cast<double>(iterations);
+}
+
+int
+main(int argc, const char* argv[])
+{
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+    if (decode_with_json() != decode_with_decoder()) {
+        std::cerr << "decoders disagree" << std::endl;
+        return 1;
+    }
+
+    size_t sink = 0;
+    // once to warm up
+    ns_per_document(decode_with_json, 1000, sink);
+    ns_per_document(decode_with_decoder, 1000, sink);
+    auto json = ns_per_document(decode_with_json, iterations, sink);
+    auto decoder = ns_per_document(decode_with_decoder, iterations, sink);
+
+    std::cout << iterations << " documents (" << sink << ")" << std::endl;
+    std::cout << "  nlohmann::json: " << json << " ns/document" << std::endl;
+    std::cout << "  xattr decoder:  " << decoder << " ns/document" << std::endl;
+    return 0;
+}
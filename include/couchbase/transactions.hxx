@@ -16,12 +16,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <cmath>
 #include <functional>
+#include <memory>
 #include <thread>
+#include <vector>
 
+#include <asio/executor_work_guard.hpp>
+#include <asio/io_context.hpp>
 #include <core/cluster.hxx>
 #include <core/logger/logger.hxx>
+#include <couchbase/transactions/admission_stats.hxx>
 #include <couchbase/transactions/async_attempt_context.hxx>
 #include <couchbase/transactions/attempt_context.hxx>
 #include <couchbase/transactions/exceptions.hxx>
@@ -45,12 +51,22 @@ namespace transactions
      */
     class transactions_cleanup;
 
+    /** @internal
+     */
+    class admission_control;
+
     /** @brief Transaction logic should be contained in a lambda of this form */
     using logic = std::function<void(attempt_context&)>;
 
     /** @brief AsyncTransaction logic should be contained in a lambda of this form */
     using async_logic = std::function<void(async_attempt_context&)>;
 
+    /**
+     * @brief AsyncTransaction logic which finishes later, rather than when it returns.  It must call the callback
+     * once it is done (with an exception if it failed), and not use the @ref async_attempt_context after that.
+     */
+    using async_deferred_logic = std::function<void(async_attempt_context&, async_attempt_context::VoidCallback&&)>;
+
     /** @brief AsyncTransaction callback when transaction has completed */
     using txn_complete_callback = std::function<void(std::optional<transaction_exception>, std::optional<transaction_result>)>;
 
@@ -175,6 +191,20 @@ namespace transactions
 
         void run(const per_transaction_config& config, async_logic&& logic, txn_complete_callback&& cb);
 
+        /**
+         * @brief Run a transaction whose logic completes asynchronously
+         *
+         * Like @ref run(async_logic&&, txn_complete_callback&&), but the attempt is only committed (or rolled back)
+         * once the logic calls the callback it is given, rather than as soon as the lambda returns.  This is what
+         * the completion token and coroutine wrappers in async_operations.hxx are built on.
+         *
+         * @param logic The lambda containing the async transaction logic.
+         * @param cb Called when the transaction is complete.
+         */
+        void run_deferred(async_deferred_logic&& logic, txn_complete_callback&& cb);
+
+        void run_deferred(const per_transaction_config& config, async_deferred_logic&& logic, txn_complete_callback&& cb);
+
         /**
          * @internal
          * called internally - will likely move
@@ -197,7 +227,8 @@ namespace transactions
          * @brief Shut down the transactions object
          *
          * The transaction object cannot be used after this call.  Called in destructor, but
-         * available to call sooner if needed.
+         * available to call sooner if needed.  Transactions already running are allowed to finish, while any
+         * run after this fail straight away.
          */
         void close();
 
@@ -229,6 +260,34 @@ namespace transactions
             return *cleanup_;
         }
 
+        /**
+         * @brief Current admission control gauges
+         *
+         * How many transactions are running and queued, and how many have been admitted, rejected and shed so far.
+         * See @ref transaction_config::max_concurrent_transactions().
+         *
+         * @return A snapshot of the admission stats.
+         */
+        CB_NODISCARD admission_stats admission() const;
+
+        /**
+         * @internal
+         * Called internally
+         */
+        CB_NODISCARD admission_control& admission_controller()
+        {
+            return *admission_;
+        }
+
+        /**
+         * @internal
+         * True once @ref close has been called.
+         */
+        CB_NODISCARD bool closed() const
+        {
+            return closed_.load();
+        }
+
         /**
          * @brief Return a reference to the @ref core::cluster
          *
@@ -239,12 +298,29 @@ namespace transactions
             return cluster_;
         }
 
+        /**
+         * @internal
+         * The io_context that drives the asynchronous transaction state machine (retry timers, attempt
+         * scheduling).  KV completions still arrive on the cluster's own io threads.
+         */
+        CB_NODISCARD asio::io_context& io_context()
+        {
+            return *io_;
+        }
+
       private:
         core::cluster& cluster_;
         transaction_config config_;
+        // shared with the io threads, so one left running after close (see there) doesn't outlive it
+        std::shared_ptr<asio::io_context> io_{ std::make_shared<asio::io_context>() };
         std::unique_ptr<transactions_cleanup> cleanup_;
+        std::unique_ptr<admission_control> admission_;
         const size_t max_attempts_{ 1000 };
         const std::chrono::milliseconds min_retry_delay_{ 1 };
+        const size_t num_io_threads_{ 2 };
+        std::unique_ptr<asio::executor_work_guard<asio::io_context::executor_type>> work_;
+        std::vector<std::thread> io_threads_;
+        std::atomic<bool> closed_{ false };
     };
 } // namespace transactions
 } // namespace couchbase
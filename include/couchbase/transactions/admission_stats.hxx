@@ -0,0 +1,44 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace couchbase
+{
+namespace transactions
+{
+    /**
+     * @brief Admission control gauges and counters for a transactions object
+     * @volatile
+     *
+     * Returned by @ref transactions::admission().  Only meaningful when
+     * @ref transaction_config::max_concurrent_transactions() is set.
+     */
+    struct admission_stats {
+        /** @brief Transactions currently running */
+        size_t running{ 0 };
+        /** @brief Transactions currently waiting to run */
+        size_t queued{ 0 };
+        /** @brief Transactions admitted so far */
+        size_t admitted{ 0 };
+        /** @brief Transactions rejected on arrival, as the queue was full or the predicted wait too long */
+        size_t rejected{ 0 };
+        /** @brief Transactions dropped from the queue as their expiration time ran out while waiting */
+        size_t shed{ 0 };
+    };
+} // namespace transactions
+} // namespace couchbase
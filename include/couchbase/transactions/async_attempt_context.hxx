@@ -18,9 +18,11 @@
 #include <future>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include <core/operations/document_query.hxx>
 #include <couchbase/transactions/exceptions.hxx>
+#include <couchbase/transactions/staged_write_batch.hxx>
 #include <couchbase/transactions/transaction_get_result.hxx>
 #include <couchbase/transactions/transaction_query_options.hxx>
 
@@ -44,6 +46,9 @@ namespace transactions
         using Callback = std::function<void(std::exception_ptr, std::optional<transaction_get_result>)>;
         using VoidCallback = std::function<void(std::exception_ptr)>;
         using QueryCallback = std::function<void(std::exception_ptr, std::optional<core::operations::query_response>)>;
+        using MultiCallback = std::function<void(std::exception_ptr, std::vector<transaction_get_result>)>;
+        using OptionalMultiCallback = std::function<void(std::exception_ptr, std::vector<std::optional<transaction_get_result>>)>;
+        using BatchCallback = std::function<void(std::exception_ptr, std::vector<staged_write_result>)>;
         virtual ~async_attempt_context() = default;
         /**
          * Gets a document from the specified Couchbase collection matching the specified id.
@@ -61,6 +66,24 @@ namespace transactions
          */
         virtual void get_optional(const core::document_id& id, Callback&& cb) = 0;
 
+        /**
+         * Gets several documents at once.  The lookups are all issued concurrently, rather than one after the other.
+         *
+         * @param ids the documents' IDs
+         * @param cb callback function with the results, in the same order as the ids, when successful, or the first
+         *           @ref transaction_operation_failed.  Fails if any of the documents don't exist.
+         */
+        virtual void get_multi(const std::vector<core::document_id>& ids, MultiCallback&& cb) = 0;
+
+        /**
+         * Gets several documents at once, any of which may not exist.  The lookups are all issued concurrently.
+         *
+         * @param ids the documents' IDs
+         * @param cb callback function with the results, in the same order as the ids (empty for documents which
+         *           don't exist), when successful, or the first @ref transaction_operation_failed.
+         */
+        virtual void get_optional_multi(const std::vector<core::document_id>& ids, OptionalMultiCallback&& cb) = 0;
+
         /**
          * Mutates the specified document with new content, using the document's last TransactionDocument#cas().
          *
@@ -116,6 +139,19 @@ namespace transactions
          */
         virtual void remove(const transaction_get_result& document, VoidCallback&& cb) = 0;
 
+        /**
+         * Stages all the inserts, replaces and removes in a batch.
+         *
+         * Each write behaves just as the single @ref insert, @ref replace or @ref remove would, but the writes are
+         * sent without waiting for each other.  If this is the first write in the attempt, the first write in the
+         * batch is staged on its own beforehand, as it also marks the attempt pending in its ATR.
+         *
+         * @param batch the writes to stage
+         * @param cb callback function called with a result for each write, in the same order as the batch, and the
+         *           first @ref transaction_operation_failed if any of them failed.
+         */
+        virtual void stage_batch(const staged_write_batch& batch, BatchCallback&& cb) = 0;
+
         /**
          * Performs a Query, within the current transaction.
          *
@@ -0,0 +1,305 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <asio/async_result.hpp>
+#include <couchbase/transactions.hxx>
+#include <couchbase/transactions/async_attempt_context.hxx>
+
+#ifdef ASIO_HAS_CO_AWAIT
+#include <asio/awaitable.hpp>
+#include <asio/co_spawn.hpp>
+#include <asio/use_awaitable.hpp>
+#endif
+
+/**
+ * @file
+ * Asio completion token wrappers for the asynchronous transaction API.
+ *
+ * Each operation takes a completion token as its last argument, so the caller can pick how to get the result: a
+ * plain callback, asio::use_future, or (when compiled as C++20, with coroutine support in asio) asio::use_awaitable.
+ * The handler is called directly from the operation's completion, there is no extra hop through an executor.
+ * The arguments are copied into the operation, so a lazy token (such as asio::deferred, or asio::use_awaitable
+ * awaited later) can start it after they have gone - only the attempt context must still be alive.
+ *
+ * @code{.cpp}
+ * auto result = co_await async_run(
+ *   txns,
+ *   [](async_attempt_context& ctx) -> asio::awaitable<void> {
+ *       auto doc = co_await async_get(ctx, id, asio::use_awaitable);
+ *       co_await async_replace(ctx, doc, new_content, asio::use_awaitable);
+ *   },
+ *   asio::use_awaitable);
+ * @endcode
+ */
+namespace couchbase
+{
+namespace transactions
+{
+    /** @internal */
+    namespace detail
+    {
+        // The async_attempt_context callbacks are std::functions, which must be copyable, and asio handlers often
+        // aren't.  So the handler lives in a shared_ptr, and the callback just forwards to it.
+        template<typename Handler>
+        auto shared_handler(Handler&& handler)
+        {
+            return std::make_shared<std::decay_t<Handler>>(std::forward<Handler>(handler));
+        }
+
+        template<typename Handler>
+        async_attempt_context::Callback get_result_callback(Handler&& handler)
+        {
+            return [h = shared_handler(std::forward<Handler>(handler))](std::exception_ptr err,
+                                                                        std::optional<transaction_get_result> res) mutable {
+                std::move(*h)(err, res ? std::move(*res) : transaction_get_result());
+            };
+        }
+
+        template<typename Handler>
+        async_attempt_context::VoidCallback void_callback(Handler&& handler)
+        {
+            return [h = shared_handler(std::forward<Handler>(handler))](std::exception_ptr err) mutable { std::move(*h)(err); };
+        }
+
+        template<typename Handler>
+        txn_complete_callback txn_complete(Handler&& handler)
+        {
+            return [h = shared_handler(std::forward<Handler>(handler))](std::optional<transaction_exception> err,
+                                                                        std::optional<transaction_result> res) mutable {
+                if (err) {
+                    return std::move(*h)(std::make_exception_ptr(*err), err->get_transaction_result());
+                }
+                std::move(*h)(std::exception_ptr(), res.value_or(transaction_result{}));
+            };
+        }
+    } // namespace detail
+
+    /**
+     * @brief Get a document, see @ref async_attempt_context::get
+     *
+     * Completes with signature void(std::exception_ptr, transaction_get_result).
+     */
+    template<typename CompletionToken>
+    auto async_get(async_attempt_context& ctx, const core::document_id& id, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, transaction_get_result)>(
+          [&ctx, id](auto&& handler) { ctx.get(id, detail::get_result_callback(std::move(handler))); }, token);
+    }
+
+    /**
+     * @brief Get a document, which may not exist, see @ref async_attempt_context::get_optional
+     *
+     * Completes with signature void(std::exception_ptr, std::optional<transaction_get_result>).
+     */
+    template<typename CompletionToken>
+    auto async_get_optional(async_attempt_context& ctx, const core::document_id& id, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, std::optional<transaction_get_result>)>(
+          [&ctx, id](auto&& handler) {
+              ctx.get_optional(id,
+                               [h = detail::shared_handler(std::move(handler))](std::exception_ptr err,
+                                                                                std::optional<transaction_get_result> res) mutable {
+                                   std::move(*h)(err, std::move(res));
+                               });
+          },
+          token);
+    }
+
+    /**
+     * @brief Get several documents concurrently, see @ref async_attempt_context::get_multi
+     *
+     * Completes with signature void(std::exception_ptr, std::vector<transaction_get_result>).
+     */
+    template<typename CompletionToken>
+    auto async_get_multi(async_attempt_context& ctx, const std::vector<core::document_id>& ids, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, std::vector<transaction_get_result>)>(
+          [&ctx, ids](auto&& handler) {
+              ctx.get_multi(ids,
+                            [h = detail::shared_handler(std::move(handler))](std::exception_ptr err,
+                                                                             std::vector<transaction_get_result> res) mutable {
+                                std::move(*h)(err, std::move(res));
+                            });
+          },
+          token);
+    }
+
+    /**
+     * @brief Get several documents concurrently, any of which may not exist, see
+     * @ref async_attempt_context::get_optional_multi
+     *
+     * Completes with signature void(std::exception_ptr, std::vector<std::optional<transaction_get_result>>).
+     */
+    template<typename CompletionToken>
+    auto async_get_optional_multi(async_attempt_context& ctx, const std::vector<core::document_id>& ids, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, std::vector<std::optional<transaction_get_result>>)>(
+          [&ctx, ids](auto&& handler) {
+              ctx.get_optional_multi(ids,
+                                     [h = detail::shared_handler(std::move(handler))](
+                                       std::exception_ptr err, std::vector<std::optional<transaction_get_result>> res) mutable {
+                                         std::move(*h)(err, std::move(res));
+                                     });
+          },
+          token);
+    }
+
+    /**
+     * @brief Insert a document, see @ref async_attempt_context::insert
+     *
+     * Completes with signature void(std::exception_ptr, transaction_get_result).
+     */
+    template<typename Content, typename CompletionToken>
+    auto async_insert(async_attempt_context& ctx, const core::document_id& id, const Content& content, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, transaction_get_result)>(
+          [&ctx, id, content](auto&& handler) { ctx.insert(id, content, detail::get_result_callback(std::move(handler))); }, token);
+    }
+
+    /**
+     * @brief Replace a document, see @ref async_attempt_context::replace
+     *
+     * Completes with signature void(std::exception_ptr, transaction_get_result).
+     */
+    template<typename Content, typename CompletionToken>
+    auto async_replace(async_attempt_context& ctx, const transaction_get_result& document, const Content& content, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, transaction_get_result)>(
+          [&ctx, document, content](auto&& handler) {
+              ctx.replace(document, content, detail::get_result_callback(std::move(handler)));
+          },
+          token);
+    }
+
+    /**
+     * @brief Remove a document, see @ref async_attempt_context::remove
+     *
+     * Completes with signature void(std::exception_ptr).
+     */
+    template<typename CompletionToken>
+    auto async_remove(async_attempt_context& ctx, const transaction_get_result& document, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr)>(
+          [&ctx, document](auto&& handler) { ctx.remove(document, detail::void_callback(std::move(handler))); }, token);
+    }
+
+    /**
+     * @brief Stage a batch of writes, see @ref async_attempt_context::stage_batch
+     *
+     * Completes with signature void(std::exception_ptr, std::vector<staged_write_result>).
+     */
+    template<typename CompletionToken>
+    auto async_stage_batch(async_attempt_context& ctx, const staged_write_batch& batch, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, std::vector<staged_write_result>)>(
+          [&ctx, batch](auto&& handler) {
+              ctx.stage_batch(batch,
+                              [h = detail::shared_handler(std::move(handler))](std::exception_ptr err,
+                                                                               std::vector<staged_write_result> res) mutable {
+                                  std::move(*h)(err, std::move(res));
+                              });
+          },
+          token);
+    }
+
+    /**
+     * @brief Run a query, see @ref async_attempt_context::query
+     *
+     * Completes with signature void(std::exception_ptr, core::operations::query_response).
+     */
+    template<typename CompletionToken>
+    auto async_query(async_attempt_context& ctx,
+                     const std::string& statement,
+                     const transaction_query_options& options,
+                     CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, core::operations::query_response)>(
+          [&ctx, statement, options](auto&& handler) {
+              ctx.query(statement,
+                        options,
+                        [h = detail::shared_handler(std::move(handler))](std::exception_ptr err,
+                                                                         std::optional<core::operations::query_response> resp) mutable {
+                            std::move(*h)(err, resp ? std::move(*resp) : core::operations::query_response{});
+                        });
+          },
+          token);
+    }
+
+    template<typename CompletionToken>
+    auto async_query(async_attempt_context& ctx, const std::string& statement, CompletionToken&& token)
+    {
+        return async_query(ctx, statement, transaction_query_options(), std::forward<CompletionToken>(token));
+    }
+
+    /**
+     * @brief Run a transaction, see @ref transactions::run_deferred
+     *
+     * The logic is called with the attempt context and a callback, which it calls once it is done.  Completes with
+     * signature void(std::exception_ptr, transaction_result), the exception being a @ref transaction_exception.
+     */
+    template<typename CompletionToken>
+    auto async_run(transactions& txns, const per_transaction_config& config, async_deferred_logic logic, CompletionToken&& token)
+    {
+        return asio::async_initiate<CompletionToken, void(std::exception_ptr, transaction_result)>(
+          [&txns, config, logic = std::move(logic)](auto&& handler) mutable {
+              txns.run_deferred(config, std::move(logic), detail::txn_complete(std::move(handler)));
+          },
+          token);
+    }
+
+    template<typename CompletionToken>
+    auto async_run(transactions& txns, async_deferred_logic logic, CompletionToken&& token)
+    {
+        return async_run(txns, per_transaction_config(), std::move(logic), std::forward<CompletionToken>(token));
+    }
+
+#ifdef ASIO_HAS_CO_AWAIT
+    /** @brief Transaction logic written as a coroutine */
+    using awaitable_logic = std::function<asio::awaitable<void>(async_attempt_context&)>;
+
+    /**
+     * @brief Run a transaction whose logic is a coroutine
+     *
+     * The coroutine is spawned on the transactions' io_context for each attempt, and the attempt is committed once
+     * it finishes (or rolled back, if it throws).
+     */
+    template<typename CompletionToken>
+    auto async_run(transactions& txns, const per_transaction_config& config, awaitable_logic logic, CompletionToken&& token)
+    {
+        return async_run(
+          txns,
+          config,
+          async_deferred_logic([&txns, logic = std::move(logic)](async_attempt_context& ctx, async_attempt_context::VoidCallback&& done) {
+              asio::co_spawn(txns.io_context(), logic(ctx), [done = std::move(done)](std::exception_ptr err) { done(err); });
+          }),
+          std::forward<CompletionToken>(token));
+    }
+
+    template<typename CompletionToken>
+    auto async_run(transactions& txns, awaitable_logic logic, CompletionToken&& token)
+    {
+        return async_run(txns, per_transaction_config(), std::move(logic), std::forward<CompletionToken>(token));
+    }
+#endif
+} // namespace transactions
+} // namespace couchbase
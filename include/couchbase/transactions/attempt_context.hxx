@@ -17,8 +17,10 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 #include <core/cluster.hxx>
+#include <couchbase/transactions/staged_write_batch.hxx>
 #include <couchbase/transactions/transaction_get_result.hxx>
 #include <couchbase/transactions/transaction_query_options.hxx>
 
@@ -64,6 +66,28 @@ namespace transactions
          */
         virtual std::optional<transaction_get_result> get_optional(const core::document_id& id) = 0;
 
+        /**
+         * Gets several documents at once.  The lookups are all issued concurrently, rather than one after the other.
+         *
+         * @param ids the documents' IDs
+         * @return the documents, in the same order as the ids.
+         *
+         * @throws transaction_operation_failed if any of the documents don't exist, or on any other error.  It
+         *         either should not be caught by the lambda, or rethrown if it is caught.
+         */
+        virtual std::vector<transaction_get_result> get_multi(const std::vector<core::document_id>& ids) = 0;
+
+        /**
+         * Gets several documents at once, any of which may not exist.  The lookups are all issued concurrently.
+         *
+         * @param ids the documents' IDs
+         * @return the documents, in the same order as the ids, with an empty optional for any which don't exist.
+         *
+         * @throws transaction_operation_failed which either should not be caught by the lambda, or
+         *         rethrown if it is caught.
+         */
+        virtual std::vector<std::optional<transaction_get_result>> get_optional_multi(const std::vector<core::document_id>& ids) = 0;
+
         /**
          * Mutates the specified document with new content, using the document's last TransactionDocument#cas().
          *
@@ -124,6 +148,21 @@ namespace transactions
          *         rethrown if it is caught.
          */
         virtual void remove(const transaction_get_result& document) = 0;
+
+        /**
+         * Stages all the inserts, replaces and removes in a batch.
+         *
+         * Each write behaves just as the single @ref insert, @ref replace or @ref remove would, but the writes are
+         * sent without waiting for each other, rather than one after the other.
+         *
+         * @param batch the writes to stage
+         * @return a result for each write, in the same order as the batch.
+         *
+         * @throws transaction_operation_failed if any of the writes failed, the first such failure.  It either
+         *         should not be caught by the lambda, or rethrown if it is caught.
+         */
+        virtual std::vector<staged_write_result> stage_batch(const staged_write_batch& batch) = 0;
+
         /**
          * Performs a Query, within the current transaction.
          *
@@ -17,15 +17,20 @@
 #pragma once
 
 #include "atr_entry.hxx"
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <couchbase/transactions/durability_level.hxx>
 #include <couchbase/transactions/transaction_get_result.hxx>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "logging.hxx"
 
@@ -42,6 +47,44 @@ namespace transactions
     // need forward declaration for compare
     class atr_cleanup_entry;
 
+    // ATR entries whose documents have been cleaned, removed from their ATR in as few mutate_ins as possible
+    class atr_entry_removals
+    {
+      public:
+        struct removal {
+            std::string attempt_id;
+            bool pending;
+            durability_level dl;
+        };
+        // sends one mutate_in removing all of batch from the ATR, throwing client_error if it fails.  Only replaced in
+        // tests, by default it goes to the cluster.
+        using executor = std::function<void(const core::document_id& atr_id, const std::vector<removal>& batch)>;
+
+        atr_entry_removals(const core::document_id& atr_id, const transactions_cleanup& cleanup, executor execute = {});
+
+        void add(const atr_entry& entry, durability_level dl);
+        // Removes them all, at most max_specs_ subdoc specs per mutate_in.  An entry failing, or its hooks failing, only
+        // stops that entry being removed.  The first error is rethrown at the end.
+        void remove(std::shared_ptr<spdlog::logger> logger);
+        CB_NODISCARD size_t size() const
+        {
+            return removals_.size();
+        }
+
+      private:
+        // the server's limit on specs in one mutate_in
+        static constexpr size_t max_specs_ = 16;
+
+        core::document_id atr_id_;
+        const transactions_cleanup* cleanup_;
+        executor execute_;
+        std::vector<removal> removals_;
+
+        void remove_batch(std::shared_ptr<spdlog::logger> logger, size_t first, size_t last);
+        void remove_one(std::shared_ptr<spdlog::logger> logger, const removal& r);
+        void execute(const std::vector<removal>& batch);
+    };
+
     // comparator class for ordering queue
     class compare_atr_entries
     {
@@ -67,20 +110,29 @@ namespace transactions
         const atr_entry* atr_entry_;
 
         friend class compare_atr_entries;
+        friend class atr_cleanup_queue;
 
-        void check_atr_and_cleanup(std::shared_ptr<spdlog::logger> logger, transactions_cleanup_attempt* result);
+        void check_atr_and_cleanup(std::shared_ptr<spdlog::logger> logger,
+                                   transactions_cleanup_attempt* result,
+                                   atr_entry_removals* removals);
         void cleanup_docs(std::shared_ptr<spdlog::logger> logger, durability_level dl);
         void cleanup_entry(std::shared_ptr<spdlog::logger> logger, durability_level dl);
-        void commit_docs(std::shared_ptr<spdlog::logger> logger, std::optional<std::vector<doc_record>> docs, durability_level dl);
-        void remove_docs(std::shared_ptr<spdlog::logger> logger, std::optional<std::vector<doc_record>> docs, durability_level dl);
+        void commit_docs(std::shared_ptr<spdlog::logger> logger, const std::optional<std::vector<doc_record>>& docs, durability_level dl);
+        void remove_docs(std::shared_ptr<spdlog::logger> logger, const std::optional<std::vector<doc_record>>& docs, durability_level dl);
         void remove_docs_staged_for_removal(std::shared_ptr<spdlog::logger> logger,
-                                            std::optional<std::vector<doc_record>> docs,
+                                            const std::optional<std::vector<doc_record>>& docs,
                                             durability_level dl);
-        void remove_txn_links(std::shared_ptr<spdlog::logger> logger, std::optional<std::vector<doc_record>> docs, durability_level dl);
+        void remove_txn_links(std::shared_ptr<spdlog::logger> logger,
+                              const std::optional<std::vector<doc_record>>& docs,
+                              durability_level dl);
         void do_per_doc(std::shared_ptr<spdlog::logger> logger,
-                        std::vector<doc_record> docs,
+                        const std::vector<doc_record>& docs,
                         bool require_crc_to_match,
                         const std::function<void(std::shared_ptr<spdlog::logger>, transaction_get_result&, bool)>& call);
+        void do_doc(std::shared_ptr<spdlog::logger> logger,
+                    const doc_record& dr,
+                    bool require_crc_to_match,
+                    const std::function<void(std::shared_ptr<spdlog::logger>, transaction_get_result&, bool)>& call);
 
       public:
         explicit atr_cleanup_entry(attempt_context& ctx);
@@ -91,9 +143,21 @@ namespace transactions
 
         explicit atr_cleanup_entry(const core::document_id& atr_id, const std::string& attempt_id, const transactions_cleanup& cleanup);
 
-        void clean(std::shared_ptr<spdlog::logger> logger, transactions_cleanup_attempt* result = nullptr);
+        // With removals, the ATR entry is added to them rather than removed straight away, and the caller removes them.
+        void clean(std::shared_ptr<spdlog::logger> logger,
+                   transactions_cleanup_attempt* result = nullptr,
+                   atr_entry_removals* removals = nullptr);
         bool ready() const;
 
+        CB_NODISCARD const core::document_id& atr_id() const
+        {
+            return atr_id_;
+        }
+        CB_NODISCARD const std::string& attempt_id() const
+        {
+            return attempt_id_;
+        }
+
         template<typename OStream>
         friend OStream& operator<<(OStream& os, const atr_cleanup_entry& e)
         {
@@ -112,18 +176,46 @@ namespace transactions
     };
 
     // holds sorted atr entries for cleaning
+    // Entries are spread over a few shards, each its own priority queue with its own lock, so several cleanup
+    // workers (and the transactions adding to it) don't all contend on one mutex.  Each shard pops oldest first.
     class atr_cleanup_queue
     {
       private:
-        mutable std::mutex mutex_;
-        std::priority_queue<atr_cleanup_entry, std::vector<atr_cleanup_entry>, compare_atr_entries> queue_;
+        static constexpr size_t num_shards_ = 8;
+        struct shard {
+            std::mutex mutex;
+            std::priority_queue<atr_cleanup_entry, std::vector<atr_cleanup_entry>, compare_atr_entries> queue;
+        };
+        std::array<shard, num_shards_> shards_;
+        std::atomic<size_t> next_push_{ 0 };
+        std::atomic<size_t> next_pop_{ 0 };
+        std::atomic<size_t> size_{ 0 };
+        std::atomic<size_t> peak_size_{ 0 };
+
+        // workers waiting in pop_when_ready sleep until the earliest entry is due, and are woken early when an
+        // entry that is due sooner than that is pushed.  A worker taking an entry resets earliest_, so the next push
+        // always wakes one of the others.
+        std::mutex wait_mutex_;
+        std::condition_variable wait_cv_;
+        std::chrono::steady_clock::time_point earliest_{ std::chrono::steady_clock::time_point::max() };
+        bool closed_{ false };
+
+        void pushed(std::chrono::steady_clock::time_point min_start_time);
+        std::optional<std::chrono::steady_clock::time_point> next_due();
 
       public:
         // pop, but only if the front entry's min_start_time_ is before now
         std::optional<atr_cleanup_entry> pop(bool check_time = true);
+        // block until an entry is ready and pop it, or return nothing once closed
+        std::optional<atr_cleanup_entry> pop_when_ready();
+        // wake up everything waiting in pop_when_ready
+        void close();
         void push(attempt_context& ctx);
         void push(const atr_cleanup_entry& entry);
+        // current depth, without taking any locks
         size_t size() const;
+        // deepest the queue has been
+        size_t peak_size() const;
     };
 
 } // namespace transactions
@@ -126,22 +126,22 @@ namespace transactions
             return cas_;
         }
 
-        CB_NODISCARD std::optional<std::vector<doc_record>> inserted_ids() const
+        CB_NODISCARD const std::optional<std::vector<doc_record>>& inserted_ids() const
         {
             return inserted_ids_;
         }
 
-        CB_NODISCARD std::optional<std::vector<doc_record>> replaced_ids() const
+        CB_NODISCARD const std::optional<std::vector<doc_record>>& replaced_ids() const
         {
             return replaced_ids_;
         }
 
-        CB_NODISCARD std::optional<std::vector<doc_record>> removed_ids() const
+        CB_NODISCARD const std::optional<std::vector<doc_record>>& removed_ids() const
         {
             return removed_ids_;
         }
 
-        CB_NODISCARD std::optional<nlohmann::json> forward_compat() const
+        CB_NODISCARD const std::optional<nlohmann::json>& forward_compat() const
         {
             return forward_compat_;
         }
@@ -156,7 +156,7 @@ namespace transactions
             return state_;
         }
 
-        CB_NODISCARD std::optional<std::string> durability_level() const
+        CB_NODISCARD const std::optional<std::string>& durability_level() const
         {
             return durability_level_;
         }
@@ -18,6 +18,7 @@
 #include <cstdint>
 #include <string>
 
+#include "keyspace_table.hxx"
 #include "transaction_fields.hxx"
 #include <core/document_id.hxx>
 #include <couchbase/internal/nlohmann/json.hpp>
@@ -30,53 +31,66 @@ namespace transactions
     struct doc_record {
       public:
         doc_record(std::string bucket_name, std::string scope_name, std::string collection_name, std::string id)
-          : id_(std::move(bucket_name), std::move(scope_name), std::move(collection_name), (std::move(id)))
+          : keyspace_(keyspace_table::instance().intern(bucket_name, scope_name, collection_name))
+          , id_(std::move(id))
+        {
+        }
+
+        doc_record(keyspace_handle keyspace, std::string id)
+          : keyspace_(keyspace)
+          , id_(std::move(id))
         {
         }
 
         CB_NODISCARD const std::string& bucket_name() const
         {
-            return id_.bucket();
+            return keyspace_->bucket();
         }
 
         CB_NODISCARD const std::string& id() const
         {
-            return id_.key();
+            return id_;
+        }
+
+        CB_NODISCARD const std::string& collection_name() const
+        {
+            return keyspace_->collection();
         }
 
-        CB_NODISCARD const std::string collection_name() const
+        CB_NODISCARD keyspace_handle keyspace() const
         {
-            return id_.collection();
+            return keyspace_;
         }
 
-        CB_NODISCARD const core::document_id& document_id() const
+        CB_NODISCARD core::document_id document_id() const
         {
-            return id_;
+            return { keyspace_->bucket(), keyspace_->scope(), keyspace_->collection(), id_ };
         }
 
         static doc_record create_from(nlohmann::json& obj)
         {
-            std::string bucket_name = obj[ATR_FIELD_PER_DOC_BUCKET].get<std::string>();
-            std::string scope_name = obj[ATR_FIELD_PER_DOC_SCOPE].get<std::string>();
-            std::string collection_name = obj[ATR_FIELD_PER_DOC_COLLECTION].get<std::string>();
-            std::string id = obj[ATR_FIELD_PER_DOC_ID].get<std::string>();
-            return doc_record(bucket_name, scope_name, collection_name, id);
+            // an ATR lists the same few keyspaces over and over, so look them up without copying the names
+            auto keyspace = keyspace_table::instance().intern(obj[ATR_FIELD_PER_DOC_BUCKET].get_ref<const std::string&>(),
+                                                              obj[ATR_FIELD_PER_DOC_SCOPE].get_ref<const std::string&>(),
+                                                              obj[ATR_FIELD_PER_DOC_COLLECTION].get_ref<const std::string&>());
+            return doc_record(keyspace, obj[ATR_FIELD_PER_DOC_ID].get<std::string>());
         }
 
         template<typename OStream>
         friend OStream& operator<<(OStream& os, const doc_record& dr)
         {
             os << "doc_record{";
-            os << "bucket: " << dr.id_.bucket() << ",";
-            os << "scope: " << dr.id_.scope() << ",";
-            os << "collection: " << dr.id_.collection() << ",";
-            os << "key: " << dr.id_.key();
+            os << "bucket: " << dr.keyspace_->bucket() << ",";
+            os << "scope: " << dr.keyspace_->scope() << ",";
+            os << "collection: " << dr.keyspace_->collection() << ",";
+            os << "key: " << dr.id_;
             os << "}";
             return os;
         }
 
       private:
-        core::document_id id_;
+        keyspace_handle keyspace_;
+        std::string id_;
     };
 } // namespace transactions
 } // namespace couchbase
@@ -19,7 +19,9 @@
 #include "../../../../src/transactions/result.hxx"
 #include "couchbase/transactions/internal/transaction_context.hxx"
 #include <couchbase/transactions/exceptions.hxx>
+#include <chrono>
 #include <list>
+#include <optional>
 
 namespace couchbase
 {
@@ -231,6 +233,14 @@ namespace transactions
             return *this;
         }
 
+        // Retry, but only after waiting this long
+        transaction_operation_failed& retry(std::chrono::milliseconds delay)
+        {
+            retry_ = true;
+            retry_delay_ = delay;
+            return *this;
+        }
+
         // Rollback defaults to true, this sets it to false
         transaction_operation_failed& no_rollback()
         {
@@ -275,6 +285,11 @@ namespace transactions
             return retry_;
         }
 
+        std::optional<std::chrono::milliseconds> retry_delay() const
+        {
+            return retry_delay_;
+        }
+
         external_exception cause() const
         {
             return cause_;
@@ -315,6 +330,7 @@ namespace transactions
       private:
         error_class ec_;
         bool retry_;
+        std::optional<std::chrono::milliseconds> retry_delay_;
         bool rollback_;
         final_error to_raise_;
         external_exception cause_;
@@ -0,0 +1,112 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+#pragma once
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <core/document_id.hxx>
+#include <couchbase/support.hxx>
+
+namespace couchbase
+{
+namespace transactions
+{
+    /**
+     * A bucket, scope and collection, interned in the @ref keyspace_table.
+     *
+     * There is only ever one of these per distinct keyspace, and it lives as long as the process, so handles to
+     * them can be copied freely and compared (or hashed) by address.
+     */
+    class interned_keyspace
+    {
+      public:
+        interned_keyspace(std::string bucket, std::string scope, std::string collection)
+          : bucket_(std::move(bucket))
+          , scope_(std::move(scope))
+          , collection_(std::move(collection))
+        {
+        }
+
+        CB_NODISCARD const std::string& bucket() const
+        {
+            return bucket_;
+        }
+
+        CB_NODISCARD const std::string& scope() const
+        {
+            return scope_;
+        }
+
+        CB_NODISCARD const std::string& collection() const
+        {
+            return collection_;
+        }
+
+      private:
+        const std::string bucket_;
+        const std::string scope_;
+        const std::string collection_;
+    };
+
+    using keyspace_handle = const interned_keyspace*;
+
+    /**
+     * Process-wide table of interned keyspaces.
+     *
+     * A transaction touches a handful of keyspaces, but the same names turn up in every staged document, ATR
+     * entry and cleanup record.  Interning them means those carry a pointer instead of three strings, and an
+     * intern of a keyspace which is already in the table doesn't allocate.
+     */
+    class keyspace_table
+    {
+      public:
+        static keyspace_table& instance();
+
+        keyspace_handle intern(std::string_view bucket, std::string_view scope, std::string_view collection);
+
+        keyspace_handle intern(const core::document_id& id)
+        {
+            return intern(id.bucket(), id.scope(), id.collection());
+        }
+
+        CB_NODISCARD size_t size() const;
+
+      private:
+        struct key {
+            std::string_view bucket;
+            std::string_view scope;
+            std::string_view collection;
+
+            bool operator==(const key& other) const
+            {
+                return bucket == other.bucket && scope == other.scope && collection == other.collection;
+            }
+        };
+        struct key_hash {
+            size_t operator()(const key& k) const;
+        };
+
+        mutable std::shared_mutex mutex_;
+        // the keys view the strings of the keyspace they map to
+        std::unordered_map<key, std::unique_ptr<interned_keyspace>, key_hash> keyspaces_;
+    };
+} // namespace transactions
+} // namespace couchbase
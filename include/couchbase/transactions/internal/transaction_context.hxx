@@ -79,6 +79,11 @@ namespace transactions
             return transactions_.cluster_ref();
         }
 
+        CB_NODISCARD asio::io_context& io_context()
+        {
+            return transactions_.io_context();
+        }
+
         transaction_config& config()
         {
             return config_;
@@ -96,7 +101,8 @@ namespace transactions
 
         CB_NODISCARD bool has_expired_client_side();
 
-        void retry_delay();
+        // Calls fn from the io_context after a delay suitable for retrying an operation.
+        void retry_delay(std::function<void()>&& fn);
 
         CB_NODISCARD std::chrono::time_point<std::chrono::steady_clock> start_time_client() const
         {
@@ -165,6 +171,8 @@ namespace transactions
 
         void handle_error(std::exception_ptr err, txn_complete_callback&& cb);
 
+        void handle_error_after_rollback(const transaction_operation_failed& er, txn_complete_callback&& cb);
+
         std::chrono::nanoseconds remaining() const;
 
       private:
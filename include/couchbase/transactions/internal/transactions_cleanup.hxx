@@ -20,14 +20,22 @@
 #include <couchbase/transactions/transaction_config.hxx>
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #include "atr_cleanup_entry.hxx"
 #include "client_record.hxx"
 
 namespace couchbase::transactions
 {
+    class active_transaction_record;
+    class atr_read_coalescer;
+    class cleanup_pool;
+    class sweep_schedule;
+
     // only really used when we force cleanup, in tests
     class transactions_cleanup_attempt
     {
@@ -82,6 +90,17 @@ namespace couchbase::transactions
         }
     };
 
+    // what one pass over this client's share of a bucket's ATRs found
+    struct lost_attempts_sweep_stats {
+        size_t atrs_scanned{ 0 };
+        size_t atrs_found{ 0 };
+        size_t entries_found{ 0 };
+        size_t errors{ 0 };
+        std::chrono::milliseconds elapsed{ 0 };
+        // took longer than the cleanup window
+        bool overran{ false };
+    };
+
     class transactions_cleanup
     {
       public:
@@ -98,6 +117,18 @@ namespace couchbase::transactions
             return config_;
         }
 
+        // ATR reads by both cleanup threads go through here, so they share lookups of the same ATR
+        CB_NODISCARD atr_read_coalescer& atr_reads() const
+        {
+            return *atr_reads_;
+        }
+
+        // threads for the per-document work of cleaning attempts, shared by all the cleanup threads
+        CB_NODISCARD cleanup_pool& document_pool() const
+        {
+            return *document_pool_;
+        }
+
         // Add an attempt to cleanup later.
         void add_attempt(attempt_context& ctx);
 
@@ -106,6 +137,11 @@ namespace couchbase::transactions
             return atr_queue_.size();
         }
 
+        size_t cleanup_queue_peak_length() const
+        {
+            return atr_queue_.peak_size();
+        }
+
         // only used for testing.
         void force_cleanup_attempts(std::vector<transactions_cleanup_attempt>& results);
         // only used for testing
@@ -119,26 +155,40 @@ namespace couchbase::transactions
       private:
         core::cluster& cluster_;
         const transaction_config& config_;
+        std::unique_ptr<atr_read_coalescer> atr_reads_;
+        std::unique_ptr<cleanup_pool> document_pool_;
         const std::chrono::milliseconds cleanup_loop_delay_{ 100 };
+        // ATR reads a lost attempts sweep keeps in flight at once
+        const size_t max_concurrent_atr_reads_{ 16 };
+        // ready entries a client attempts worker takes off the queue at once, to clean those sharing an ATR together
+        const size_t max_cleanup_batch_{ 32 };
 
         std::thread lost_attempts_thr_;
-        std::thread cleanup_thr_;
+        std::vector<std::thread> sweep_workers_;
+        std::vector<std::thread> cleanup_workers_;
         atr_cleanup_queue atr_queue_;
         mutable std::condition_variable cv_;
         mutable std::mutex mutex_;
+        // guarded by mutex_
+        std::unique_ptr<sweep_schedule> sweeps_;
 
         const std::string client_uuid_;
 
         void attempts_loop();
+        void clean_attempts(std::vector<atr_cleanup_entry>& batch);
 
         template<class R, class P>
         bool interruptable_wait(std::chrono::duration<R, P> time);
 
         void lost_attempts_loop();
-        void clean_lost_attempts_in_bucket(const std::string& bucket_name);
+        void sweep_worker();
+        lost_attempts_sweep_stats clean_lost_attempts_in_bucket(const std::string& bucket_name);
         void create_client_record(const std::string& bucket_name);
         const atr_cleanup_stats handle_atr_cleanup(const core::document_id& atr_id,
                                                    std::vector<transactions_cleanup_attempt>* result = nullptr);
+        const atr_cleanup_stats clean_atr_entries(const core::document_id& atr_id,
+                                                  const active_transaction_record& atr,
+                                                  std::vector<transactions_cleanup_attempt>* results = nullptr);
         std::atomic<bool> running_{ false };
     };
     } // namespace couchbase::transactions
@@ -16,6 +16,8 @@
 #pragma once
 #include "../../../../src/transactions/result.hxx"
 #include "couchbase/transactions/internal/exceptions_internal.hxx"
+#include <asio/io_context.hpp>
+#include <asio/steady_timer.hpp>
 #include <chrono>
 #include <core/cluster.hxx>
 #include <core/operations.hxx>
@@ -25,6 +27,8 @@
 #include <functional>
 #include <future>
 #include <limits>
+#include <memory>
+#include <optional>
 #include <random>
 #include <string>
 #include <thread>
@@ -73,6 +77,27 @@ namespace transactions
         return id1.key() == id2.key() && id1.bucket() == id2.bucket() && id1.scope() == id2.scope() && id1.collection() == id2.collection();
     }
 
+    // hash and equality for keying unordered containers by document id
+    struct document_id_hash {
+        size_t operator()(const core::document_id& id) const
+        {
+            std::hash<std::string> hash;
+            size_t seed = hash(id.key());
+            auto combine = [&](const std::string& part) { seed ^= hash(part) + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+            combine(id.collection());
+            combine(id.scope());
+            combine(id.bucket());
+            return seed;
+        }
+    };
+
+    struct document_id_equal {
+        bool operator()(const core::document_id& id1, const core::document_id& id2) const
+        {
+            return document_ids_equal(id1, id2);
+        }
+    };
+
     template<typename OStream>
     OStream& operator<<(OStream& os, const core::document_id& id)
     {
@@ -313,7 +338,95 @@ namespace transactions
         return retry_op_constant_delay<R>(DEFAULT_RETRY_OP_DELAY, std::numeric_limits<size_t>::max(), func);
     }
 
-    struct exp_delay {
+    /**
+     * A retry_policy decides how long to wait before each retry.  next() returns the delay before the next try, or
+     * throws retry_operation_timeout or retry_operation_retries_exhausted once there should be no more tries.  The
+     * policy only computes delays - waiting them out is up to the caller, which in async code means a steady_timer
+     * (see @ref async_retry), never a sleep.
+     */
+    struct retry_policy {
+        virtual ~retry_policy() = default;
+        virtual std::chrono::nanoseconds next() const = 0;
+    };
+
+    // Returns the next delay from the policy, or nothing once it has given up.
+    static inline std::optional<std::chrono::nanoseconds> next_delay(const retry_policy& policy)
+    {
+        try {
+            return policy.next();
+        } catch (const retry_operation_timeout&) {
+            return {};
+        } catch (const retry_operation_retries_exhausted&) {
+            return {};
+        }
+    }
+
+    // Exponential backoff with jitter, giving up after max_retries.  The exponent is capped at
+    // DEFAULT_RETRY_OP_EXPONENT_CAP, so the longest delay is 2^8 * initial_delay.
+    struct exp_backoff : public retry_policy {
+        std::chrono::nanoseconds initial_delay;
+        size_t max_retries;
+        mutable size_t retries;
+
+        template<typename R, typename P>
+        exp_backoff(std::chrono::duration<R, P> initial, size_t max)
+          : initial_delay(std::chrono::duration_cast<std::chrono::nanoseconds>(initial))
+          , max_retries(max)
+          , retries(0)
+        {
+        }
+        std::chrono::nanoseconds next() const override
+        {
+            if (retries >= max_retries) {
+                throw retry_operation_retries_exhausted("retry_op hit max retries!");
+            }
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+              initial_delay * (jitter() * pow(2, fmin(DEFAULT_RETRY_OP_EXPONENT_CAP, retries++))));
+        }
+    };
+
+    // "Decorrelated jitter": each delay is random between base and 3 times the previous delay, capped at max_delay.
+    // Spreads out retries from many clients contending on the same documents better than plain exponential backoff
+    // does.  Gives up once timeout has passed since the first call, which (like exp_delay) returns zero.
+    struct decorrelated_jitter_backoff : public retry_policy {
+        std::chrono::nanoseconds base;
+        std::chrono::nanoseconds max_delay;
+        std::chrono::nanoseconds timeout;
+        mutable std::chrono::nanoseconds previous;
+        mutable std::optional<std::chrono::time_point<std::chrono::steady_clock>> end_time;
+
+        template<typename R1, typename P1, typename R2, typename P2, typename R3, typename P3>
+        decorrelated_jitter_backoff(std::chrono::duration<R1, P1> b, std::chrono::duration<R2, P2> max, std::chrono::duration<R3, P3> limit)
+          : base(std::chrono::duration_cast<std::chrono::nanoseconds>(b))
+          , max_delay(std::chrono::duration_cast<std::chrono::nanoseconds>(max))
+          , timeout(std::chrono::duration_cast<std::chrono::nanoseconds>(limit))
+          , previous(base)
+          , end_time()
+        {
+        }
+        std::chrono::nanoseconds next() const override
+        {
+            static thread_local std::mt19937_64 gen(std::random_device{}());
+            auto now = std::chrono::steady_clock::now();
+            if (!end_time) {
+                end_time = now + timeout;
+                return std::chrono::nanoseconds(0);
+            }
+            if (now > *end_time) {
+                throw retry_operation_timeout("timed out");
+            }
+            std::uniform_int_distribution<std::chrono::nanoseconds::rep> dist(base.count(), std::max(base, previous * 3).count());
+            previous = std::min(max_delay, std::chrono::nanoseconds(dist(gen)));
+            if (now + previous > *end_time) {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(*end_time - now);
+            }
+            return previous;
+        }
+    };
+
+    // Capped exponential backoff with jitter: doubles from initial_delay up to max_delay, and gives up once timeout
+    // has passed since the first call.
+    struct exp_delay : public retry_policy {
         std::chrono::nanoseconds initial_delay;
         std::chrono::nanoseconds max_delay;
         std::chrono::nanoseconds timeout;
@@ -329,28 +442,98 @@ namespace transactions
           , end_time()
         {
         }
-        void operator()() const
+        // The first call just records the end time, and returns zero.  After that, returns the next
+        // delay, or throws retry_operation_timeout once the end time has passed.
+        std::chrono::nanoseconds next() const override
         {
             auto now = std::chrono::steady_clock::now();
             if (!end_time) {
                 end_time = std::chrono::steady_clock::now() + timeout;
-                return;
+                return std::chrono::nanoseconds(0);
             }
             if (now > *end_time) {
                 throw retry_operation_timeout("timed out");
             }
-            auto delay = initial_delay * (jitter() * pow(2, retries++));
+            auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(initial_delay * (jitter() * pow(2, retries++)));
             if (delay > max_delay) {
                 delay = max_delay;
             }
             if (now + delay > *end_time) {
-                std::this_thread::sleep_for(*end_time - now);
-            } else {
-                std::this_thread::sleep_for(delay);
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(*end_time - now);
             }
+            return delay;
+        }
+
+        void operator()() const
+        {
+            std::this_thread::sleep_for(next());
         }
     };
 
+    /**
+     * Calls func from the io_context once delay has passed.  Used by the async operations to retry themselves
+     * without putting a thread to sleep.
+     */
+    template<typename Rep, typename Period>
+    void async_delay(asio::io_context& io, std::chrono::duration<Rep, Period> delay, std::function<void()> func)
+    {
+        auto timer = std::make_shared<asio::steady_timer>(io);
+        timer->expires_after(std::chrono::duration_cast<std::chrono::nanoseconds>(delay));
+        timer->async_wait([timer, func = std::move(func)](std::error_code) { func(); });
+    }
+
+    using async_retry_handler = std::function<void(std::exception_ptr)>;
+    using async_retry_func = std::function<void(async_retry_handler)>;
+
+    /**
+     * Calls func with a handler, which it calls when done.  If it was handed a retry_operation, func is called again
+     * once the policy's next delay has passed on a steady_timer, so no thread ever sleeps between tries.  When the
+     * policy gives up, cb gets the retry_operation_timeout or retry_operation_retries_exhausted it threw.  Anything
+     * else (including no error) is passed straight on to cb.
+     */
+    static inline void async_retry(asio::io_context& io,
+                                   std::shared_ptr<const retry_policy> policy,
+                                   async_retry_func func,
+                                   async_retry_handler cb)
+    {
+        func([&io, policy, func, cb](std::exception_ptr err) {
+            if (err) {
+                try {
+                    std::rethrow_exception(err);
+                } catch (const retry_operation&) {
+                    std::chrono::nanoseconds delay;
+                    try {
+                        delay = policy->next();
+                    } catch (...) {
+                        return cb(std::current_exception());
+                    }
+                    return async_delay(io, delay, [&io, policy, func, cb]() { async_retry(io, policy, func, cb); });
+                } catch (...) {
+                    // not retryable, fall through
+                }
+            }
+            return cb(err);
+        });
+    }
+
+    /**
+     * Asynchronous counterpart of @ref retry_op_exponential_backoff, see @ref async_retry.
+     */
+    template<typename Rep, typename Period>
+    void async_retry_op_exponential_backoff(asio::io_context& io,
+                                            std::chrono::duration<Rep, Period> delay,
+                                            size_t max_retries,
+                                            async_retry_func func,
+                                            async_retry_handler cb)
+    {
+        async_retry(io, std::make_shared<exp_backoff>(delay, max_retries), std::move(func), std::move(cb));
+    }
+
+    static inline void async_retry_op_exp(asio::io_context& io, async_retry_func func, async_retry_handler cb)
+    {
+        async_retry_op_exponential_backoff(io, DEFAULT_RETRY_OP_EXP_DELAY, DEFAULT_RETRY_OP_MAX_RETRIES, std::move(func), std::move(cb));
+    }
+
     template<typename R, typename P>
     struct constant_delay {
         std::chrono::duration<R, P> delay;
@@ -84,6 +84,17 @@ class per_transaction_config
         return custom_metadata_collection_;
     }
 
+    per_transaction_config& max_concurrent_unstaging(size_t max)
+    {
+        max_concurrent_unstaging_ = max;
+        return *this;
+    }
+
+    std::optional<size_t> max_concurrent_unstaging()
+    {
+        return max_concurrent_unstaging_;
+    }
+
     transaction_config apply(const transaction_config& conf) const
     {
         transaction_config retval = conf;
@@ -102,6 +113,9 @@ class per_transaction_config
         if (custom_metadata_collection_) {
             retval.custom_metadata_collection(*custom_metadata_collection_);
         }
+        if (max_concurrent_unstaging_) {
+            retval.max_concurrent_unstaging(*max_concurrent_unstaging_);
+        }
         return retval;
     }
 
@@ -111,6 +125,7 @@ class per_transaction_config
     std::optional<milliseconds> kv_timeout_;
     std::optional<nanoseconds> expiration_time_;
     std::optional<transaction_keyspace> custom_metadata_collection_;
+    std::optional<size_t> max_concurrent_unstaging_;
 };
 
 } // namespace couchbase::transactions
@@ -0,0 +1,134 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+#pragma once
+
+#include <exception>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <core/document_id.hxx>
+#include <couchbase/transactions/transaction_get_result.hxx>
+
+namespace couchbase
+{
+namespace transactions
+{
+    /**
+     * @brief A set of inserts, replaces and removes to be staged together
+     * @volatile
+     *
+     * Build one up, then pass it to @ref attempt_context::stage_batch or @ref async_attempt_context::stage_batch.
+     * The staging writes are pipelined, rather than waiting for each one before sending the next.
+     *
+     * @code{.cpp}
+     * staged_write_batch batch;
+     * batch.insert(id1, content1).replace(doc2, content2).remove(doc3);
+     * auto results = ctx.stage_batch(batch);
+     * @endcode
+     */
+    class staged_write_batch
+    {
+      public:
+        enum class write_type { INSERT, REPLACE, REMOVE };
+
+        /** @internal */
+        struct write {
+            write_type type;
+            core::document_id id;
+            std::optional<transaction_get_result> document;
+            std::string content;
+        };
+
+        /**
+         * Adds an insert of a new document, see @ref attempt_context::insert
+         *
+         * @param id the document's unique ID
+         * @param content the content to insert
+         */
+        template<typename Content>
+        staged_write_batch& insert(const core::document_id& id, const Content& content)
+        {
+            writes_.push_back({ write_type::INSERT, id, std::nullopt, default_json_serializer::serialize(content) });
+            return *this;
+        }
+
+        /**
+         * Adds a replace of an existing document, see @ref attempt_context::replace
+         *
+         * @param document the doc to be updated
+         * @param content the content to replace the doc with
+         */
+        template<typename Content>
+        staged_write_batch& replace(const transaction_get_result& document, const Content& content)
+        {
+            writes_.push_back({ write_type::REPLACE, document.id(), document, default_json_serializer::serialize(content) });
+            return *this;
+        }
+
+        /**
+         * Adds a remove of an existing document, see @ref attempt_context::remove
+         *
+         * @param document the document to be removed
+         */
+        staged_write_batch& remove(const transaction_get_result& document)
+        {
+            writes_.push_back({ write_type::REMOVE, document.id(), document, {} });
+            return *this;
+        }
+
+        CB_NODISCARD size_t size() const
+        {
+            return writes_.size();
+        }
+
+        CB_NODISCARD bool empty() const
+        {
+            return writes_.empty();
+        }
+
+        /** @internal */
+        CB_NODISCARD const std::vector<write>& writes() const
+        {
+            return writes_;
+        }
+
+      private:
+        std::vector<write> writes_;
+    };
+
+    /**
+     * @brief The outcome of one write in a @ref staged_write_batch
+     * @volatile
+     */
+    struct staged_write_result {
+        /** @brief The document with its new CAS, for a successful insert or replace */
+        std::optional<transaction_get_result> document;
+        /**
+         * @brief Set if this write was not staged
+         *
+         * Holds a @ref transaction_operation_failed, the same one the single operation would have failed with.
+         */
+        std::exception_ptr error;
+
+        CB_NODISCARD bool success() const
+        {
+            return !error;
+        }
+    };
+} // namespace transactions
+} // namespace couchbase
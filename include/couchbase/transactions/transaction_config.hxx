@@ -183,6 +183,30 @@ namespace transactions
             return cleanup_lost_attempts_;
         }
 
+        /**
+         * @brief Set the number of lost attempts cleanup threads.
+         * @see @ref cleanup_lost_attempts_workers()
+         *
+         * @param workers Number of threads sweeping buckets for lost attempts.  0 is treated as 1.
+         */
+        void cleanup_lost_attempts_workers(size_t workers)
+        {
+            cleanup_lost_attempts_workers_ = workers;
+        }
+
+        /**
+         * @brief Get the number of lost attempts cleanup threads.
+         *
+         * When @ref cleanup_lost_attempts() is enabled, this many threads share the sweeps of the open buckets, each
+         * taking whichever bucket is due next.  A slow bucket only holds up the thread sweeping it.
+         *
+         * @return The number of lost attempts cleanup threads.
+         */
+        CB_NODISCARD size_t cleanup_lost_attempts_workers() const
+        {
+            return cleanup_lost_attempts_workers_;
+        }
+
         /**
          * @brief Set state for the client attempts cleanup loop.
          * @see @ref cleanup_client_attempts()
@@ -207,6 +231,127 @@ namespace transactions
             return cleanup_client_attempts_;
         }
 
+        /**
+         * @brief Set the number of client attempts cleanup threads.
+         * @see @ref cleanup_client_attempts_workers()
+         *
+         * @param workers Number of threads cleaning this client's failed attempts.  0 is treated as 1.
+         */
+        void cleanup_client_attempts_workers(size_t workers)
+        {
+            cleanup_client_attempts_workers_ = workers;
+        }
+
+        /**
+         * @brief Get the number of client attempts cleanup threads.
+         *
+         * When @ref cleanup_client_attempts() is enabled, this many threads take the transactions object's failed
+         * attempts off the cleanup queue, oldest first, and clean them concurrently.
+         *
+         * @return The number of client attempts cleanup threads.
+         */
+        CB_NODISCARD size_t cleanup_client_attempts_workers() const
+        {
+            return cleanup_client_attempts_workers_;
+        }
+
+        /**
+         * @brief Set the maximum number of documents cleanup works on concurrently.
+         * @see @ref cleanup_concurrent_documents()
+         *
+         * @param max Maximum number of documents cleaned concurrently.  1 means one at a time.
+         */
+        void cleanup_concurrent_documents(size_t max)
+        {
+            cleanup_concurrent_documents_ = max;
+        }
+
+        /**
+         * @brief Get the maximum number of documents cleanup works on concurrently.
+         *
+         * Cleaning up a lost or failed attempt means fixing up each of its documents in turn.  Cleanup works on up
+         * to this many documents at once, across all the attempts it is cleaning.
+         *
+         * @return The maximum number of documents cleaned concurrently.
+         */
+        CB_NODISCARD size_t cleanup_concurrent_documents() const
+        {
+            return cleanup_concurrent_documents_;
+        }
+
+        /**
+         * @brief Set the maximum number of staged mutations unstaged concurrently.
+         * @see @ref max_concurrent_unstaging()
+         *
+         * @param max Maximum number of documents committed concurrently.  1 means one at a time.
+         */
+        void max_concurrent_unstaging(size_t max)
+        {
+            max_concurrent_unstaging_ = max;
+        }
+
+        /**
+         * @brief Get the maximum number of staged mutations unstaged concurrently.
+         *
+         * Once a transaction has reached its commit point, the staged mutations are written to the documents.
+         * Up to this many of those writes are in flight at once.  The number actually in flight shrinks when the
+         * cluster returns transient or ambiguous errors, and grows back as writes succeed.
+         *
+         * @return The maximum number of concurrent unstaging writes.
+         */
+        CB_NODISCARD size_t max_concurrent_unstaging() const
+        {
+            return max_concurrent_unstaging_;
+        }
+
+        /**
+         * @brief Set the maximum number of transactions run concurrently.
+         * @see @ref max_concurrent_transactions()
+         *
+         * @param max Maximum number of transactions run at once by a transactions object.  0 means no limit.
+         */
+        void max_concurrent_transactions(size_t max)
+        {
+            max_concurrent_transactions_ = max;
+        }
+
+        /**
+         * @brief Get the maximum number of transactions run concurrently.
+         *
+         * Once this many transactions are running, new ones wait in a queue until one finishes.  A transaction is
+         * rejected straight away if the queue is full, or if the predicted wait is longer than its expiration time,
+         * and is shed if it is still queued when its expiration time runs out.  Defaults to 0, meaning no limit.
+         *
+         * @return The maximum number of concurrent transactions, or 0 if there is no limit.
+         */
+        CB_NODISCARD size_t max_concurrent_transactions() const
+        {
+            return max_concurrent_transactions_;
+        }
+
+        /**
+         * @brief Set the maximum number of transactions waiting to run.
+         * @see @ref max_concurrent_transactions()
+         *
+         * @param max Maximum number of transactions waiting for one of the running ones to finish.
+         */
+        void max_queued_transactions(size_t max)
+        {
+            max_queued_transactions_ = max;
+        }
+
+        /**
+         * @brief Get the maximum number of transactions waiting to run.
+         *
+         * Only used when @ref max_concurrent_transactions() is set.
+         *
+         * @return The maximum number of queued transactions.
+         */
+        CB_NODISCARD size_t max_queued_transactions() const
+        {
+            return max_queued_transactions_;
+        }
+
         void custom_metadata_collection(const transaction_keyspace& keyspace)
         {
             custom_metadata_collection_ = keyspace;
@@ -258,6 +403,12 @@ namespace transactions
         std::unique_ptr<cleanup_testing_hooks> cleanup_hooks_;
         core::query_scan_consistency scan_consistency_;
         std::optional<transaction_keyspace> custom_metadata_collection_;
+        size_t max_concurrent_unstaging_;
+        size_t max_concurrent_transactions_;
+        size_t max_queued_transactions_;
+        size_t cleanup_client_attempts_workers_;
+        size_t cleanup_concurrent_documents_;
+        size_t cleanup_lost_attempts_workers_;
     };
 } // namespace transactions
 } // namespace couchbase
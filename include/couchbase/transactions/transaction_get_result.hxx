@@ -22,6 +22,7 @@
 #include <couchbase/transactions/document_metadata.hxx>
 #include <couchbase/transactions/transaction_links.hxx>
 #include <couchbase/transactions/transcoder.hxx>
+#include <memory>
 #include <ostream>
 #include <utility>
 
@@ -37,13 +38,14 @@ namespace transactions
     class transaction_get_result
     {
       private:
-        std::string value_;
+        // Immutable and shared, so copying a result (into a staged mutation, or back out to the caller) doesn't copy the body.
+        std::shared_ptr<const std::string> value_;
         core::document_id id_;
         uint64_t cas_;
         transaction_links links_;
 
         /** This is needed for provide {BACKUP-FIELDS}.  It is only needed from the get to the staged mutation, hence Optional. */
-        const std::optional<document_metadata> metadata_;
+        std::optional<document_metadata> metadata_;
 
       public:
         /**
@@ -56,14 +58,10 @@ namespace transactions
         }
 
         /** @internal */
-        transaction_get_result(const transaction_get_result& doc)
-          : value_(doc.value_)
-          , id_(doc.id_)
-          , cas_(doc.cas_)
-          , links_(doc.links_)
-          , metadata_(doc.metadata_)
-        {
-        }
+        transaction_get_result(const transaction_get_result& doc) = default;
+
+        /** @internal */
+        transaction_get_result(transaction_get_result&& doc) = default;
 
         /** @internal */
         template<typename Content>
@@ -72,8 +70,22 @@ namespace transactions
                                uint64_t cas,
                                transaction_links links,
                                std::optional<document_metadata> metadata)
+          : value_(std::make_shared<const std::string>(std::move(content)))
+          , id_(id)
+          , cas_(cas)
+          , links_(std::move(links))
+          , metadata_(std::move(metadata))
+        {
+        }
+
+        /** @internal */
+        transaction_get_result(const core::document_id& id,
+                               std::shared_ptr<const std::string> content,
+                               uint64_t cas,
+                               transaction_links links,
+                               std::optional<document_metadata> metadata)
           : value_(std::move(content))
-          , id_(std::move(id))
+          , id_(id)
           , cas_(cas)
           , links_(std::move(links))
           , metadata_(std::move(metadata))
@@ -94,39 +106,27 @@ namespace transactions
                 }
             }
             if (json.contains("doc")) {
-                value_ = json["doc"].dump();
+                value_ = std::make_shared<const std::string>(json["doc"].dump());
             }
         }
 
-        transaction_get_result& operator=(const transaction_get_result& o)
-        {
-            value_ = o.value_;
-            id_ = o.id_;
-            cas_ = o.cas_;
-            links_ = o.links_;
-            return *this;
-        }
+        transaction_get_result& operator=(const transaction_get_result& o) = default;
+
+        transaction_get_result& operator=(transaction_get_result&& o) = default;
 
         /** @internal */
         template<typename Content>
         static transaction_get_result create_from(const transaction_get_result& document, Content content)
         {
-            transaction_links links(document.links().atr_id(),
-                                    document.links().atr_bucket_name(),
-                                    document.links().atr_scope_name(),
-                                    document.links().atr_collection_name(),
-                                    document.links().staged_transaction_id(),
-                                    document.links().staged_attempt_id(),
-                                    document.links().staged_content(),
-                                    document.links().cas_pre_txn(),
-                                    document.links().revid_pre_txn(),
-                                    document.links().exptime_pre_txn(),
-                                    document.links().crc32_of_staging(),
-                                    document.links().op(),
-                                    document.links().forward_compat(),
-                                    document.links().is_deleted());
+            return create_from(document, std::make_shared<const std::string>(std::move(content)));
+        }
 
-            return { document.id(), content, document.cas(), links, document.metadata() };
+        /** @internal */
+        static transaction_get_result create_from(const transaction_get_result& document, std::shared_ptr<const std::string> content)
+        {
+            transaction_get_result result(document);
+            result.value_ = std::move(content);
+            return result;
         }
 
         /** @internal */
@@ -189,12 +189,19 @@ namespace transactions
         template<typename Content>
         CB_NODISCARD Content content() const
         {
-            return default_json_serializer::deserialize<Content>(value_);
+            static const std::string empty;
+            return default_json_serializer::deserialize<Content>(value_ ? *value_ : empty);
         }
 
         void content(const std::string& content)
         {
-            value_ = content;
+            value_ = std::make_shared<const std::string>(content);
+        }
+
+        /** @internal */
+        CB_NODISCARD const std::shared_ptr<const std::string>& content_buffer() const
+        {
+            return value_;
         }
 
         /**
@@ -218,7 +225,7 @@ namespace transactions
         }
 
         /** @internal */
-        CB_NODISCARD transaction_links links() const
+        CB_NODISCARD const transaction_links& links() const
         {
             return links_;
         }
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <memory>
 #include <ostream>
 #include <string>
 
@@ -39,7 +40,8 @@ namespace transactions
         // id of the transaction that has staged content
         std::optional<std::string> staged_transaction_id_;
         std::optional<std::string> staged_attempt_id_;
-        std::optional<std::string> staged_content_;
+        // shared with the staged mutation and any results built from these links, never modified
+        std::shared_ptr<const std::string> staged_content_;
 
         // for {BACKUP_FIELDS}
         std::optional<std::string> cas_pre_txn_;
@@ -72,7 +74,7 @@ namespace transactions
           , atr_collection_name_(std::move(atr_collection_name))
           , staged_transaction_id_(std::move(staged_transaction_id))
           , staged_attempt_id_(std::move(staged_attempt_id))
-          , staged_content_(std::move(staged_content))
+          , staged_content_(staged_content ? std::make_shared<const std::string>(std::move(*staged_content)) : nullptr)
           , cas_pre_txn_(std::move(cas_pre_txn))
           , revid_pre_txn_(std::move(revid_pre_txn))
           , exptime_pre_txn_(exptime_pre_txn)
@@ -210,9 +212,20 @@ namespace transactions
             return crc32_of_staging_;
         }
 
-        CB_NODISCARD std::string staged_content() const
+        CB_NODISCARD const std::string& staged_content() const
         {
-            return staged_content_ ? *staged_content_ : "";
+            static const std::string empty;
+            return staged_content_ ? *staged_content_ : empty;
+        }
+
+        CB_NODISCARD const std::shared_ptr<const std::string>& staged_content_buffer() const
+        {
+            return staged_content_;
+        }
+
+        void staged_content(std::shared_ptr<const std::string> content)
+        {
+            staged_content_ = std::move(content);
         }
 
         CB_NODISCARD std::optional<nlohmann::json> forward_compat() const
@@ -15,6 +15,7 @@
  */
 
 #include "active_transaction_record.hxx"
+#include "xattr_decoder.hxx"
 #include "couchbase/transactions/internal/exceptions_internal.hxx"
 #include "couchbase/transactions/internal/utils.hxx"
 #include <core/cluster.hxx>
@@ -29,42 +30,116 @@ namespace couchbase
 {
 namespace transactions
 {
+    active_transaction_record::active_transaction_record(const core::document_id& id, uint64_t, std::vector<atr_entry> entries)
+      : active_transaction_record(id)
+    {
+        std::call_once(decoded_->once, [&]() { decoded_->entries = std::move(entries); });
+    }
 
-    /*
-        inline active_transaction_record active_transaction_record::map_to_atr(const couchbase::document_id& atr_id,
-                                                                               result& res,
-                                                                               nlohmann::json& attempts)
-        {
-            auto vbucket = res.values[1].content_as<nlohmann::json>();
-            auto now_ns = now_ns_from_vbucket(vbucket);
+    active_transaction_record::active_transaction_record(const core::document_id& id)
+      : id_(id)
+      , decoded_(std::make_shared<decoded_entries>())
+    {
+    }
+
+    active_transaction_record active_transaction_record::from_attempts(const core::document_id& id, std::string attempts, uint64_t now_ns)
+    {
+        active_transaction_record atr(id);
+        atr.now_ns_ = now_ns;
+        atr.attempts_ = std::make_shared<const std::string>(std::move(attempts));
+        bool indexed = for_each_json_member(*atr.attempts_, [&atr](std::string_view attempt_id, std::string_view entry) {
+            atr.index_.emplace_back(attempt_id, entry);
+            return true;
+        });
+        if (!indexed) {
+            // not in the form we can index, so parse all of it now, which also throws if it isn't valid
+            auto parsed = nlohmann::json::parse(*atr.attempts_);
+            std::vector<atr_entry> entries;
+            entries.reserve(parsed.size());
+            for (auto& element : parsed.items()) {
+                entries.push_back(atr.decode_entry(element.key(), element.value()));
+            }
+            std::call_once(atr.decoded_->once, [&]() { atr.decoded_->entries = std::move(entries); });
+            atr.attempts_.reset();
+            atr.index_.clear();
+        }
+        return atr;
+    }
+
+    std::optional<atr_entry> active_transaction_record::find_entry(const std::string& attempt_id) const
+    {
+        if (!attempts_) {
+            for (const auto& entry : entries()) {
+                if (entry.attempt_id() == attempt_id) {
+                    return entry;
+                }
+            }
+            return {};
+        }
+        for (const auto& [id, entry] : index_) {
+            if (id == attempt_id) {
+                auto val = nlohmann::json::parse(entry);
+                return decode_entry(attempt_id, val);
+            }
+        }
+        return {};
+    }
+
+    const std::vector<atr_entry>& active_transaction_record::entries() const
+    {
+        std::call_once(decoded_->once, [this]() {
+            // decode into a local, so if one throws the next call starts again rather than appending to a partial list
             std::vector<atr_entry> entries;
-            entries.reserve(attempts.size());
-            for (auto& element : attempts.items()) {
-                auto& val = element.value();
-                entries.emplace_back(
-                  atr_id.bucket(),
-                  atr_id.key(),
-                  element.key(),
-                  attempt_state_value(val[ATR_FIELD_STATUS].get<std::string>()),
-                  parse_mutation_cas(val.value(ATR_FIELD_START_TIMESTAMP, "")),
-                  parse_mutation_cas(val.value(ATR_FIELD_START_COMMIT, "")),
-                  parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_COMPLETE, "")),
-                  parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_ROLLBACK_START, "")),
-                  parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_ROLLBACK_COMPLETE, "")),
-                  val.count(ATR_FIELD_EXPIRES_AFTER_MSECS) ? std::make_optional(val[ATR_FIELD_EXPIRES_AFTER_MSECS].get<std::uint32_t>())
-                                                           : std::optional<std::uint32_t>(),
-                  process_document_ids(val, ATR_FIELD_DOCS_INSERTED),
-                  process_document_ids(val, ATR_FIELD_DOCS_REPLACED),
-                  process_document_ids(val, ATR_FIELD_DOCS_REMOVED),
-                  val.contains(ATR_FIELD_FORWARD_COMPAT) ? std::make_optional(val[ATR_FIELD_FORWARD_COMPAT].get<nlohmann::json>())
-                                                         : std::nullopt,
-                  now_ns,
-                  val.contains(ATR_FIELD_DURABILITY_LEVEL) ? std::make_optional(val[ATR_FIELD_DURABILITY_LEVEL].get<nlohmann::json>())
-                     : std::nullopt);
+            entries.reserve(index_.size());
+            for (const auto& [id, entry] : index_) {
+                auto val = nlohmann::json::parse(entry);
+                entries.push_back(decode_entry(std::string(id), val));
             }
-            return active_transaction_record(atr_id, res.cas, std::move(entries));
+            decoded_->entries = std::move(entries);
+        });
+        return decoded_->entries;
+    }
+
+    atr_entry active_transaction_record::decode_entry(const std::string& attempt_id, nlohmann::json& val) const
+    {
+        return { id_.bucket(),
+                 id_.key(),
+                 attempt_id,
+                 attempt_state_value(val[ATR_FIELD_STATUS].get<std::string>()),
+                 parse_mutation_cas(val.value(ATR_FIELD_START_TIMESTAMP, "")),
+                 parse_mutation_cas(val.value(ATR_FIELD_START_COMMIT, "")),
+                 parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_COMPLETE, "")),
+                 parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_ROLLBACK_START, "")),
+                 parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_ROLLBACK_COMPLETE, "")),
+                 val.count(ATR_FIELD_EXPIRES_AFTER_MSECS) ? std::make_optional(val[ATR_FIELD_EXPIRES_AFTER_MSECS].get<std::uint32_t>())
+                                                          : std::optional<std::uint32_t>(),
+                 process_document_ids(val, ATR_FIELD_DOCS_INSERTED),
+                 process_document_ids(val, ATR_FIELD_DOCS_REPLACED),
+                 process_document_ids(val, ATR_FIELD_DOCS_REMOVED),
+                 val.contains(ATR_FIELD_FORWARD_COMPAT) ? std::make_optional(val[ATR_FIELD_FORWARD_COMPAT].get<nlohmann::json>())
+                                                        : std::nullopt,
+                 now_ns_,
+                 val.contains(ATR_FIELD_DURABILITY_LEVEL) ? std::make_optional(val[ATR_FIELD_DURABILITY_LEVEL].get<nlohmann::json>())
+                                                          : std::nullopt };
+    }
+
+    active_transaction_record active_transaction_record::map_to_atr(const core::operations::lookup_in_response& resp)
+    {
+        core::document_id id{ resp.ctx.bucket(), resp.ctx.scope(), resp.ctx.collection(), resp.ctx.id() };
+        if (resp.fields[0].status != key_value_status_code::success) {
+            return { id, resp.cas.value(), {} };
         }
+        auto vbucket = default_json_serializer::deserialize<nlohmann::json>(to_string(resp.fields[1].value));
+        return from_attempts(id, to_string(resp.fields[0].value), now_ns_from_vbucket(vbucket));
+    }
 
-    */
+    atr_entry active_transaction_record::map_to_entry(const core::operations::lookup_in_response& resp, const std::string& attempt_id)
+    {
+        active_transaction_record atr({ resp.ctx.bucket(), resp.ctx.scope(), resp.ctx.collection(), resp.ctx.id() });
+        auto vbucket = default_json_serializer::deserialize<nlohmann::json>(to_string(resp.fields[1].value));
+        atr.now_ns_ = now_ns_from_vbucket(vbucket);
+        auto val = nlohmann::json::parse(to_string_view(resp.fields[0].value));
+        return atr.decode_entry(attempt_id, val);
+    }
 } // namespace transactions
 } // namespace couchbase
@@ -16,9 +16,13 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "result.hxx"
 #include <core/cluster.hxx>
@@ -82,20 +86,93 @@ namespace transactions
             return f.get();
         }
 
-        active_transaction_record(const core::document_id& id, uint64_t, std::vector<atr_entry> entries)
-          : id_(std::move(id))
-          , entries_(std::move(entries))
+        /**
+         * Reads the entry of one attempt, rather than the whole ATR.  Calls back with no entry, and no error, if the
+         * ATR or the entry doesn't exist.  Only when the entry can't be looked up by its path is the whole ATR read.
+         */
+        template<typename Callback>
+        static void get_atr_entry(core::cluster& cluster, const core::document_id& atr_id, const std::string& attempt_id, Callback&& cb)
         {
+            if (attempt_id.empty()) {
+                return cb({}, std::nullopt);
+            }
+            if (attempt_id.find_first_of(".[]`") != std::string::npos) {
+                return get_entry_from_atr(cluster, atr_id, attempt_id, std::forward<Callback>(cb));
+            }
+            core::operations::lookup_in_request req{ atr_id };
+            req.specs =
+              lookup_in_specs{
+                  lookup_in_specs::get(ATR_FIELD_ATTEMPTS + "." + attempt_id).xattr(),
+                  // the entry's timestamps are compared to the server's clock
+                  lookup_in_specs::get("$vbucket").xattr(),
+              }
+                .specs();
+            cluster.execute(req, [&cluster, atr_id, attempt_id, cb = std::move(cb)](core::operations::lookup_in_response resp) mutable {
+                if (resp.ctx.ec() == couchbase::errc::key_value::document_not_found) {
+                    return cb({}, std::nullopt);
+                }
+                if (resp.ctx.ec()) {
+                    return cb(resp.ctx.ec(), std::nullopt);
+                }
+                std::error_code ec;
+                std::optional<atr_entry> entry;
+                switch (resp.fields[0].status) {
+                    case key_value_status_code::success:
+                        try {
+                            entry = map_to_entry(resp, attempt_id);
+                        } catch (const std::exception&) {
+                            // a corrupt entry, see get_atr
+                            ec = couchbase::errc::key_value::path_invalid;
+                        }
+                        return cb(ec, std::move(entry));
+                    case key_value_status_code::subdoc_path_not_found:
+                        return cb(ec, std::move(entry));
+                    default:
+                        // the server couldn't find the entry by its path
+                        return get_entry_from_atr(cluster, atr_id, attempt_id, std::move(cb));
+                }
+            });
         }
 
-        CB_NODISCARD const std::vector<atr_entry>& entries() const
+        active_transaction_record(const core::document_id& id, uint64_t, std::vector<atr_entry> entries);
+
+        /**
+         * An ATR read from its attempts xattr, which is only indexed here.  Entries are decoded when asked for, see
+         * @ref find_entry and @ref entries.
+         */
+        static active_transaction_record from_attempts(const core::document_id& id, std::string attempts, uint64_t now_ns);
+
+        /**
+         * Decodes the entry of one attempt, leaving the rest of the ATR as it is.  Throws if the entry can't be
+         * decoded.
+         */
+        CB_NODISCARD std::optional<atr_entry> find_entry(const std::string& attempt_id) const;
+
+        /** All the entries, decoded the first time they are asked for.  Throws if any of them can't be decoded. */
+        CB_NODISCARD const std::vector<atr_entry>& entries() const;
+
+        CB_NODISCARD size_t size() const
         {
-            return entries_;
+            return attempts_ ? index_.size() : entries().size();
         }
 
       private:
+        struct decoded_entries {
+            std::once_flag once;
+            std::vector<atr_entry> entries;
+        };
+
         core::document_id id_;
-        std::vector<atr_entry> entries_;
+        uint64_t now_ns_{ 0 };
+        // the attempts xattr as read, and where each attempt's entry is in it.  Empty if the entries were given.
+        std::shared_ptr<const std::string> attempts_;
+        std::vector<std::pair<std::string_view, std::string_view>> index_;
+        // shared by copies, like the attempts they are decoded from
+        std::shared_ptr<decoded_entries> decoded_;
+
+        explicit active_transaction_record(const core::document_id& id);
+
+        atr_entry decode_entry(const std::string& attempt_id, nlohmann::json& val) const;
 
         /**
          * ${Mutation.CAS} is written by kvengine with 'macroToString(htonll(info.cas))'.  Discussed this with KV team and, though there is
@@ -138,40 +215,27 @@ namespace transactions
             }
             return std::move(records);
         }
-        static inline active_transaction_record map_to_atr(const core::operations::lookup_in_response& resp)
+
+        static active_transaction_record map_to_atr(const core::operations::lookup_in_response& resp);
+        static atr_entry map_to_entry(const core::operations::lookup_in_response& resp, const std::string& attempt_id);
+
+        template<typename Callback>
+        static void get_entry_from_atr(core::cluster& cluster,
+                                       const core::document_id& atr_id,
+                                       const std::string& attempt_id,
+                                       Callback&& cb)
         {
-            std::vector<atr_entry> entries;
-            if (resp.fields[0].status == key_value_status_code::success) {
-                auto attempts = nlohmann::json::parse(to_string(resp.fields[0].value));
-                auto vbucket = default_json_serializer::deserialize<nlohmann::json>(to_string(resp.fields[1].value));
-                auto now_ns = now_ns_from_vbucket(vbucket);
-                entries.reserve(attempts.size());
-                for (auto& element : attempts.items()) {
-                    auto& val = element.value();
-                    entries.emplace_back(
-                      resp.ctx.bucket(),
-                      resp.ctx.id(),
-                      element.key(),
-                      attempt_state_value(val[ATR_FIELD_STATUS].get<std::string>()),
-                      parse_mutation_cas(val.value(ATR_FIELD_START_TIMESTAMP, "")),
-                      parse_mutation_cas(val.value(ATR_FIELD_START_COMMIT, "")),
-                      parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_COMPLETE, "")),
-                      parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_ROLLBACK_START, "")),
-                      parse_mutation_cas(val.value(ATR_FIELD_TIMESTAMP_ROLLBACK_COMPLETE, "")),
-                      val.count(ATR_FIELD_EXPIRES_AFTER_MSECS) ? std::make_optional(val[ATR_FIELD_EXPIRES_AFTER_MSECS].get<std::uint32_t>())
-                                                               : std::optional<std::uint32_t>(),
-                      process_document_ids(val, ATR_FIELD_DOCS_INSERTED),
-                      process_document_ids(val, ATR_FIELD_DOCS_REPLACED),
-                      process_document_ids(val, ATR_FIELD_DOCS_REMOVED),
-                      val.contains(ATR_FIELD_FORWARD_COMPAT) ? std::make_optional(val[ATR_FIELD_FORWARD_COMPAT].get<nlohmann::json>())
-                                                             : std::nullopt,
-                      now_ns,
-                      val.contains(ATR_FIELD_DURABILITY_LEVEL) ? std::make_optional(val[ATR_FIELD_DURABILITY_LEVEL].get<nlohmann::json>())
-                                                               : std::nullopt);
+            get_atr(cluster, atr_id, [attempt_id, cb = std::move(cb)](std::error_code ec, std::optional<active_transaction_record> atr) {
+                std::optional<atr_entry> entry;
+                if (!ec && atr) {
+                    try {
+                        entry = atr->find_entry(attempt_id);
+                    } catch (const std::exception&) {
+                        ec = couchbase::errc::key_value::path_invalid;
+                    }
                 }
-            }
-            return active_transaction_record(
-              { resp.ctx.bucket(), resp.ctx.scope(), resp.ctx.collection(), resp.ctx.id() }, resp.cas.value(), std::move(entries));
+                cb(ec, std::move(entry));
+            });
         }
     };
 
@@ -0,0 +1,155 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "admission_control.hxx"
+
+#include <algorithm>
+#include <vector>
+
+namespace couchbase::transactions
+{
+void
+admission_control::admit(std::chrono::nanoseconds budget, admit_handler&& on_admit, reject_handler&& on_reject)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_) {
+        stats_.rejected++;
+        lock.unlock();
+        return on_reject(false);
+    }
+    if (max_concurrent_ == 0 || stats_.running < max_concurrent_) {
+        stats_.running++;
+        stats_.admitted++;
+        lock.unlock();
+        return on_admit();
+    }
+    // Each slot frees up about every average_duration_, and there are max_concurrent_ slots, so this is roughly
+    // how long we'd wait behind everything already queued.
+    auto predicted_wait = average_duration_ * static_cast<int64_t>(queue_.size() + 1) / static_cast<int64_t>(max_concurrent_);
+    if (queue_.size() >= max_queued_ || predicted_wait > budget) {
+        stats_.rejected++;
+        lock.unlock();
+        return on_reject(false);
+    }
+    auto id = next_id_++;
+    std::shared_ptr<asio::steady_timer> timer;
+    if (io_ != nullptr) {
+        timer = std::make_shared<asio::steady_timer>(*io_);
+        timer->expires_after(budget);
+    }
+    queue_.push_back({ id, std::chrono::steady_clock::now() + budget, std::move(on_admit), std::move(on_reject), timer });
+    stats_.queued = queue_.size();
+    lock.unlock();
+    if (timer) {
+        // Shed it when its budget runs out, rather than waiting for release, as nothing may finish for a while.
+        timer->async_wait([this, id](asio::error_code ec) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            expired(id);
+        });
+    }
+}
+
+void
+admission_control::expired(uint64_t id)
+{
+    reject_handler on_reject;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(queue_.begin(), queue_.end(), [id](const waiter& w) { return w.id == id; });
+        if (it == queue_.end()) {
+            // already admitted or shed
+            return;
+        }
+        on_reject = std::move(it->on_reject);
+        queue_.erase(it);
+        stats_.shed++;
+        stats_.queued = queue_.size();
+    }
+    on_reject(true);
+}
+
+void
+admission_control::close()
+{
+    std::deque<waiter> queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        stats_.shed += queue_.size();
+        queued.swap(queue_);
+        stats_.queued = 0;
+    }
+    for (auto& w : queued) {
+        if (w.timer) {
+            w.timer->cancel();
+        }
+        w.on_reject(true);
+    }
+}
+
+void
+admission_control::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [this]() { return stats_.running == 0; });
+}
+
+void
+admission_control::release(std::chrono::nanoseconds elapsed)
+{
+    std::vector<admit_handler> admitted;
+    std::vector<reject_handler> shed;
+    std::vector<std::shared_ptr<asio::steady_timer>> timers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.running--;
+        // exponentially weighted, 1/8 for the latest
+        average_duration_ = average_duration_.count() == 0 ? elapsed : (average_duration_ * 7 + elapsed) / 8;
+        auto now = std::chrono::steady_clock::now();
+        while (!queue_.empty() && stats_.running < max_concurrent_) {
+            auto w = std::move(queue_.front());
+            queue_.pop_front();
+            if (w.timer) {
+                timers.push_back(std::move(w.timer));
+            }
+            if (w.deadline < now) {
+                stats_.shed++;
+                shed.push_back(std::move(w.on_reject));
+                continue;
+            }
+            stats_.running++;
+            stats_.admitted++;
+            admitted.push_back(std::move(w.on_admit));
+        }
+        stats_.queued = queue_.size();
+        if (stats_.running == 0) {
+            idle_cv_.notify_all();
+        }
+    }
+    // call these without the lock, they'll run (or fail) whole transactions
+    for (auto& timer : timers) {
+        timer->cancel();
+    }
+    for (auto& cb : shed) {
+        cb(true);
+    }
+    for (auto& cb : admitted) {
+        cb();
+    }
+}
+} // namespace couchbase::transactions
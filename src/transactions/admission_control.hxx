@@ -0,0 +1,109 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <couchbase/support.hxx>
+#include <couchbase/transactions/admission_stats.hxx>
+
+#include <asio/io_context.hpp>
+#include <asio/steady_timer.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace couchbase::transactions
+{
+/**
+ * Bounds the number of transactions a transactions object runs at once.
+ *
+ * Once max_concurrent transactions are running, new ones wait in a FIFO queue of at most max_queued.  A
+ * transaction is rejected on arrival if the queue is full, or if the wait predicted from the average transaction
+ * duration is longer than the time it has left.  A queued transaction whose time runs out before it gets to run is
+ * shed - by a timer on io, if given, otherwise only when the next running transaction finishes.  With
+ * max_concurrent of 0 everything is admitted straight away, but the gauges are still kept.
+ */
+class admission_control
+{
+  public:
+    using admit_handler = std::function<void()>;
+    // called with false if rejected on arrival, true if shed from the queue
+    using reject_handler = std::function<void(bool shed)>;
+
+    admission_control(size_t max_concurrent, size_t max_queued)
+      : max_concurrent_(max_concurrent)
+      , max_queued_(max_queued)
+    {
+    }
+
+    admission_control(asio::io_context& io, size_t max_concurrent, size_t max_queued)
+      : io_(&io)
+      , max_concurrent_(max_concurrent)
+      , max_queued_(max_queued)
+    {
+    }
+
+    /**
+     * Calls on_admit once the transaction may run, or on_reject if it may not.  Either may be called before this
+     * returns, or later from whichever thread calls release().  budget is how long the transaction can wait.
+     */
+    void admit(std::chrono::nanoseconds budget, admit_handler&& on_admit, reject_handler&& on_reject);
+
+    // An admitted transaction has finished, after running for elapsed.
+    void release(std::chrono::nanoseconds elapsed);
+
+    // Sheds everything still queued, cancelling their timers, and rejects anything that arrives from now on.
+    void close();
+
+    // Blocks until no admitted transaction is still running.
+    void wait_idle();
+
+    CB_NODISCARD admission_stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+  private:
+    struct waiter {
+        uint64_t id;
+        std::chrono::steady_clock::time_point deadline;
+        admit_handler on_admit;
+        reject_handler on_reject;
+        // sheds the waiter at its deadline, if it is still queued then
+        std::shared_ptr<asio::steady_timer> timer;
+    };
+
+    void expired(uint64_t id);
+
+    asio::io_context* io_{ nullptr };
+    mutable std::mutex mutex_;
+    // notified when the last running transaction is released
+    std::condition_variable idle_cv_;
+    bool closed_{ false };
+    uint64_t next_id_{ 0 };
+    const size_t max_concurrent_;
+    const size_t max_queued_;
+    std::deque<waiter> queue_;
+    admission_stats stats_;
+    // moving average of how long transactions take to run
+    std::chrono::nanoseconds average_duration_{ 0 };
+};
+} // namespace couchbase::transactions
@@ -19,14 +19,19 @@
 #include "active_transaction_record.hxx"
 #include "attempt_context_impl.hxx"
 #include "attempt_context_testing_hooks.hxx"
+#include "cleanup_pool.hxx"
 #include "cleanup_testing_hooks.hxx"
 #include "couchbase/transactions/internal/atr_cleanup_entry.hxx"
 #include "couchbase/transactions/internal/logging.hxx"
 #include "couchbase/transactions/internal/transactions_cleanup.hxx"
 #include "couchbase/transactions/internal/utils.hxx"
 #include "forward_compat.hxx"
+#include "request_templates.hxx"
 
+#include <algorithm>
+#include <exception>
 #include <optional>
+#include <vector>
 
 #include <couchbase/transactions.hxx>
 #include <couchbase/transactions/exceptions.hxx>
@@ -84,34 +89,30 @@ tx::atr_cleanup_entry::atr_cleanup_entry(attempt_context& ctx)
 }
 
 void
-tx::atr_cleanup_entry::clean(std::shared_ptr<spdlog::logger> logger, transactions_cleanup_attempt* result)
+tx::atr_cleanup_entry::clean(std::shared_ptr<spdlog::logger> logger, transactions_cleanup_attempt* result, atr_entry_removals* removals)
 {
     logger->trace("cleaning {}", *this);
     // get atr entry if needed
     atr_entry entry;
     if (nullptr == atr_entry_) {
-        auto atr = tx::active_transaction_record::get_atr(cleanup_->cluster_ref(), atr_id_);
-        if (atr) {
-            // now get the specific attempt
-            auto it =
-              std::find_if(atr->entries().begin(), atr->entries().end(), [&](const atr_entry& e) { return e.attempt_id() == attempt_id_; });
-            if (it != atr->entries().end()) {
-                atr_entry_ = &(*it);
-                return check_atr_and_cleanup(logger, result);
-            } else {
-                logger->trace("could not find attempt {}, nothing to clean", attempt_id_);
-                return;
-            }
+        // just the entry for this attempt, not the whole atr
+        auto found = cleanup_->atr_reads().get_entry(atr_id_, attempt_id_);
+        if (found) {
+            entry = std::move(*found);
+            atr_entry_ = &entry;
+            return check_atr_and_cleanup(logger, result, removals);
         } else {
-            logger->trace("could not find atr {}, nothing to clean", atr_id_);
+            logger->trace("could not find attempt {} in atr {}, nothing to clean", attempt_id_, atr_id_);
             return;
         }
     }
-    check_atr_and_cleanup(logger, result);
+    check_atr_and_cleanup(logger, result, removals);
 }
 
 void
-tx::atr_cleanup_entry::check_atr_and_cleanup(std::shared_ptr<spdlog::logger> logger, transactions_cleanup_attempt* result)
+tx::atr_cleanup_entry::check_atr_and_cleanup(std::shared_ptr<spdlog::logger> logger,
+                                             transactions_cleanup_attempt* result,
+                                             atr_entry_removals* removals)
 {
     // ExtStoreDurability: this is the first point where we're guaranteed to have the ATR entry
     auto durability_level_raw = atr_entry_->durability_level();
@@ -139,6 +140,11 @@ tx::atr_cleanup_entry::check_atr_and_cleanup(std::shared_ptr<spdlog::logger> log
     if (ec) {
         throw client_error(*ec, "on_cleanup_docs_completed hook threw error");
     }
+    if (removals) {
+        // the caller removes it, along with the other entries cleaned from this ATR
+        removals->add(*atr_entry_, durability_level);
+        return;
+    }
     cleanup_entry(logger, durability_level);
     ec = cleanup_->config().cleanup_hooks().on_cleanup_completed();
     if (ec) {
@@ -170,83 +176,77 @@ tx::atr_cleanup_entry::cleanup_docs(std::shared_ptr<spdlog::logger> logger, dura
 
 void
 tx::atr_cleanup_entry::do_per_doc(std::shared_ptr<spdlog::logger> logger,
-                                  std::vector<tx::doc_record> docs,
+                                  const std::vector<tx::doc_record>& docs,
                                   bool require_crc_to_match,
                                   const std::function<void(std::shared_ptr<spdlog::logger>, transaction_get_result&, bool)>& call)
 {
-    for (auto& dr : docs) {
-        try {
-            core::operations::lookup_in_request req{ dr.document_id() };
-            req.specs =
-              lookup_in_specs{
-                  lookup_in_specs::get(ATR_ID).xattr(),
-                  lookup_in_specs::get(TRANSACTION_ID).xattr(),
-                  lookup_in_specs::get(ATTEMPT_ID).xattr(),
-                  lookup_in_specs::get(STAGED_DATA).xattr(),
-                  lookup_in_specs::get(ATR_BUCKET_NAME).xattr(),
-                  lookup_in_specs::get(ATR_SCOPE_NAME).xattr(),
-                  lookup_in_specs::get(ATR_COLL_NAME).xattr(),
-                  lookup_in_specs::get(TRANSACTION_RESTORE_PREFIX_ONLY).xattr(),
-                  lookup_in_specs::get(TYPE).xattr(),
-                  lookup_in_specs::get(couchbase::subdoc::lookup_in_macro::document).xattr(),
-                  lookup_in_specs::get(CRC32_OF_STAGING).xattr(),
-                  lookup_in_specs::get(FORWARD_COMPAT).xattr(),
-                  lookup_in_specs::get(""),
-              }
-                .specs();
-            req.access_deleted = true;
-            wrap_request(req, cleanup_->config());
-            // now a blocking lookup_in...
-            auto barrier = std::make_shared<std::promise<result>>();
-            cleanup_->cluster_ref().execute(
-              req, [barrier](core::operations::lookup_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
-            auto f = barrier->get_future();
-            auto res = wrap_operation_future(f);
+    // Each document needs a blocking lookup_in and usually a blocking durable write, so they are spread over the
+    // cleanup document pool.  This only returns once they are all done, so the ATR entry is still removed after every
+    // document.  After an error no more documents are started, and the first error is rethrown.
+    cleanup_->document_pool().for_each(docs.size(), [&](size_t i) { do_doc(logger, docs[i], require_crc_to_match, call); });
+}
 
-            if (res.values.empty()) {
-                logger->trace("cannot create a transaction document from {}, ignoring", res);
-                continue;
-            }
-            auto doc = transaction_get_result::create_from(dr.document_id(), res);
-            // now let's decide if we call the function or not
-            if (!(doc.links().has_staged_content() || doc.links().is_document_being_removed()) || !doc.links().has_staged_write()) {
-                logger->trace("document {} has no staged content - assuming it was "
-                              "committed and skipping",
-                              dr.id());
-                continue;
-            } else if (doc.links().staged_attempt_id() != attempt_id_) {
-                logger->trace(
-                  "document {} staged for different attempt {}, skipping", dr.id(), doc.links().staged_attempt_id().value_or("<none>)"));
-                continue;
-            }
-            if (require_crc_to_match) {
-                if (!doc.metadata()->crc32() || !doc.links().crc32_of_staging() ||
-                    doc.links().crc32_of_staging() != doc.metadata()->crc32()) {
-                    logger->trace("document {} crc32 {} doesn't match staged value {}, skipping",
-                                  dr.id(),
-                                  doc.metadata()->crc32().value_or("<none>"),
-                                  doc.links().crc32_of_staging().value_or("<none>"));
-                    continue;
-                }
-            }
-            call(logger, doc, res.is_deleted);
-        } catch (const client_error& e) {
-            error_class ec = e.ec();
-            switch (ec) {
-                case FAIL_DOC_NOT_FOUND:
-                    logger->error("document {} not found - ignoring ", dr);
-                    break;
-                default:
-                    logger->error("got error {}, not ignoring this", e.what());
-                    throw;
+void
+tx::atr_cleanup_entry::do_doc(std::shared_ptr<spdlog::logger> logger,
+                              const tx::doc_record& dr,
+                              bool require_crc_to_match,
+                              const std::function<void(std::shared_ptr<spdlog::logger>, transaction_get_result&, bool)>& call)
+{
+    try {
+        core::operations::lookup_in_request req{ dr.document_id() };
+        req.specs = txn_document_lookup_specs();
+        req.access_deleted = true;
+        wrap_request(req, cleanup_->config());
+        // now a blocking lookup_in...
+        auto barrier = std::make_shared<std::promise<result>>();
+        cleanup_->cluster_ref().execute(
+          req, [barrier](core::operations::lookup_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
+        auto f = barrier->get_future();
+        auto res = wrap_operation_future(f);
+
+        if (res.values.empty()) {
+            logger->trace("cannot create a transaction document from {}, ignoring", res);
+            return;
+        }
+        auto doc = transaction_get_result::create_from(dr.document_id(), res);
+        // now let's decide if we call the function or not
+        if (!(doc.links().has_staged_content() || doc.links().is_document_being_removed()) || !doc.links().has_staged_write()) {
+            logger->trace("document {} has no staged content - assuming it was "
+                          "committed and skipping",
+                          dr.id());
+            return;
+        } else if (doc.links().staged_attempt_id() != attempt_id_) {
+            logger->trace(
+              "document {} staged for different attempt {}, skipping", dr.id(), doc.links().staged_attempt_id().value_or("<none>)"));
+            return;
+        }
+        if (require_crc_to_match) {
+            if (!doc.metadata()->crc32() || !doc.links().crc32_of_staging() ||
+                doc.links().crc32_of_staging() != doc.metadata()->crc32()) {
+                logger->trace("document {} crc32 {} doesn't match staged value {}, skipping",
+                              dr.id(),
+                              doc.metadata()->crc32().value_or("<none>"),
+                              doc.links().crc32_of_staging().value_or("<none>"));
+                return;
             }
         }
+        call(logger, doc, res.is_deleted);
+    } catch (const client_error& e) {
+        error_class ec = e.ec();
+        switch (ec) {
+            case FAIL_DOC_NOT_FOUND:
+                logger->error("document {} not found - ignoring ", dr);
+                break;
+            default:
+                logger->error("got error {}, not ignoring this", e.what());
+                throw;
+        }
     }
 }
 
 void
 tx::atr_cleanup_entry::commit_docs(std::shared_ptr<spdlog::logger> logger,
-                                   std::optional<std::vector<tx::doc_record>> docs,
+                                   const std::optional<std::vector<tx::doc_record>>& docs,
                                    durability_level dl)
 {
     if (docs) {
@@ -294,7 +294,7 @@ tx::atr_cleanup_entry::commit_docs(std::shared_ptr<spdlog::logger> logger,
 }
 void
 tx::atr_cleanup_entry::remove_docs(std::shared_ptr<spdlog::logger> logger,
-                                   std::optional<std::vector<tx::doc_record>> docs,
+                                   const std::optional<std::vector<tx::doc_record>>& docs,
                                    durability_level dl)
 {
     if (docs) {
@@ -337,7 +337,7 @@ tx::atr_cleanup_entry::remove_docs(std::shared_ptr<spdlog::logger> logger,
 
 void
 tx::atr_cleanup_entry::remove_docs_staged_for_removal(std::shared_ptr<spdlog::logger> logger,
-                                                      std::optional<std::vector<tx::doc_record>> docs,
+                                                      const std::optional<std::vector<tx::doc_record>>& docs,
                                                       durability_level dl)
 {
     if (docs) {
@@ -368,7 +368,7 @@ tx::atr_cleanup_entry::remove_docs_staged_for_removal(std::shared_ptr<spdlog::lo
 
 void
 tx::atr_cleanup_entry::remove_txn_links(std::shared_ptr<spdlog::logger> logger,
-                                        std::optional<std::vector<tx::doc_record>> docs,
+                                        const std::optional<std::vector<tx::doc_record>>& docs,
                                         durability_level dl)
 {
     if (docs) {
@@ -396,6 +396,16 @@ tx::atr_cleanup_entry::remove_txn_links(std::shared_ptr<spdlog::logger> logger,
     }
 }
 
+// the specs removing one attempt's entry from its ATR.  A PENDING entry gets a "p" field inserted first.
+static void
+add_entry_removal_specs(couchbase::mutate_in_specs& specs, const std::string& attempt_id, bool pending)
+{
+    if (pending) {
+        specs.push_back(couchbase::mutate_in_specs::insert("attempts." + attempt_id + ".p", tao::json::empty_object).xattr());
+    }
+    specs.push_back(couchbase::mutate_in_specs::remove("attempts." + attempt_id).xattr());
+}
+
 void
 tx::atr_cleanup_entry::cleanup_entry(std::shared_ptr<spdlog::logger> logger, durability_level dl)
 {
@@ -406,11 +416,7 @@ tx::atr_cleanup_entry::cleanup_entry(std::shared_ptr<spdlog::logger> logger, dur
         }
         core::operations::mutate_in_request req{ atr_id_ };
         couchbase::mutate_in_specs mut_specs;
-        if (atr_entry_->state() == tx::attempt_state::PENDING) {
-            mut_specs.push_back(
-              couchbase::mutate_in_specs::insert("attempts." + atr_entry_->attempt_id() + ".p", tao::json::empty_object).xattr());
-        }
-        mut_specs.push_back(couchbase::mutate_in_specs::remove("attempts." + atr_entry_->attempt_id()).xattr());
+        add_entry_removal_specs(mut_specs, atr_entry_->attempt_id(), atr_entry_->state() == tx::attempt_state::PENDING);
         req.specs = mut_specs.specs();
         wrap_durable_request(req, cleanup_->config(), dl);
         auto barrier = std::make_shared<std::promise<result>>();
@@ -432,6 +438,159 @@ tx::atr_cleanup_entry::cleanup_entry(std::shared_ptr<spdlog::logger> logger, dur
     }
 }
 
+tx::atr_entry_removals::atr_entry_removals(const core::document_id& atr_id, const transactions_cleanup& cleanup, executor execute)
+  : atr_id_(atr_id)
+  , cleanup_(&cleanup)
+  , execute_(std::move(execute))
+{
+}
+
+void
+tx::atr_entry_removals::add(const atr_entry& entry, durability_level dl)
+{
+    removals_.push_back({ entry.attempt_id(), entry.state() == tx::attempt_state::PENDING, dl });
+}
+
+void
+tx::atr_entry_removals::remove(std::shared_ptr<spdlog::logger> logger)
+{
+    // only entries cleaned with the same durability can share a mutate_in
+    std::stable_sort(removals_.begin(), removals_.end(), [](const removal& lhs, const removal& rhs) { return lhs.dl < rhs.dl; });
+    std::exception_ptr first_error;
+    size_t first = 0;
+    while (first < removals_.size()) {
+        size_t last = first;
+        size_t specs = 0;
+        while (last < removals_.size() && removals_[last].dl == removals_[first].dl &&
+               specs + (removals_[last].pending ? 2 : 1) <= max_specs_) {
+            specs += removals_[last].pending ? 2 : 1;
+            last++;
+        }
+        try {
+            remove_batch(logger, first, last);
+        } catch (...) {
+            if (!first_error) {
+                first_error = std::current_exception();
+            }
+        }
+        first = last;
+    }
+    removals_.clear();
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+}
+
+void
+tx::atr_entry_removals::remove_batch(std::shared_ptr<spdlog::logger> logger, size_t first, size_t last)
+{
+    // Each entry gets the hooks and errors it would get if it were removed on its own, so one failing leaves out just
+    // that entry.  The first error is rethrown once the rest are done.
+    std::exception_ptr first_error;
+    auto failed = [&first_error](std::exception_ptr err) {
+        if (!first_error) {
+            first_error = err;
+        }
+    };
+    std::vector<removal> batch;
+    for (size_t i = first; i < last; i++) {
+        auto ec = cleanup_->config().cleanup_hooks().before_atr_remove();
+        if (ec) {
+            logger->error("cleanup couldn't remove attempt {}, before_atr_remove hook raised {}", removals_[i].attempt_id, *ec);
+            failed(std::make_exception_ptr(client_error(*ec, "before_atr_remove hook threw error")));
+            continue;
+        }
+        batch.push_back(removals_[i]);
+    }
+    std::vector<removal> removed;
+    auto remove_each = [&]() {
+        for (const auto& r : batch) {
+            try {
+                remove_one(logger, r);
+                removed.push_back(r);
+            } catch (...) {
+                failed(std::current_exception());
+            }
+        }
+    };
+    if (batch.size() == 1) {
+        remove_each();
+    } else if (batch.size() > 1) {
+        try {
+            execute(batch);
+            removed = batch;
+            logger->trace("successfully removed {} attempts from {}", batch.size(), atr_id_);
+        } catch (const client_error& e) {
+            switch (e.ec()) {
+                case FAIL_PATH_NOT_FOUND:
+                case FAIL_PATH_ALREADY_EXISTS:
+                    // One entry already gone, or colliding with its attempt, fails the whole mutate_in - so find out which
+                    // by removing them one at a time.
+                    logger->trace("removing {} attempts from {} got {}, removing one at a time", batch.size(), atr_id_, e.what());
+                    remove_each();
+                    break;
+                default:
+                    logger->error("cleanup couldn't remove {} attempts from {} due to {} {}", batch.size(), atr_id_, e.ec(), e.what());
+                    failed(std::current_exception());
+            }
+        } catch (...) {
+            failed(std::current_exception());
+        }
+    }
+    for (size_t i = 0; i < removed.size(); i++) {
+        auto ec = cleanup_->config().cleanup_hooks().on_cleanup_completed();
+        if (ec) {
+            failed(std::make_exception_ptr(client_error(*ec, "on_cleanup_completed hook threw error")));
+        }
+    }
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+}
+
+void
+tx::atr_entry_removals::remove_one(std::shared_ptr<spdlog::logger> logger, const removal& r)
+{
+    try {
+        execute({ r });
+        logger->trace("successfully removed attempt {}", r.attempt_id);
+    } catch (const client_error& e) {
+        error_class ec = e.ec();
+        switch (ec) {
+            case FAIL_PATH_NOT_FOUND:
+                logger->trace("found attempt {} has also inserted 'p' field indicating collision with main algo", r.attempt_id);
+                return;
+            case FAIL_PATH_ALREADY_EXISTS:
+                // as when cleaning the entry on its own, this fails the entry
+                logger->error("cleanup couldn't remove attempt {}, its 'p' field already exists: {}", r.attempt_id, e.what());
+                throw;
+            default:
+                logger->error("cleanup couldn't remove attempt {} due to {} {}", r.attempt_id, ec, e.what());
+                throw;
+        }
+    }
+}
+
+void
+tx::atr_entry_removals::execute(const std::vector<removal>& batch)
+{
+    if (execute_) {
+        return execute_(atr_id_, batch);
+    }
+    core::operations::mutate_in_request req{ atr_id_ };
+    couchbase::mutate_in_specs mut_specs;
+    for (const auto& r : batch) {
+        add_entry_removal_specs(mut_specs, r.attempt_id, r.pending);
+    }
+    req.specs = mut_specs.specs();
+    wrap_durable_request(req, cleanup_->config(), batch.front().dl);
+    auto barrier = std::make_shared<std::promise<result>>();
+    auto f = barrier->get_future();
+    cleanup_->cluster_ref().execute(
+      req, [barrier](core::operations::mutate_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
+    tx::wrap_operation_future(f);
+}
+
 bool
 tx::atr_cleanup_entry::ready() const
 {
@@ -441,14 +600,20 @@ tx::atr_cleanup_entry::ready() const
 std::optional<tx::atr_cleanup_entry>
 tx::atr_cleanup_queue::pop(bool check_time)
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (!queue_.empty()) {
-        if (!check_time || (check_time && queue_.top().ready())) {
-            // copy it
-            tx::atr_cleanup_entry top = queue_.top();
-            // pop it
-            queue_.pop();
-            return { top };
+    // start at a different shard each time, so the workers spread out over them
+    auto start = next_pop_++;
+    for (size_t i = 0; i < num_shards_; i++) {
+        auto& s = shards_[(start + i) % num_shards_];
+        std::unique_lock<std::mutex> lock(s.mutex);
+        if (!s.queue.empty()) {
+            if (!check_time || (check_time && s.queue.top().ready())) {
+                // copy it
+                tx::atr_cleanup_entry top = s.queue.top();
+                // pop it
+                s.queue.pop();
+                size_--;
+                return { top };
+            }
         }
     }
     return {};
@@ -457,20 +622,100 @@ tx::atr_cleanup_queue::pop(bool check_time)
 size_t
 tx::atr_cleanup_queue::size() const
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return queue_.size();
+    return size_.load();
+}
+
+size_t
+tx::atr_cleanup_queue::peak_size() const
+{
+    return peak_size_.load();
+}
+
+std::optional<tx::atr_cleanup_entry>
+tx::atr_cleanup_queue::pop_when_ready()
+{
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    while (!closed_) {
+        lock.unlock();
+        if (auto entry = pop()) {
+            lock.lock();
+            // earliest_ may be this waiter's wake up time, which has gone, so make sure the next push wakes someone.
+            // Anything pushed while we were being woken didn't notify, as earliest_ was still set, so pass that on.
+            earliest_ = std::chrono::steady_clock::time_point::max();
+            if (size_.load() > 0) {
+                wait_cv_.notify_one();
+            }
+            return entry;
+        }
+        lock.lock();
+        // A push after we look at the shards notifies us once we are waiting, as it needs wait_mutex_ to do so.
+        auto due = next_due();
+        if (!due) {
+            earliest_ = std::chrono::steady_clock::time_point::max();
+            wait_cv_.wait(lock);
+        } else {
+            earliest_ = *due;
+            wait_cv_.wait_until(lock, *due);
+        }
+    }
+    return {};
+}
+
+void
+tx::atr_cleanup_queue::close()
+{
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    closed_ = true;
+    wait_cv_.notify_all();
+}
+
+std::optional<std::chrono::steady_clock::time_point>
+tx::atr_cleanup_queue::next_due()
+{
+    std::optional<std::chrono::steady_clock::time_point> due;
+    for (auto& s : shards_) {
+        std::unique_lock<std::mutex> lock(s.mutex);
+        if (!s.queue.empty() && (!due || s.queue.top().min_start_time_ < *due)) {
+            due = s.queue.top().min_start_time_;
+        }
+    }
+    return due;
+}
+
+void
+tx::atr_cleanup_queue::pushed(std::chrono::steady_clock::time_point min_start_time)
+{
+    auto now = ++size_;
+    auto peak = peak_size_.load();
+    while (now > peak && !peak_size_.compare_exchange_weak(peak, now)) {
+    }
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    if (min_start_time < earliest_) {
+        earliest_ = min_start_time;
+        wait_cv_.notify_one();
+    }
 }
 
 void
 tx::atr_cleanup_queue::push(attempt_context& ctx)
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-    queue_.emplace(ctx);
+    auto& s = shards_[next_push_++ % num_shards_];
+    std::chrono::steady_clock::time_point min_start_time;
+    {
+        std::unique_lock<std::mutex> lock(s.mutex);
+        s.queue.emplace(ctx);
+        min_start_time = s.queue.top().min_start_time_;
+    }
+    pushed(min_start_time);
 }
 
 void
 tx::atr_cleanup_queue::push(const atr_cleanup_entry& e)
 {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return queue_.push(e);
+    auto& s = shards_[next_push_++ % num_shards_];
+    {
+        std::unique_lock<std::mutex> lock(s.mutex);
+        s.queue.push(e);
+    }
+    pushed(e.min_start_time_);
 }
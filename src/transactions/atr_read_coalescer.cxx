@@ -0,0 +1,166 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "atr_read_coalescer.hxx"
+
+#include <future>
+
+#include "couchbase/transactions/internal/logging.hxx"
+
+namespace couchbase::transactions
+{
+namespace
+{
+std::string
+atr_key(const core::document_id& atr_id)
+{
+    return fmt::format("{}/{}/{}/{}", atr_id.bucket(), atr_id.scope(), atr_id.collection(), atr_id.key());
+}
+
+// picks an entry out of a whole ATR read
+atr_read_coalescer::Callback
+entry_of(const std::string& attempt_id, atr_read_coalescer::EntryCallback&& cb)
+{
+    return [attempt_id, cb = std::move(cb)](std::error_code ec, atr_read_coalescer::atr_ptr atr) {
+        std::optional<atr_entry> entry;
+        if (!ec && atr) {
+            try {
+                entry = atr->find_entry(attempt_id);
+            } catch (const std::exception&) {
+                // a corrupt entry, treat it as we would a corrupt ATR
+                ec = couchbase::errc::key_value::path_invalid;
+            }
+        }
+        cb(ec, std::move(entry));
+    };
+}
+} // namespace
+
+atr_read_coalescer::atr_read_coalescer(core::cluster& cluster)
+  : fetch_([&cluster](const core::document_id& atr_id, FetchCallback&& cb) {
+      active_transaction_record::get_atr(cluster, atr_id, std::move(cb));
+  })
+  , fetch_entry_([&cluster](const core::document_id& atr_id, const std::string& attempt_id, EntryCallback&& cb) {
+      active_transaction_record::get_atr_entry(cluster, atr_id, attempt_id, std::move(cb));
+  })
+{
+}
+
+atr_read_coalescer::atr_read_coalescer(Fetch fetch, EntryFetch fetch_entry)
+  : fetch_(std::move(fetch))
+  , fetch_entry_(std::move(fetch_entry))
+{
+}
+
+void
+atr_read_coalescer::get(const core::document_id& atr_id, Callback&& cb)
+{
+    auto key = atr_key(atr_id);
+    ++reads_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& waiters = in_flight_[key];
+        waiters.push_back(std::move(cb));
+        if (waiters.size() > 1) {
+            ++coalesced_;
+            txn_log->trace("joining in-flight read of atr {}", atr_id);
+            return;
+        }
+    }
+    fetch_(atr_id, [this, key](std::error_code ec, std::optional<active_transaction_record> atr) {
+        atr_ptr shared;
+        if (atr) {
+            shared = std::make_shared<const active_transaction_record>(std::move(*atr));
+        }
+        std::list<Callback> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = in_flight_.find(key);
+            waiters = std::move(it->second);
+            in_flight_.erase(it);
+        }
+        for (auto& waiter : waiters) {
+            waiter(ec, shared);
+        }
+    });
+}
+
+void
+atr_read_coalescer::get_entry(const core::document_id& atr_id, const std::string& attempt_id, EntryCallback&& cb)
+{
+    if (!fetch_entry_) {
+        return get(atr_id, entry_of(attempt_id, std::move(cb)));
+    }
+    auto key = std::make_pair(atr_key(atr_id), attempt_id);
+    ++reads_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (auto it = in_flight_.find(key.first); it != in_flight_.end()) {
+            ++coalesced_;
+            txn_log->trace("reading entry {} from in-flight read of atr {}", attempt_id, atr_id);
+            it->second.push_back(entry_of(attempt_id, std::move(cb)));
+            return;
+        }
+        auto& waiters = entries_in_flight_[key];
+        waiters.push_back(std::move(cb));
+        if (waiters.size() > 1) {
+            ++coalesced_;
+            txn_log->trace("joining in-flight read of entry {} in atr {}", attempt_id, atr_id);
+            return;
+        }
+    }
+    fetch_entry_(atr_id, attempt_id, [this, key](std::error_code ec, std::optional<atr_entry> entry) {
+        std::list<EntryCallback> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_in_flight_.find(key);
+            waiters = std::move(it->second);
+            entries_in_flight_.erase(it);
+        }
+        for (auto& waiter : waiters) {
+            waiter(ec, entry);
+        }
+    });
+}
+
+std::optional<atr_entry>
+atr_read_coalescer::get_entry(const core::document_id& atr_id, const std::string& attempt_id)
+{
+    auto barrier = std::make_shared<std::promise<std::optional<atr_entry>>>();
+    auto f = barrier->get_future();
+    get_entry(atr_id, attempt_id, [barrier](std::error_code ec, std::optional<atr_entry> entry) {
+        if (!ec) {
+            return barrier->set_value(std::move(entry));
+        }
+        return barrier->set_exception(std::make_exception_ptr(std::runtime_error(ec.message())));
+    });
+    return f.get();
+}
+
+atr_read_coalescer::atr_ptr
+atr_read_coalescer::get(const core::document_id& atr_id)
+{
+    auto barrier = std::make_shared<std::promise<atr_ptr>>();
+    auto f = barrier->get_future();
+    get(atr_id, [barrier](std::error_code ec, atr_ptr atr) {
+        if (!ec) {
+            return barrier->set_value(std::move(atr));
+        }
+        return barrier->set_exception(std::make_exception_ptr(std::runtime_error(ec.message())));
+    });
+    return f.get();
+}
+} // namespace couchbase::transactions
@@ -0,0 +1,99 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include "active_transaction_record.hxx"
+
+namespace couchbase::transactions
+{
+/** Hit counters for an @ref atr_read_coalescer */
+struct atr_read_stats {
+    // reads asked for
+    size_t reads{ 0 };
+    // reads which joined one already in flight, rather than sending their own lookup
+    size_t coalesced{ 0 };
+
+    CB_NODISCARD double hit_rate() const
+    {
+        return reads == 0 ? 0.0 : static_cast<double>(coalesced) / static_cast<double>(reads);
+    }
+};
+
+/**
+ * Collapses concurrent reads of the same ATR into one.
+ *
+ * The first read of an ATR sends the lookup, and any read of the same ATR made before it completes waits for that
+ * lookup instead of sending its own.  The response is parsed once, and every waiter gets the same immutable record.
+ * Nothing is cached once the lookup completes, so a read that starts after a lookup has completed always sends a new
+ * one.  A read that joins a lookup already in flight may get an ATR the server read before that read was made.
+ *
+ * Reads of a single attempt's entry look up just that entry, unless a read of the whole ATR is already in flight, in
+ * which case they wait for it instead.  Concurrent reads of the same entry share one lookup in the same way.
+ */
+class atr_read_coalescer
+{
+  public:
+    using atr_ptr = std::shared_ptr<const active_transaction_record>;
+    using Callback = std::function<void(std::error_code, atr_ptr)>;
+    using FetchCallback = std::function<void(std::error_code, std::optional<active_transaction_record>)>;
+    using Fetch = std::function<void(const core::document_id&, FetchCallback&&)>;
+    using EntryCallback = std::function<void(std::error_code, std::optional<atr_entry>)>;
+    using EntryFetch = std::function<void(const core::document_id&, const std::string&, EntryCallback&&)>;
+
+    explicit atr_read_coalescer(core::cluster& cluster);
+    // for tests, fetch replaces the lookup.  Without fetch_entry, entries are read from the whole ATR.
+    explicit atr_read_coalescer(Fetch fetch, EntryFetch fetch_entry = {});
+
+    /** Reads the ATR, calling back with an empty pointer if it doesn't exist. */
+    void get(const core::document_id& atr_id, Callback&& cb);
+
+    /** Blocking read, throws on error like @ref active_transaction_record::get_atr */
+    atr_ptr get(const core::document_id& atr_id);
+
+    /** Reads one attempt's entry, calling back with none if it or the ATR doesn't exist. */
+    void get_entry(const core::document_id& atr_id, const std::string& attempt_id, EntryCallback&& cb);
+
+    /** Blocking read of one entry, throws on error */
+    std::optional<atr_entry> get_entry(const core::document_id& atr_id, const std::string& attempt_id);
+
+    CB_NODISCARD atr_read_stats stats() const
+    {
+        return { reads_.load(), coalesced_.load() };
+    }
+
+  private:
+    Fetch fetch_;
+    EntryFetch fetch_entry_;
+    std::mutex mutex_;
+    // waiters on each ATR read in flight, keyed by ATR id
+    std::map<std::string, std::list<Callback>> in_flight_;
+    // waiters on each entry read in flight, keyed by ATR id and attempt id
+    std::map<std::pair<std::string, std::string>, std::list<EntryCallback>> entries_in_flight_;
+    std::atomic<size_t> reads_{ 0 };
+    std::atomic<size_t> coalesced_{ 0 };
+};
+} // namespace couchbase::transactions
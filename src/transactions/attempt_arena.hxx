@@ -0,0 +1,66 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+
+namespace couchbase::transactions
+{
+/**
+ * Monotonic arena for allocations which live exactly as long as one attempt.
+ *
+ * Nothing is freed until the arena itself goes, at which point everything is released in one step.  The
+ * monotonic resource isn't thread-safe, and attempts run callbacks on several threads, so allocation takes a lock.
+ * Only hand it to containers whose growth is bounded by the attempt's work (the staged mutations, say), since
+ * memory released by them isn't reused.
+ */
+class attempt_arena : public std::pmr::memory_resource
+{
+  public:
+    static constexpr size_t initial_size = 4096;
+
+    explicit attempt_arena(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+      : arena_(initial_size, upstream)
+    {
+    }
+
+    attempt_arena(const attempt_arena&) = delete;
+    attempt_arena& operator=(const attempt_arena&) = delete;
+
+  private:
+    std::mutex mutex_;
+    std::pmr::monotonic_buffer_resource arena_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return arena_.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override
+    {
+        // monotonic, released when the arena goes
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+} // namespace couchbase::transactions
@@ -22,9 +22,14 @@
 #include "couchbase/transactions/internal/logging.hxx"
 #include "couchbase/transactions/internal/utils.hxx"
 #include "forward_compat.hxx"
+#include "request_templates.hxx"
 #include "staged_mutation.hxx"
+#include "terminal_attempt_cache.hxx"
 #include <couchbase/transactions/attempt_state.hxx>
 
+#include <algorithm>
+#include <unordered_set>
+
 namespace couchbase::transactions
 {
 
@@ -47,17 +52,60 @@ attempt_context_impl::cluster_ref()
 attempt_context_impl::attempt_context_impl(transaction_context& transaction_ctx)
   : overall_(transaction_ctx)
   , is_done_(false)
-  , staged_mutations_(new staged_mutation_queue())
+  , staged_mutations_(new staged_mutation_queue(&arena_))
   , hooks_(overall_.config().attempt_context_hooks())
+  , atr_reads_(transaction_ctx.cluster_ref())
 {
     // put a new transaction_attempt in the context...
     overall_.add_attempt();
+    atr_paths_ = atr_entry_paths(id());
     trace("added new attempt, state {}, expiration in {}ms",
           attempt_state_name(state()),
           std::chrono::duration_cast<std::chrono::milliseconds>(overall_.remaining()).count());
 }
 
-attempt_context_impl::~attempt_context_impl() = default;
+attempt_context_impl::~attempt_context_impl()
+{
+    auto stats = atr_reads_.stats();
+    if (stats.reads > 0) {
+        debug("read atrs {} times, {} of them sharing a lookup already in flight", stats.reads, stats.coalesced);
+        auto terminal = terminal_attempt_cache::instance().stats();
+        debug("terminal attempt cache has {} entries in ~{} bytes, hit rate {:.2f}",
+              terminal.entries,
+              terminal.memory_bytes,
+              terminal.hit_rate());
+    }
+}
+
+// What a read sees of a document staged by another attempt, in the given state: no document, or this content
+static std::optional<std::shared_ptr<const std::string>>
+visible_content(const transaction_get_result& doc, attempt_state state)
+{
+    switch (state) {
+        case attempt_state::COMPLETED:
+        case attempt_state::COMMITTED:
+            if (doc.links().is_document_being_removed()) {
+                return std::nullopt;
+            }
+            return doc.links().staged_content_buffer();
+        default:
+            if (doc.links().is_document_being_inserted()) {
+                // This document is being inserted, so should not be visible yet
+                return std::nullopt;
+            }
+            return doc.content_buffer();
+    }
+}
+
+void
+attempt_context_impl::after_retry_delay(const transaction_operation_failed& err, std::function<void()> fn)
+{
+    // forward compatibility can ask us to wait before retrying, and this may be on an io thread, so use a timer
+    if (auto delay = err.retry_delay()) {
+        return async_delay(overall_.io_context(), *delay, std::move(fn));
+    }
+    fn();
+}
 
 // not a member of attempt_context_impl, as forward_compat is internal.
 template<typename Handler>
@@ -76,9 +124,10 @@ attempt_context_impl::check_and_handle_blocking_transactions(const transaction_g
             debug("doc {} in another txn, checking atr...", doc.id());
             auto err = forward_compat::check(stage, doc.links().forward_compat());
             if (err) {
-                return cb(err);
+                return after_retry_delay(*err, [cb = std::forward<Handler>(cb), err]() mutable { cb(err); });
             }
-            exp_delay delay(std::chrono::milliseconds(50), std::chrono::milliseconds(500), std::chrono::seconds(1));
+            // decorrelated, so the transactions blocked on the same document don't all check its ATR in step
+            decorrelated_jitter_backoff delay(std::chrono::milliseconds(50), std::chrono::milliseconds(500), std::chrono::seconds(1));
             return check_atr_entry_for_blocking_document(doc, delay, cb);
         }
         debug("doc {} is in another transaction {}, but doesn't have enough info to check the atr. "
@@ -149,7 +198,7 @@ attempt_context_impl::get(const core::document_id& id, Callback&& cb)
                   }
                   auto err = forward_compat::check(forward_compat_stage::GETS, res->links().forward_compat());
                   if (err) {
-                      return op_completed_with_error(std::move(cb), *err);
+                      return after_retry_delay(*err, [this, cb, err = *err]() mutable { op_completed_with_error(std::move(cb), err); });
                   }
                   return op_completed_with_callback(std::move(cb), res);
               }
@@ -216,7 +265,8 @@ attempt_context_impl::get_optional(const core::document_id& id, Callback&& cb)
                   if (res) {
                       auto err = forward_compat::check(forward_compat_stage::GETS, res->links().forward_compat());
                       if (err) {
-                          return op_completed_with_error(std::move(cb), *err);
+                          return after_retry_delay(*err,
+                                                   [this, cb, err = *err]() mutable { op_completed_with_error(std::move(cb), err); });
                       }
                   }
                   return op_completed_with_callback(std::move(cb), res);
@@ -225,40 +275,265 @@ attempt_context_impl::get_optional(const core::document_id& id, Callback&& cb)
     });
 }
 
-core::operations::mutate_in_request
-attempt_context_impl::create_staging_request(const core::document_id& id,
-                                             const transaction_get_result* document,
-                                             const std::string type,
-                                             std::optional<std::string> content)
+namespace
 {
-    core::operations::mutate_in_request req{ id };
-    auto txn = nlohmann::json::object();
-    txn["id"] = nlohmann::json::object();
-    txn["id"]["txn"] = transaction_id();
-    txn["id"]["atmpt"] = this->id();
-    txn["atr"] = nlohmann::json::object();
-    txn["atr"]["id"] = atr_id();
-    txn["atr"]["bkt"] = atr_id_->bucket();
-    txn["atr"]["scp"] = atr_id_->scope();
-    txn["atr"]["coll"] = atr_id_->collection();
-    txn["op"] = nlohmann::json::object();
-    txn["op"]["type"] = type;
+// state shared by the gets of one get_multi
+struct multi_get_state {
+    std::mutex mutex;
+    std::vector<core::document_id> ids;
+    std::vector<std::optional<transaction_get_result>> results;
+    size_t remaining{ 0 };
+    std::exception_ptr first_error;
+    bool optional{ false };
+    // in query mode each get is a statement in the query transaction, and those go one at a time
+    bool serial{ false };
+    async_attempt_context::OptionalMultiCallback cb;
+};
 
-    if (document && document->metadata()) {
-        txn["restore"] = nlohmann::json::object();
-        if (document->metadata()->cas()) {
-            txn["restore"]["CAS"] = document->metadata()->cas().value();
+void
+multi_get_one(attempt_context_impl& ctx, std::shared_ptr<multi_get_state> state, size_t index)
+{
+    auto done = [&ctx, state, index](std::exception_ptr err, std::optional<transaction_get_result> res) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        if (err && !state->first_error) {
+            state->first_error = err;
         }
-        if (document->metadata()->revid()) {
-            txn["restore"]["revid"] = document->metadata()->revid().value();
+        state->results[index] = std::move(res);
+        bool last = --state->remaining == 0;
+        lock.unlock();
+        if (state->serial) {
+            if (err) {
+                return state->cb(err, {});
+            }
+            if (!last) {
+                return multi_get_one(ctx, state, index + 1);
+            }
         }
-        if (document->metadata()->exptime()) {
-            txn["restore"]["exptime"] = document->metadata()->exptime().value();
+        if (last) {
+            if (state->first_error) {
+                return state->cb(state->first_error, {});
+            }
+            return state->cb({}, std::move(state->results));
         }
+    };
+    if (state->optional) {
+        return ctx.get_optional(state->ids[index], std::move(done));
     }
+    ctx.get(state->ids[index], std::move(done));
+}
 
+void
+start_multi_get(attempt_context_impl& ctx,
+                const std::vector<core::document_id>& ids,
+                bool optional,
+                bool serial,
+                async_attempt_context::OptionalMultiCallback&& cb)
+{
+    if (ids.empty()) {
+        return cb({}, {});
+    }
+    auto state = std::make_shared<multi_get_state>();
+    state->ids = ids;
+    state->results.resize(ids.size());
+    state->remaining = ids.size();
+    state->optional = optional;
+    state->serial = serial;
+    state->cb = std::move(cb);
+    if (serial) {
+        return multi_get_one(ctx, state, 0);
+    }
+    // Issue them all now.  Documents staged by the same other transaction share their ATR read, see atr_read_coalescer.
+    for (size_t i = 0; i < ids.size(); i++) {
+        multi_get_one(ctx, state, i);
+    }
+}
+} // namespace
+
+std::vector<transaction_get_result>
+attempt_context_impl::get_multi(const std::vector<core::document_id>& ids)
+{
+    auto barrier = std::make_shared<std::promise<std::vector<transaction_get_result>>>();
+    auto f = barrier->get_future();
+    get_multi(ids, [barrier](std::exception_ptr err, std::vector<transaction_get_result> res) {
+        if (err) {
+            return barrier->set_exception(err);
+        }
+        return barrier->set_value(std::move(res));
+    });
+    return f.get();
+}
+
+void
+attempt_context_impl::get_multi(const std::vector<core::document_id>& ids, MultiCallback&& cb)
+{
+    start_multi_get(*this,
+                    ids,
+                    false,
+                    op_list_.get_mode().is_query(),
+                    [cb = std::move(cb)](std::exception_ptr err, std::vector<std::optional<transaction_get_result>> res) {
+                        if (err) {
+                            return cb(err, {});
+                        }
+                        // get fails for missing docs, so they are all here
+                        std::vector<transaction_get_result> docs;
+                        docs.reserve(res.size());
+                        for (auto& doc : res) {
+                            docs.push_back(std::move(*doc));
+                        }
+                        cb({}, std::move(docs));
+                    });
+}
+
+std::vector<std::optional<transaction_get_result>>
+attempt_context_impl::get_optional_multi(const std::vector<core::document_id>& ids)
+{
+    auto barrier = std::make_shared<std::promise<std::vector<std::optional<transaction_get_result>>>>();
+    auto f = barrier->get_future();
+    get_optional_multi(ids, [barrier](std::exception_ptr err, std::vector<std::optional<transaction_get_result>> res) {
+        if (err) {
+            return barrier->set_exception(err);
+        }
+        return barrier->set_value(std::move(res));
+    });
+    return f.get();
+}
+
+void
+attempt_context_impl::get_optional_multi(const std::vector<core::document_id>& ids, OptionalMultiCallback&& cb)
+{
+    start_multi_get(*this, ids, true, op_list_.get_mode().is_query(), std::move(cb));
+}
+
+// state shared by the writes of one stage_batch
+struct attempt_context_impl::batch_state {
+    std::mutex mutex;
+    staged_write_batch batch;
+    std::vector<staged_write_result> results;
+    size_t remaining{ 0 };
+    std::exception_ptr first_error;
+    // the first write of the attempt also sets the ATR pending, so it has to complete before the others are sent
+    bool first_alone{ false };
+    // in query mode, or when the batch writes the same document twice, they go one at a time
+    bool serial{ false };
+    BatchCallback cb;
+};
+
+std::vector<staged_write_result>
+attempt_context_impl::stage_batch(const staged_write_batch& batch)
+{
+    auto barrier = std::make_shared<std::promise<std::vector<staged_write_result>>>();
+    auto f = barrier->get_future();
+    stage_batch(batch, [barrier](std::exception_ptr err, std::vector<staged_write_result> res) {
+        if (err) {
+            return barrier->set_exception(err);
+        }
+        return barrier->set_value(std::move(res));
+    });
+    return f.get();
+}
+
+void
+attempt_context_impl::stage_batch(const staged_write_batch& batch, BatchCallback&& cb)
+{
+    if (batch.empty()) {
+        return cb({}, {});
+    }
+    auto state = std::make_shared<batch_state>();
+    state->batch = batch;
+    state->results.resize(batch.size());
+    state->remaining = batch.size();
+    state->cb = std::move(cb);
+    state->serial = op_list_.get_mode().is_query();
+    if (!state->serial) {
+        // each write checks the staged mutations for an earlier write of the same document, which only works if
+        // that earlier write has finished
+        std::unordered_set<core::document_id, document_id_hash, document_id_equal> ids;
+        for (const auto& w : batch.writes()) {
+            if (!ids.insert(w.id).second) {
+                debug("batch writes {} more than once, staging it one write at a time", w.id);
+                state->serial = true;
+                break;
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        state->first_alone = !atr_id_.has_value();
+    }
+    if (state->serial || state->first_alone) {
+        return stage_batch_item(state, 0);
+    }
+    for (size_t i = 0; i < batch.size(); i++) {
+        stage_batch_item(state, i);
+    }
+}
+
+void
+attempt_context_impl::stage_batch_item(std::shared_ptr<batch_state> state, size_t index)
+{
+    const auto& w = state->batch.writes()[index];
+    auto done = [this, state, index](std::exception_ptr err, std::optional<transaction_get_result> res) {
+        finish_batch_item(state, index, err, std::move(res));
+    };
+    switch (w.type) {
+        case staged_write_batch::write_type::INSERT:
+            return insert_raw(w.id, w.content, std::move(done));
+        case staged_write_batch::write_type::REPLACE:
+            return replace_raw(*w.document, w.content, std::move(done));
+        case staged_write_batch::write_type::REMOVE:
+            return remove(*w.document, [done = std::move(done)](std::exception_ptr err) { done(err, std::nullopt); });
+    }
+}
+
+void
+attempt_context_impl::finish_batch_item(std::shared_ptr<batch_state> state,
+                                        size_t index,
+                                        std::exception_ptr err,
+                                        std::optional<transaction_get_result> res)
+{
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->results[index].document = std::move(res);
+    state->results[index].error = err;
+    if (err && !state->first_error) {
+        state->first_error = err;
+    }
+    size_t next = index + 1;
+    size_t end = next;
+    bool chained = state->serial || (state->first_alone && index == 0);
+    if (chained && err) {
+        // the rest never get sent
+        auto not_staged =
+          std::make_exception_ptr(transaction_operation_failed(FAIL_OTHER, "write not staged, as an earlier write in the batch failed"));
+        for (size_t i = next; i < state->results.size(); i++) {
+            state->results[i].error = not_staged;
+        }
+        state->remaining = 0;
+    } else {
+        --state->remaining;
+        if (chained) {
+            end = state->serial ? std::min(next + 1, state->results.size()) : state->results.size();
+        }
+    }
+    bool last = state->remaining == 0;
+    lock.unlock();
+    if (last) {
+        return state->cb(state->first_error, std::move(state->results));
+    }
+    for (size_t i = next; i < end; i++) {
+        stage_batch_item(state, i);
+    }
+}
+
+core::operations::mutate_in_request
+attempt_context_impl::create_staging_request(const core::document_id& id,
+                                             const transaction_get_result* document,
+                                             const std::string type,
+                                             std::optional<std::string> content)
+{
+    core::operations::mutate_in_request req{ id };
+    auto txn = staging_xattr_.write(type, document ? document->metadata() : std::nullopt);
     auto mut_specs =
-      couchbase::mutate_in_specs(couchbase::mutate_in_specs::upsert_raw("txn", core::utils::to_binary(jsonify(txn))).xattr().create_path());
+      couchbase::mutate_in_specs(couchbase::mutate_in_specs::upsert_raw("txn", core::utils::to_binary(txn)).xattr().create_path());
     if (type != "remove") {
         mut_specs.push_back(couchbase::mutate_in_specs::upsert_raw("txn.op.stgd", core::utils::to_binary(content.value())).xattr());
     }
@@ -464,6 +739,7 @@ attempt_context_impl::select_atr_if_needed_unlocked(const core::document_id& id,
         // TODO: cleanup the transaction_context - this should be set (threadsafe) from the above calls
         overall_.atr_collection(collection_spec_from_id(id));
         overall_.atr_id(atr_id_->key());
+        staging_xattr_ = txn_xattr_writer(overall_.transaction_id(), this->id(), *atr_id_);
         state(attempt_state::NOT_STARTED);
         trace("first mutated doc in transaction is \"{}\" on vbucket {}, so using atr \"{}\"", id, vbucket_id, atr_id_.value());
         set_atr_pending_locked(id, std::move(lock), cb);
@@ -475,8 +751,11 @@ template<typename Handler, typename Delay>
 void
 attempt_context_impl::check_atr_entry_for_blocking_document(const transaction_get_result& doc, Delay delay, Handler&& cb)
 {
-    try {
-        delay();
+    auto wait = next_delay(delay);
+    if (!wait) {
+        return cb(transaction_operation_failed(FAIL_WRITE_WRITE_CONFLICT, "document is in another transaction").retry());
+    }
+    async_delay(overall_.io_context(), *wait, [this, doc, delay, cb = std::move(cb)]() mutable {
         if (auto ec = hooks_.before_check_atr_entry_for_blocking_doc(this, doc.id().key())) {
             return cb(transaction_operation_failed(FAIL_WRITE_WRITE_CONFLICT, "document is in another transaction").retry());
         }
@@ -484,28 +763,34 @@ attempt_context_impl::check_atr_entry_for_blocking_document(const transaction_ge
                                  doc.links().atr_scope_name().value(),
                                  doc.links().atr_collection_name().value(),
                                  doc.links().atr_id().value());
-        active_transaction_record::get_atr(
-          cluster_ref(),
+        auto attempt_id = doc.links().staged_attempt_id();
+        if (!attempt_id) {
+            debug("no blocking atr entry");
+            return cb(std::nullopt);
+        }
+        if (auto state = terminal_attempt_cache::instance().find(*attempt_id)) {
+            debug("blocking attempt {} is known to be {}, can be ignored", *attempt_id, attempt_state_name(*state));
+            return cb(std::nullopt);
+        }
+        // only the entry we're blocked on is read
+        atr_reads_.get_entry(
           atr_id,
-          [this, delay = std::move(delay), cb = std::move(cb), doc = std::move(doc)](std::error_code err,
-                                                                                     std::optional<active_transaction_record> atr) {
+          *attempt_id,
+          [this, delay = std::move(delay), cb = std::move(cb), doc = std::move(doc)](std::error_code err, std::optional<atr_entry> entry) {
               if (!err) {
-                  auto entries = atr->entries();
-                  auto it = std::find_if(entries.begin(), entries.end(), [&doc](const atr_entry& e) {
-                      return e.attempt_id() == doc.links().staged_attempt_id();
-                  });
-                  if (it != entries.end()) {
-                      auto fwd_err = forward_compat::check(forward_compat_stage::WWC_READING_ATR, it->forward_compat());
+                  if (entry) {
+                      auto fwd_err = forward_compat::check(forward_compat_stage::WWC_READING_ATR, entry->forward_compat());
                       if (fwd_err) {
-                          return cb(fwd_err);
+                          return after_retry_delay(*fwd_err, [cb, fwd_err]() mutable { cb(fwd_err); });
                       }
-                      switch (it->state()) {
+                      terminal_attempt_cache::instance().add(*entry);
+                      switch (entry->state()) {
                           case attempt_state::COMPLETED:
                           case attempt_state::ROLLED_BACK:
-                              debug("existing atr entry can be ignored due to state {}", attempt_state_name(it->state()));
+                              debug("existing atr entry can be ignored due to state {}", attempt_state_name(entry->state()));
                               return cb(std::nullopt);
                           default:
-                              debug("existing atr entry found in state {}, retrying", attempt_state_name(it->state()));
+                              debug("existing atr entry found in state {}, retrying", attempt_state_name(entry->state()));
                       }
                       return check_atr_entry_for_blocking_document(doc, delay, cb);
                   } else {
@@ -516,9 +801,7 @@ attempt_context_impl::check_atr_entry_for_blocking_document(const transaction_ge
               // if we are here, there is still a write-write conflict
               return cb(transaction_operation_failed(FAIL_WRITE_WRITE_CONFLICT, "document is in another transaction").retry());
           });
-    } catch (const retry_operation_timeout& t) {
-        return cb(transaction_operation_failed(FAIL_WRITE_WRITE_CONFLICT, "document is in another transaction").retry());
-    }
+    });
 }
 void
 attempt_context_impl::remove(const transaction_get_result& document, VoidCallback&& cb)
@@ -1203,372 +1486,365 @@ attempt_context_impl::rollback_with_query(VoidCallback&& cb)
                });
 }
 void
-attempt_context_impl::atr_commit(bool ambiguity_resolution_mode)
+attempt_context_impl::atr_commit(bool ambiguity_resolution_mode, VoidCallback&& cb)
 {
-    retry_op<void>([this, &ambiguity_resolution_mode]() {
-        try {
-            std::string prefix(ATR_FIELD_ATTEMPTS + "." + id() + ".");
-            core::operations::mutate_in_request req{ atr_id_.value() };
-            req.specs =
-              couchbase::mutate_in_specs{
-                  couchbase::mutate_in_specs::upsert(prefix + ATR_FIELD_STATUS, attempt_state_name(attempt_state::COMMITTED)).xattr(),
-                  couchbase::mutate_in_specs::upsert(prefix + ATR_FIELD_START_COMMIT, subdoc::mutate_in_macro::cas).xattr(),
-                  couchbase::mutate_in_specs::insert(prefix + ATR_FIELD_PREVENT_COLLLISION, 0).xattr(),
-              }
-                .specs();
-            wrap_durable_request(req, overall_.config());
-            auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_COMMIT, {});
-            if (ec) {
-                throw client_error(*ec, "atr_commit check for expiry threw error");
-            }
-            if (!!(ec = hooks_.before_atr_commit(this))) {
-                // for now, throw.  Later, if this is async, we will use error handler no doubt.
-                throw client_error(*ec, "before_atr_commit hook raised error");
-            }
-            staged_mutations_->extract_to(prefix, req);
-            auto barrier = std::make_shared<std::promise<result>>();
-            auto f = barrier->get_future();
-            trace("updating atr {}", req.id);
-            overall_.cluster_ref().execute(
-              req, [barrier](core::operations::mutate_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
-            auto res = wrap_operation_future(f, false);
-            ec = hooks_.after_atr_commit(this);
-            if (ec) {
-                throw client_error(*ec, "after_atr_commit hook raised error");
+    auto error_handler = [this, ambiguity_resolution_mode, cb](error_class ec, const std::string& message) {
+        auto retry = [this, cb](bool ambiguity_resolution_mode) {
+            async_delay(overall_.io_context(), DEFAULT_RETRY_OP_DELAY, [this, ambiguity_resolution_mode, cb]() mutable {
+                atr_commit(ambiguity_resolution_mode, std::move(cb));
+            });
+        };
+        switch (ec) {
+            case FAIL_EXPIRY: {
+                expiry_overtime_mode_ = true;
+                auto out = transaction_operation_failed(ec, message).no_rollback();
+                if (ambiguity_resolution_mode) {
+                    out.ambiguous();
+                } else {
+                    out.expired();
+                }
+                return cb(std::make_exception_ptr(out));
             }
-            state(attempt_state::COMMITTED);
-        } catch (const client_error& e) {
-            error_class ec = e.ec();
-            switch (ec) {
-                case FAIL_EXPIRY: {
-                    expiry_overtime_mode_ = true;
-                    auto out = transaction_operation_failed(ec, e.what()).no_rollback();
-                    if (ambiguity_resolution_mode) {
-                        out.ambiguous();
-                    } else {
-                        out.expired();
-                    }
-                    throw out;
+            case FAIL_AMBIGUOUS:
+                debug("atr_commit got FAIL_AMBIGUOUS, resolving ambiguity...");
+                return retry(true);
+            case FAIL_TRANSIENT:
+                if (ambiguity_resolution_mode) {
+                    return retry(ambiguity_resolution_mode);
                 }
-                case FAIL_AMBIGUOUS:
-                    debug("atr_commit got FAIL_AMBIGUOUS, resolving ambiguity...");
-                    ambiguity_resolution_mode = true;
-                    throw retry_operation(e.what());
-                case FAIL_TRANSIENT:
-                    if (ambiguity_resolution_mode) {
-                        throw retry_operation(e.what());
-                    }
-                    throw transaction_operation_failed(ec, e.what()).retry();
-
-                case FAIL_PATH_ALREADY_EXISTS:
-                    // Need retry_op as atr_commit_ambiguity_resolution can throw retry_operation
-                    return retry_op<void>([&]() { return atr_commit_ambiguity_resolution(); });
-                case FAIL_HARD: {
-                    auto out = transaction_operation_failed(ec, e.what()).no_rollback();
-                    if (ambiguity_resolution_mode) {
-                        out.ambiguous();
-                    }
-                    throw out;
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).retry()));
+            case FAIL_PATH_ALREADY_EXISTS:
+                return atr_commit_ambiguity_resolution(std::move(cb));
+            case FAIL_HARD: {
+                auto out = transaction_operation_failed(ec, message).no_rollback();
+                if (ambiguity_resolution_mode) {
+                    out.ambiguous();
                 }
-                case FAIL_DOC_NOT_FOUND: {
-                    auto out = transaction_operation_failed(ec, e.what())
-                                 .cause(external_exception::ACTIVE_TRANSACTION_RECORD_NOT_FOUND)
-                                 .no_rollback();
-                    if (ambiguity_resolution_mode) {
-                        out.ambiguous();
-                    }
-                    throw out;
+                return cb(std::make_exception_ptr(out));
+            }
+            case FAIL_DOC_NOT_FOUND: {
+                auto out =
+                  transaction_operation_failed(ec, message).cause(external_exception::ACTIVE_TRANSACTION_RECORD_NOT_FOUND).no_rollback();
+                if (ambiguity_resolution_mode) {
+                    out.ambiguous();
                 }
-                case FAIL_PATH_NOT_FOUND: {
-                    auto out = transaction_operation_failed(ec, e.what())
-                                 .cause(external_exception::ACTIVE_TRANSACTION_RECORD_ENTRY_NOT_FOUND)
-                                 .no_rollback();
-                    if (ambiguity_resolution_mode) {
-                        out.ambiguous();
-                    }
-                    throw out;
+                return cb(std::make_exception_ptr(out));
+            }
+            case FAIL_PATH_NOT_FOUND: {
+                auto out = transaction_operation_failed(ec, message)
+                             .cause(external_exception::ACTIVE_TRANSACTION_RECORD_ENTRY_NOT_FOUND)
+                             .no_rollback();
+                if (ambiguity_resolution_mode) {
+                    out.ambiguous();
                 }
-                case FAIL_ATR_FULL: {
-                    auto out =
-                      transaction_operation_failed(ec, e.what()).cause(external_exception::ACTIVE_TRANSACTION_RECORD_FULL).no_rollback();
-                    if (ambiguity_resolution_mode) {
-                        out.ambiguous();
-                    }
-                    throw out;
+                return cb(std::make_exception_ptr(out));
+            }
+            case FAIL_ATR_FULL: {
+                auto out =
+                  transaction_operation_failed(ec, message).cause(external_exception::ACTIVE_TRANSACTION_RECORD_FULL).no_rollback();
+                if (ambiguity_resolution_mode) {
+                    out.ambiguous();
                 }
-                default: {
-                    error("failed to commit transaction {}, attempt {}, ambiguity_resolution_mode {}, with error {}",
-                          transaction_id(),
-                          id(),
-                          ambiguity_resolution_mode,
-                          e.what());
-                    auto out = transaction_operation_failed(ec, e.what());
-                    if (ambiguity_resolution_mode) {
-                        out.no_rollback().ambiguous();
-                    }
-                    throw out;
+                return cb(std::make_exception_ptr(out));
+            }
+            default: {
+                error("failed to commit transaction {}, attempt {}, ambiguity_resolution_mode {}, with error {}",
+                      transaction_id(),
+                      id(),
+                      ambiguity_resolution_mode,
+                      message);
+                auto out = transaction_operation_failed(ec, message);
+                if (ambiguity_resolution_mode) {
+                    out.no_rollback().ambiguous();
                 }
+                return cb(std::make_exception_ptr(out));
             }
         }
+    };
+    core::operations::mutate_in_request req{ atr_id_.value() };
+    req.specs =
+      couchbase::mutate_in_specs{
+          couchbase::mutate_in_specs::upsert(atr_paths_.status, attempt_state_name(attempt_state::COMMITTED)).xattr(),
+          couchbase::mutate_in_specs::upsert(atr_paths_.start_commit, subdoc::mutate_in_macro::cas).xattr(),
+          couchbase::mutate_in_specs::insert(atr_paths_.prevent_collision, 0).xattr(),
+      }
+        .specs();
+    wrap_durable_request(req, overall_.config());
+    auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_COMMIT, {});
+    if (ec) {
+        return error_handler(*ec, "atr_commit check for expiry threw error");
+    }
+    if (!!(ec = hooks_.before_atr_commit(this))) {
+        return error_handler(*ec, "before_atr_commit hook raised error");
+    }
+    staged_mutations_->extract_to(atr_paths_, req);
+    trace("updating atr {}", req.id);
+    overall_.cluster_ref().execute(req, [this, cb, error_handler](core::operations::mutate_in_response resp) {
+        auto ec = error_class_from_response(resp);
+        if (ec) {
+            return error_handler(*ec, resp.ctx.ec().message());
+        }
+        if (!!(ec = hooks_.after_atr_commit(this))) {
+            return error_handler(*ec, "after_atr_commit hook raised error");
+        }
+        state(attempt_state::COMMITTED);
+        return cb({});
     });
 }
 
 void
-attempt_context_impl::atr_commit_ambiguity_resolution()
+attempt_context_impl::atr_commit_ambiguity_resolution(VoidCallback&& cb)
 {
-    try {
-        auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_COMMIT_AMBIGUITY_RESOLUTION, {});
-        if (ec) {
-            throw client_error(*ec, "atr_commit_ambiguity_resolution raised error");
-        }
-        if (!!(ec = hooks_.before_atr_commit_ambiguity_resolution(this))) {
-            throw client_error(*ec, "before_atr_commit_ambiguity_resolution hook threw error");
-        }
-        std::string prefix(ATR_FIELD_ATTEMPTS + "." + id() + ".");
-        core::operations::lookup_in_request req{ atr_id_.value() };
-        req.specs = lookup_in_specs{ lookup_in_specs::get(prefix + ATR_FIELD_STATUS).xattr() }.specs();
-        wrap_request(req, overall_.config());
-        auto barrier = std::make_shared<std::promise<result>>();
-        auto f = barrier->get_future();
-        overall_.cluster_ref().execute(
-          req, [barrier](core::operations::lookup_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
-        auto res = wrap_operation_future(f);
-        auto atr_status_raw = res.values[0].content_as<std::string>();
-        debug("atr_commit_ambiguity_resolution read atr state {}", atr_status_raw);
-        auto atr_status = attempt_state_value(atr_status_raw);
-        switch (atr_status) {
-            case attempt_state::COMMITTED:
-                return;
-            case attempt_state::ABORTED:
-                // aborted by another process?
-                throw transaction_operation_failed(FAIL_OTHER, "transaction aborted externally").retry();
-            default:
-                throw transaction_operation_failed(FAIL_OTHER, "unexpected state found on ATR ambiguity resolution")
-                  .cause(ILLEGAL_STATE_EXCEPTION)
-                  .no_rollback();
-        }
-    } catch (const client_error& e) {
-        error_class ec = e.ec();
+    auto error_handler = [this, cb](error_class ec, const std::string& message) {
         switch (ec) {
             case FAIL_EXPIRY:
-                throw transaction_operation_failed(ec, e.what()).no_rollback().ambiguous();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().ambiguous()));
             case FAIL_HARD:
-                throw transaction_operation_failed(ec, e.what()).no_rollback().ambiguous();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().ambiguous()));
             case FAIL_TRANSIENT:
             case FAIL_OTHER:
-                throw retry_operation(e.what());
+                return async_delay(overall_.io_context(), DEFAULT_RETRY_OP_DELAY, [this, cb]() mutable {
+                    atr_commit_ambiguity_resolution(std::move(cb));
+                });
             case FAIL_PATH_NOT_FOUND:
-                throw transaction_operation_failed(ec, e.what()).cause(ACTIVE_TRANSACTION_RECORD_ENTRY_NOT_FOUND).no_rollback().ambiguous();
+                return cb(std::make_exception_ptr(
+                  transaction_operation_failed(ec, message).cause(ACTIVE_TRANSACTION_RECORD_ENTRY_NOT_FOUND).no_rollback().ambiguous()));
             case FAIL_DOC_NOT_FOUND:
-                throw transaction_operation_failed(ec, e.what()).cause(ACTIVE_TRANSACTION_RECORD_NOT_FOUND).no_rollback().ambiguous();
+                return cb(std::make_exception_ptr(
+                  transaction_operation_failed(ec, message).cause(ACTIVE_TRANSACTION_RECORD_NOT_FOUND).no_rollback().ambiguous()));
             default:
-                throw transaction_operation_failed(ec, e.what()).no_rollback().ambiguous();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().ambiguous()));
         }
+    };
+    auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_COMMIT_AMBIGUITY_RESOLUTION, {});
+    if (ec) {
+        return error_handler(*ec, "atr_commit_ambiguity_resolution raised error");
     }
+    if (!!(ec = hooks_.before_atr_commit_ambiguity_resolution(this))) {
+        return error_handler(*ec, "before_atr_commit_ambiguity_resolution hook threw error");
+    }
+    core::operations::lookup_in_request req{ atr_id_.value() };
+    req.specs = lookup_in_specs{ lookup_in_specs::get(atr_paths_.status).xattr() }.specs();
+    wrap_request(req, overall_.config());
+    overall_.cluster_ref().execute(req, [this, cb, error_handler](core::operations::lookup_in_response resp) {
+        auto ec = error_class_from_response(resp);
+        if (ec) {
+            return error_handler(*ec, resp.ctx.ec().message());
+        }
+        if (resp.fields.empty() || resp.fields[0].status != key_value_status_code::success) {
+            return error_handler(FAIL_PATH_NOT_FOUND, "attempt not found in atr during ambiguity resolution");
+        }
+        auto res = result::create_from_subdoc_response(resp);
+        auto atr_status_raw = res.values[0].content_as<std::string>();
+        debug("atr_commit_ambiguity_resolution read atr state {}", atr_status_raw);
+        auto atr_status = attempt_state_value(atr_status_raw);
+        switch (atr_status) {
+            case attempt_state::COMMITTED:
+                return cb({});
+            case attempt_state::ABORTED:
+                // aborted by another process?
+                return cb(std::make_exception_ptr(transaction_operation_failed(FAIL_OTHER, "transaction aborted externally").retry()));
+            default:
+                return cb(std::make_exception_ptr(
+                  transaction_operation_failed(FAIL_OTHER, "unexpected state found on ATR ambiguity resolution")
+                    .cause(ILLEGAL_STATE_EXCEPTION)
+                    .no_rollback()));
+        }
+    });
 }
 
 void
-attempt_context_impl::atr_complete()
+attempt_context_impl::atr_complete(VoidCallback&& cb)
 {
-    try {
-        result atr_res;
-        auto ec = hooks_.before_atr_complete(this);
-        if (ec) {
-            throw client_error(*ec, "before_atr_complete hook threw error");
-        }
-        // if we have expired (and not in overtime mode), just raise the final error.
-        if (!!(ec = error_if_expired_and_not_in_overtime(STAGE_ATR_COMPLETE, {}))) {
-            throw client_error(*ec, "atr_complete threw error");
-        }
-        debug("removing attempt {} from atr", atr_id_.value());
-        std::string prefix(ATR_FIELD_ATTEMPTS + "." + id());
-        core::operations::mutate_in_request req{ atr_id_.value() };
-        req.specs =
-          couchbase::mutate_in_specs{
-              couchbase::mutate_in_specs::remove(prefix).xattr(),
-          }
-            .specs();
-        wrap_durable_request(req, overall_.config());
-        auto barrier = std::make_shared<std::promise<result>>();
-        auto f = barrier->get_future();
-        overall_.cluster_ref().execute(
-          req, [barrier](core::operations::mutate_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
-        wrap_operation_future(f);
-        ec = hooks_.after_atr_complete(this);
-        if (ec) {
-            throw client_error(*ec, "after_atr_complete hook threw error");
-        }
-        state(attempt_state::COMPLETED);
-    } catch (const client_error& er) {
-        error_class ec = er.ec();
+    auto error_handler = [this, cb](error_class ec, const std::string& message) {
         switch (ec) {
             case FAIL_HARD:
-                throw transaction_operation_failed(ec, er.what()).no_rollback().failed_post_commit();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().failed_post_commit()));
             default:
-                info("ignoring error in atr_complete {}", er.what());
+                info("ignoring error in atr_complete {}", message);
+                return cb({});
         }
+    };
+    auto ec = hooks_.before_atr_complete(this);
+    if (ec) {
+        return error_handler(*ec, "before_atr_complete hook threw error");
+    }
+    // if we have expired (and not in overtime mode), just raise the final error.
+    if (!!(ec = error_if_expired_and_not_in_overtime(STAGE_ATR_COMPLETE, {}))) {
+        return error_handler(*ec, "atr_complete threw error");
     }
+    debug("removing attempt {} from atr", atr_id_.value());
+    core::operations::mutate_in_request req{ atr_id_.value() };
+    req.specs =
+      couchbase::mutate_in_specs{
+          couchbase::mutate_in_specs::remove(atr_paths_.entry).xattr(),
+      }
+        .specs();
+    wrap_durable_request(req, overall_.config());
+    overall_.cluster_ref().execute(req, [this, cb, error_handler](core::operations::mutate_in_response resp) {
+        auto ec = error_class_from_response(resp);
+        if (ec) {
+            return error_handler(*ec, resp.ctx.ec().message());
+        }
+        if (!!(ec = hooks_.after_atr_complete(this))) {
+            return error_handler(*ec, "after_atr_complete hook threw error");
+        }
+        state(attempt_state::COMPLETED);
+        return cb({});
+    });
 }
+
 void
 attempt_context_impl::commit(VoidCallback&& cb)
 {
-    // for now, lets keep the blocking implementation
-    std::thread t([cb = std::move(cb), this]() mutable {
-        try {
-            commit();
+    // wrap the callback, so that whatever the failure, the caller sees a transaction_operation_failed
+    auto done = [cb = std::move(cb)](std::exception_ptr err) {
+        if (!err) {
             return cb({});
-        } catch (const transaction_operation_failed& e) {
+        }
+        try {
+            std::rethrow_exception(err);
+        } catch (const transaction_operation_failed&) {
             return cb(std::current_exception());
         } catch (const std::exception& e) {
             return cb(std::make_exception_ptr(transaction_operation_failed(FAIL_OTHER, e.what())));
+        } catch (...) {
+            return cb(std::make_exception_ptr(transaction_operation_failed(FAIL_OTHER, "unexpected exception during commit")));
         }
-    });
-    t.detach();
-}
-
-void
-attempt_context_impl::commit()
-{
+    };
     debug("waiting on ops to finish...");
-    op_list_.wait_and_block_ops();
-    existing_error();
-    debug("commit {}", id());
-    if (op_list_.get_mode().is_query()) {
-        auto barrier = std::make_shared<std::promise<void>>();
-        auto f = barrier->get_future();
-        commit_with_query([barrier](std::exception_ptr err) {
-            if (err) {
-                barrier->set_exception(err);
-            } else {
-                barrier->set_value();
+    op_list_.wait_and_block_ops([this, done = std::move(done)]() mutable {
+        try {
+            existing_error();
+            debug("commit {}", id());
+            if (op_list_.get_mode().is_query()) {
+                return commit_with_query(std::move(done));
+            }
+            if (check_expiry_pre_commit(STAGE_BEFORE_COMMIT, {})) {
+                return done(std::make_exception_ptr(transaction_operation_failed(FAIL_EXPIRY, "transaction expired").expired()));
+            }
+            if (atr_id_ && !atr_id_->key().empty() && !is_done_) {
+                // each step hands off to the next from its KV callback, no thread waits on any of them.
+                return atr_commit(false, [this, done](std::exception_ptr err) {
+                    if (err) {
+                        return done(err);
+                    }
+                    staged_mutations_->commit(*this, [this, done](std::exception_ptr err) {
+                        if (err) {
+                            return done(err);
+                        }
+                        atr_complete([this, done](std::exception_ptr err) {
+                            if (err) {
+                                return done(err);
+                            }
+                            is_done_ = true;
+                            return done({});
+                        });
+                    });
+                });
             }
-        });
-        f.get();
-    } else {
-        if (check_expiry_pre_commit(STAGE_BEFORE_COMMIT, {})) {
-            throw transaction_operation_failed(FAIL_EXPIRY, "transaction expired").expired();
-        }
-        if (atr_id_ && !atr_id_->key().empty() && !is_done_) {
-            retry_op_exp<void>([&]() { atr_commit(false); });
-            staged_mutations_->commit(*this);
-            atr_complete();
-            is_done_ = true;
-        } else {
             // no mutation, no need to commit
             if (!is_done_) {
                 debug("calling commit on attempt that has got no mutations, skipping");
                 is_done_ = true;
-                return;
-            } else {
-                // do not rollback or retry
-                throw transaction_operation_failed(FAIL_OTHER, "calling commit on attempt that is already completed").no_rollback();
+                return done({});
             }
+            // do not rollback or retry
+            return done(std::make_exception_ptr(
+              transaction_operation_failed(FAIL_OTHER, "calling commit on attempt that is already completed").no_rollback()));
+        } catch (...) {
+            return done(std::current_exception());
         }
-    }
+    });
 }
 
 void
-attempt_context_impl::atr_abort()
+attempt_context_impl::commit()
 {
-    try {
-        auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_ABORT, {});
-        if (ec) {
-            throw client_error(*ec, "atr_abort check for expiry threw error");
-        }
-        if (!!(ec = hooks_.before_atr_aborted(this))) {
-            throw client_error(*ec, "before_atr_aborted hook threw error");
-        }
-        std::string prefix(ATR_FIELD_ATTEMPTS + "." + id() + ".");
-        core::operations::mutate_in_request req{ atr_id_.value() };
-        req.specs =
-          couchbase::mutate_in_specs{
-              couchbase::mutate_in_specs::upsert(prefix + ATR_FIELD_STATUS, attempt_state_name(attempt_state::ABORTED))
-                .xattr()
-                .create_path(),
-              couchbase::mutate_in_specs::upsert(prefix + ATR_FIELD_TIMESTAMP_ROLLBACK_START, subdoc::mutate_in_macro::cas)
-                .xattr()
-                .create_path(),
-          }
-            .specs();
-        staged_mutations_->extract_to(prefix, req);
-        wrap_durable_request(req, overall_.config());
-        auto barrier = std::make_shared<std::promise<result>>();
-        auto f = barrier->get_future();
-        overall_.cluster_ref().execute(
-          req, [barrier](core::operations::mutate_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
-        wrap_operation_future(f);
-        state(attempt_state::ABORTED);
-        ec = hooks_.after_atr_aborted(this);
-        if (ec) {
-            throw client_error(*ec, "after_atr_aborted hook threw error");
+    auto barrier = std::make_shared<std::promise<void>>();
+    auto f = barrier->get_future();
+    commit([barrier](std::exception_ptr err) {
+        if (err) {
+            barrier->set_exception(err);
+        } else {
+            barrier->set_value();
         }
-        debug("rollback completed atr abort phase");
-    } catch (const client_error& e) {
-        auto ec = e.ec();
-        trace("atr_abort got {} {}", ec, e.what());
+    });
+    f.get();
+}
+
+void
+attempt_context_impl::atr_abort(VoidCallback&& cb)
+{
+    auto error_handler = [this, cb](error_class ec, const std::string& message) {
+        trace("atr_abort got {} {}", ec, message);
         if (expiry_overtime_mode_.load()) {
-            debug("atr_abort got error {} while in overtime mode", e.what());
-            throw transaction_operation_failed(FAIL_EXPIRY, std::string("expired in atr_abort with {} ") + e.what())
-              .no_rollback()
-              .expired();
+            debug("atr_abort got error {} while in overtime mode", message);
+            return cb(std::make_exception_ptr(
+              transaction_operation_failed(FAIL_EXPIRY, std::string("expired in atr_abort with {} ") + message).no_rollback().expired()));
         }
         debug("atr_abort got error {}", ec);
         switch (ec) {
             case FAIL_EXPIRY:
                 expiry_overtime_mode_ = true;
-                throw retry_operation("expired, setting overtime mode and retry atr_abort");
+                return cb(std::make_exception_ptr(retry_operation("expired, setting overtime mode and retry atr_abort")));
             case FAIL_PATH_NOT_FOUND:
-                throw transaction_operation_failed(ec, e.what()).no_rollback().cause(ACTIVE_TRANSACTION_RECORD_ENTRY_NOT_FOUND);
+                return cb(std::make_exception_ptr(
+                  transaction_operation_failed(ec, message).no_rollback().cause(ACTIVE_TRANSACTION_RECORD_ENTRY_NOT_FOUND)));
             case FAIL_DOC_NOT_FOUND:
-                throw transaction_operation_failed(ec, e.what()).no_rollback().cause(ACTIVE_TRANSACTION_RECORD_NOT_FOUND);
+                return cb(std::make_exception_ptr(
+                  transaction_operation_failed(ec, message).no_rollback().cause(ACTIVE_TRANSACTION_RECORD_NOT_FOUND)));
             case FAIL_ATR_FULL:
-                throw transaction_operation_failed(ec, e.what()).no_rollback().cause(ACTIVE_TRANSACTION_RECORD_FULL);
+                return cb(
+                  std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().cause(ACTIVE_TRANSACTION_RECORD_FULL)));
             case FAIL_HARD:
-                throw transaction_operation_failed(ec, e.what()).no_rollback();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback()));
             default:
-                throw retry_operation("retry atr_abort");
+                return cb(std::make_exception_ptr(retry_operation("retry atr_abort")));
         }
+    };
+    auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_ABORT, {});
+    if (ec) {
+        return error_handler(*ec, "atr_abort check for expiry threw error");
     }
-}
-
-void
-attempt_context_impl::atr_rollback_complete()
-{
-    try {
-        auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_ROLLBACK_COMPLETE, std::nullopt);
+    if (!!(ec = hooks_.before_atr_aborted(this))) {
+        return error_handler(*ec, "before_atr_aborted hook threw error");
+    }
+    core::operations::mutate_in_request req{ atr_id_.value() };
+    req.specs =
+      couchbase::mutate_in_specs{
+          couchbase::mutate_in_specs::upsert(atr_paths_.status, attempt_state_name(attempt_state::ABORTED)).xattr().create_path(),
+          couchbase::mutate_in_specs::upsert(atr_paths_.timestamp_rollback_start, subdoc::mutate_in_macro::cas)
+            .xattr()
+            .create_path(),
+      }
+        .specs();
+    staged_mutations_->extract_to(atr_paths_, req);
+    wrap_durable_request(req, overall_.config());
+    overall_.cluster_ref().execute(req, [this, cb, error_handler](core::operations::mutate_in_response resp) {
+        auto ec = error_class_from_response(resp);
         if (ec) {
-            throw client_error(*ec, "atr_rollback_complete raised error");
-        }
-        if (!!(ec = hooks_.before_atr_rolled_back(this))) {
-            throw client_error(*ec, "before_atr_rolled_back hook threw error");
+            return error_handler(*ec, resp.ctx.ec().message());
         }
-        std::string prefix(ATR_FIELD_ATTEMPTS + "." + id());
-        core::operations::mutate_in_request req{ atr_id_.value() };
-        req.specs =
-          couchbase::mutate_in_specs{
-              couchbase::mutate_in_specs::remove(prefix).xattr(),
-          }
-            .specs();
-        wrap_durable_request(req, overall_.config());
-        auto barrier = std::make_shared<std::promise<result>>();
-        auto f = barrier->get_future();
-        overall_.cluster_ref().execute(
-          req, [barrier](core::operations::mutate_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
-        wrap_operation_future(f);
-        state(attempt_state::ROLLED_BACK);
-        ec = hooks_.after_atr_rolled_back(this);
-        if (ec) {
-            throw client_error(*ec, "after_atr_rolled_back hook threw error");
+        state(attempt_state::ABORTED);
+        if (!!(ec = hooks_.after_atr_aborted(this))) {
+            return error_handler(*ec, "after_atr_aborted hook threw error");
         }
-        is_done_ = true;
+        debug("rollback completed atr abort phase");
+        return cb({});
+    });
+}
 
-    } catch (const client_error& e) {
-        auto ec = e.ec();
+void
+attempt_context_impl::atr_rollback_complete(VoidCallback&& cb)
+{
+    auto error_handler = [this, cb](error_class ec, const std::string& message) {
         if (expiry_overtime_mode_.load()) {
-            debug("atr_rollback_complete error while in overtime mode {}", e.what());
-            throw transaction_operation_failed(FAIL_EXPIRY, std::string("expired in atr_rollback_complete with {} ") + e.what())
-              .no_rollback()
-              .expired();
+            debug("atr_rollback_complete error while in overtime mode {}", message);
+            return cb(std::make_exception_ptr(
+              transaction_operation_failed(FAIL_EXPIRY, std::string("expired in atr_rollback_complete with {} ") + message)
+                .no_rollback()
+                .expired()));
         }
         debug("atr_rollback_complete got error {}", ec);
         switch (ec) {
@@ -1576,90 +1852,126 @@ attempt_context_impl::atr_rollback_complete()
             case FAIL_PATH_NOT_FOUND:
                 debug("atr {} not found, ignoring", atr_id_->key());
                 is_done_ = true;
-                break;
+                return cb({});
             case FAIL_ATR_FULL:
                 debug("atr {} full!", atr_id_->key());
-                throw retry_operation(e.what());
+                return cb(std::make_exception_ptr(retry_operation(message)));
             case FAIL_HARD:
-                throw transaction_operation_failed(ec, e.what()).no_rollback();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback()));
             case FAIL_EXPIRY:
                 debug("timed out writing atr {}", atr_id_->key());
-                throw transaction_operation_failed(ec, e.what()).no_rollback().expired();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().expired()));
             default:
                 debug("retrying atr_rollback_complete");
-                throw retry_operation(e.what());
+                return cb(std::make_exception_ptr(retry_operation(message)));
         }
+    };
+    auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_ROLLBACK_COMPLETE, std::nullopt);
+    if (ec) {
+        return error_handler(*ec, "atr_rollback_complete raised error");
+    }
+    if (!!(ec = hooks_.before_atr_rolled_back(this))) {
+        return error_handler(*ec, "before_atr_rolled_back hook threw error");
     }
+    core::operations::mutate_in_request req{ atr_id_.value() };
+    req.specs =
+      couchbase::mutate_in_specs{
+          couchbase::mutate_in_specs::remove(atr_paths_.entry).xattr(),
+      }
+        .specs();
+    wrap_durable_request(req, overall_.config());
+    overall_.cluster_ref().execute(req, [this, cb, error_handler](core::operations::mutate_in_response resp) {
+        auto ec = error_class_from_response(resp);
+        if (ec) {
+            return error_handler(*ec, resp.ctx.ec().message());
+        }
+        state(attempt_state::ROLLED_BACK);
+        if (!!(ec = hooks_.after_atr_rolled_back(this))) {
+            return error_handler(*ec, "after_atr_rolled_back hook threw error");
+        }
+        is_done_ = true;
+        return cb({});
+    });
 }
+
 void
 attempt_context_impl::rollback(VoidCallback&& cb)
 {
-    // for now, lets keep the blocking implementation
-    std::thread t([cb = std::move(cb), this]() mutable {
-        if (op_list_.get_mode().is_query()) {
-            return rollback_with_query(std::move(cb));
+    // wrap the callback, so that whatever the failure, the caller sees a transaction_operation_failed
+    auto done = [this, cb = std::move(cb)](std::exception_ptr err) {
+        if (!err) {
+            return cb({});
         }
         try {
-            rollback();
-            return cb({});
-        } catch (const transaction_operation_failed& e) {
+            std::rethrow_exception(err);
+        } catch (const transaction_operation_failed&) {
             return cb(std::current_exception());
+        } catch (const client_error& e) {
+            error("rollback transaction {}, attempt {} fail with error {}", transaction_id(), id(), e.what());
+            if (e.ec() == FAIL_HARD) {
+                return cb(std::make_exception_ptr(transaction_operation_failed(e.ec(), e.what()).no_rollback()));
+            }
+            return cb({});
         } catch (const std::exception& e) {
             return cb(std::make_exception_ptr(transaction_operation_failed(FAIL_OTHER, e.what()).no_rollback()));
         } catch (...) {
             return cb(std::make_exception_ptr(transaction_operation_failed(FAIL_OTHER, "unexpected exception during rollback")));
         }
+    };
+    op_list_.wait_and_block_ops([this, done = std::move(done)]() mutable {
+        debug("rolling back {}", id());
+        if (op_list_.get_mode().is_query()) {
+            return rollback_with_query(std::move(done));
+        }
+        // check for expiry
+        check_expiry_during_commit_or_rollback(STAGE_ROLLBACK, std::nullopt);
+        if (!atr_id_ || atr_id_->key().empty() || state() == attempt_state::NOT_STARTED) {
+            // TODO: check this, but if we try to rollback an empty txn, we should prevent a subsequent commit
+            debug("rollback called on txn with no mutations");
+            is_done_ = true;
+            return done({});
+        }
+        if (is_done()) {
+            std::string msg("Transaction already done, cannot rollback");
+            error(msg);
+            // need to raise a FAIL_OTHER which is not retryable or rollback-able
+            return done(std::make_exception_ptr(transaction_operation_failed(FAIL_OTHER, msg).no_rollback()));
+        }
+        // (1) atr_abort
+        async_retry_op_exp(
+          overall_.io_context(),
+          [this](async_retry_handler handler) { atr_abort(std::move(handler)); },
+          [this, done](std::exception_ptr err) {
+              if (err) {
+                  return done(err);
+              }
+              // (2) rollback staged mutations
+              staged_mutations_->rollback(*this, [this, done](std::exception_ptr err) {
+                  if (err) {
+                      return done(err);
+                  }
+                  debug("rollback completed unstaging docs");
+                  // (3) atr_rollback
+                  async_retry_op_exp(
+                    overall_.io_context(), [this](async_retry_handler handler) { atr_rollback_complete(std::move(handler)); }, done);
+              });
+          });
     });
-    t.detach();
 }
 
 void
 attempt_context_impl::rollback()
 {
-    op_list_.wait_and_block_ops();
-    debug("rolling back {}", id());
-    if (op_list_.get_mode().is_query()) {
-        auto barrier = std::make_shared<std::promise<void>>();
-        auto f = barrier->get_future();
-        rollback_with_query([barrier](std::exception_ptr err) {
-            if (err) {
-                barrier->set_exception(err);
-            } else {
-                barrier->set_value();
-            }
-        });
-        return f.get();
-    }
-    // check for expiry
-    check_expiry_during_commit_or_rollback(STAGE_ROLLBACK, std::nullopt);
-    if (!atr_id_ || atr_id_->key().empty() || state() == attempt_state::NOT_STARTED) {
-        // TODO: check this, but if we try to rollback an empty txn, we should prevent a subsequent commit
-        debug("rollback called on txn with no mutations");
-        is_done_ = true;
-        return;
-    }
-    if (is_done()) {
-        std::string msg("Transaction already done, cannot rollback");
-        error(msg);
-        // need to raise a FAIL_OTHER which is not retryable or rollback-able
-        throw transaction_operation_failed(FAIL_OTHER, msg).no_rollback();
-    }
-    try {
-        // (1) atr_abort
-        retry_op_exp<void>([&] { atr_abort(); });
-        // (2) rollback staged mutations
-        staged_mutations_->rollback(*this);
-        debug("rollback completed unstaging docs");
-
-        // (3) atr_rollback
-        retry_op_exp<void>([&] { atr_rollback_complete(); });
-    } catch (const client_error& e) {
-        error_class ec = e.ec();
-        error("rollback transaction {}, attempt {} fail with error {}", transaction_id(), id(), e.what());
-        if (ec == FAIL_HARD) {
-            throw transaction_operation_failed(ec, e.what()).no_rollback();
+    auto barrier = std::make_shared<std::promise<void>>();
+    auto f = barrier->get_future();
+    rollback([barrier](std::exception_ptr err) {
+        if (err) {
+            barrier->set_exception(err);
+        } else {
+            barrier->set_value();
         }
-    }
+    });
+    f.get();
 }
 
 bool
@@ -1723,14 +2035,13 @@ attempt_context_impl::set_atr_pending_locked(const core::document_id& id, std::u
 {
     try {
         if (staged_mutations_->empty()) {
-            std::string prefix(ATR_FIELD_ATTEMPTS + "." + this->id() + ".");
             if (!atr_id_) {
                 return fn(transaction_operation_failed(FAIL_OTHER, std::string("ATR ID is not initialized")));
             }
             if (auto ec = error_if_expired_and_not_in_overtime(STAGE_ATR_PENDING, {})) {
                 return fn(transaction_operation_failed(*ec, "transaction expired setting ATR").expired());
             }
-            auto error_handler = [this, &lock, fn](error_class ec, const std::string& message, const core::document_id& id) {
+            auto error_handler = [this, fn](error_class ec, const std::string& message, const core::document_id& id) {
                 transaction_operation_failed err(ec, message);
                 trace("got {} trying to set atr to pending", message);
                 if (expiry_overtime_mode_.load()) {
@@ -1748,10 +2059,12 @@ attempt_context_impl::set_atr_pending_locked(const core::document_id& id, std::u
                         return fn(std::nullopt);
                     case FAIL_AMBIGUOUS:
                         // Retry just this
-                        overall_.retry_delay();
-                        // keep it locked!
                         debug("got {}, retrying set atr pending", ec);
-                        return set_atr_pending_locked(id, std::move(lock), fn);
+                        return overall_.retry_delay([this, id, fn]() {
+                            // retake the lock, the one we were called with went away with the caller
+                            std::unique_lock<std::mutex> lock(mutex_);
+                            set_atr_pending_locked(id, std::move(lock), fn);
+                        });
                     case FAIL_TRANSIENT:
                         // Retry txn
                         return fn(err.retry());
@@ -1779,16 +2092,16 @@ attempt_context_impl::set_atr_pending_locked(const core::document_id& id, std::u
 
             req.specs =
               couchbase::mutate_in_specs{
-                  couchbase::mutate_in_specs::insert(prefix + ATR_FIELD_TRANSACTION_ID, overall_.transaction_id()).xattr().create_path(),
-                  couchbase::mutate_in_specs::insert(prefix + ATR_FIELD_STATUS, attempt_state_name(attempt_state::PENDING))
+                  couchbase::mutate_in_specs::insert(atr_paths_.transaction_id, overall_.transaction_id()).xattr().create_path(),
+                  couchbase::mutate_in_specs::insert(atr_paths_.status, attempt_state_name(attempt_state::PENDING))
                     .xattr()
                     .create_path(),
-                  couchbase::mutate_in_specs::insert(prefix + ATR_FIELD_START_TIMESTAMP, subdoc::mutate_in_macro::cas)
+                  couchbase::mutate_in_specs::insert(atr_paths_.start_timestamp, subdoc::mutate_in_macro::cas)
                     .xattr()
                     .create_path(),
-                  couchbase::mutate_in_specs::insert(prefix + ATR_FIELD_EXPIRES_AFTER_MSECS, remaining_bounded_msecs).xattr().create_path(),
+                  couchbase::mutate_in_specs::insert(atr_paths_.expires_after_msecs, remaining_bounded_msecs).xattr().create_path(),
                   // ExtStoreDurability
-                  couchbase::mutate_in_specs::insert(prefix + ATR_FIELD_DURABILITY_LEVEL,
+                  couchbase::mutate_in_specs::insert(atr_paths_.durability_level,
                                                      store_durability_level_to_string(overall_.config().durability_level()))
                     .xattr()
                     .create_path(),
@@ -1857,7 +2170,7 @@ attempt_context_impl::do_get(const core::document_id& id, const std::optional<st
         staged_mutation* own_write = check_for_own_write(id);
         if (own_write) {
             debug("found own-write of mutated doc {}", id);
-            return cb(std::nullopt, std::nullopt, transaction_get_result::create_from(own_write->doc(), own_write->content()));
+            return cb(std::nullopt, std::nullopt, transaction_get_result::create_from(own_write->doc(), own_write->content_buffer()));
         }
         staged_mutation* own_remove = staged_mutations_->find_remove(id);
         if (own_remove) {
@@ -1898,47 +2211,41 @@ attempt_context_impl::do_get(const core::document_id& id, const std::optional<st
                                                           doc->links().atr_scope_name().value(),
                                                           doc->links().atr_collection_name().value(),
                                                           doc->links().atr_id().value() };
-                            active_transaction_record::get_atr(
-                              cluster_ref(),
+                            if (auto state = terminal_attempt_cache::instance().find(doc->links().staged_attempt_id().value_or(""))) {
+                                debug("doc {} staged by attempt known to be {}", *doc, attempt_state_name(*state));
+                                auto content = visible_content(*doc, *state);
+                                if (!content) {
+                                    return cb(std::nullopt, std::nullopt, std::nullopt);
+                                }
+                                return cb(std::nullopt, std::nullopt, transaction_get_result::create_from(*doc, *content));
+                            }
+                            // no attempt has an empty id, so without one this finds no entry, and we check again
+                            atr_reads_.get_entry(
                               doc_atr_id,
-                              [this, id, doc, cb = std::move(cb)](std::error_code ec, std::optional<active_transaction_record> atr) {
-                                  if (!ec && atr) {
-                                      active_transaction_record& atr_doc = atr.value();
-                                      std::optional<atr_entry> entry;
-                                      for (auto& e : atr_doc.entries()) {
-                                          if (doc->links().staged_attempt_id().value() == e.attempt_id()) {
-                                              entry.emplace(e);
-                                              break;
-                                          }
-                                      }
+                              doc->links().staged_attempt_id().value_or(""),
+                              [this, id, doc, cb = std::move(cb)](std::error_code ec, std::optional<atr_entry> entry) {
+                                  if (!ec) {
                                       bool ignore_doc = false;
-                                      auto content = doc->content<std::string>();
+                                      auto content = doc->content_buffer();
                                       if (entry) {
                                           if (doc->links().staged_attempt_id() && entry->attempt_id() == this->id()) {
                                               // Attempt is reading its own writes
                                               // This is here as backup, it should be returned from the in-memory cache instead
-                                              content = doc->links().staged_content();
+                                              content = doc->links().staged_content_buffer();
                                           } else {
                                               auto err =
                                                 forward_compat::check(forward_compat_stage::GETS_READING_ATR, entry->forward_compat());
                                               if (err) {
-                                                  return cb(FAIL_OTHER, err->what(), std::nullopt);
+                                                  return after_retry_delay(*err, [cb, msg = std::string(err->what())]() mutable {
+                                                      cb(FAIL_OTHER, msg, std::nullopt);
+                                                  });
                                               }
-                                              switch (entry->state()) {
-                                                  case attempt_state::COMPLETED:
-                                                  case attempt_state::COMMITTED:
-                                                      if (doc->links().is_document_being_removed()) {
-                                                          ignore_doc = true;
-                                                      } else {
-                                                          content = doc->links().staged_content();
-                                                      }
-                                                      break;
-                                                  default:
-                                                      if (doc->links().is_document_being_inserted()) {
-                                                          // This document is being inserted, so should not be visible yet
-                                                          ignore_doc = true;
-                                                      }
-                                                      break;
+                                              terminal_attempt_cache::instance().add(*entry);
+                                              auto visible = visible_content(*doc, entry->state());
+                                              if (visible) {
+                                                  content = *visible;
+                                              } else {
+                                                  ignore_doc = true;
                                               }
                                           }
                                       } else {
@@ -1986,23 +2293,7 @@ attempt_context_impl::get_doc(
   std::function<void(std::optional<error_class>, std::optional<std::string>, std::optional<transaction_get_result>)>&& cb)
 {
     core::operations::lookup_in_request req{ id };
-    req.specs =
-      lookup_in_specs{
-          lookup_in_specs::get(ATR_ID).xattr(),
-          lookup_in_specs::get(TRANSACTION_ID).xattr(),
-          lookup_in_specs::get(ATTEMPT_ID).xattr(),
-          lookup_in_specs::get(STAGED_DATA).xattr(),
-          lookup_in_specs::get(ATR_BUCKET_NAME).xattr(),
-          lookup_in_specs::get(ATR_SCOPE_NAME).xattr(),
-          lookup_in_specs::get(ATR_COLL_NAME).xattr(),
-          lookup_in_specs::get(TRANSACTION_RESTORE_PREFIX_ONLY).xattr(),
-          lookup_in_specs::get(TYPE).xattr(),
-          lookup_in_specs::get(subdoc::lookup_in_macro::document).xattr(),
-          lookup_in_specs::get(CRC32_OF_STAGING).xattr(),
-          lookup_in_specs::get(FORWARD_COMPAT).xattr(),
-          lookup_in_specs::get(""),
-      }
-        .specs();
+    req.specs = txn_document_lookup_specs();
     req.access_deleted = true;
     wrap_request(req, overall_.config());
     try {
@@ -2047,8 +2338,7 @@ attempt_context_impl::create_staged_insert_error_handler(const core::document_id
             return op_completed_with_error(cb, transaction_operation_failed(ec, "transient error in insert").retry());
         case FAIL_AMBIGUOUS:
             debug("FAIL_AMBIGUOUS in create_staged_insert, retrying");
-            delay();
-            return create_staged_insert(id, content, cas, delay, cb);
+            return retry_create_staged_insert(id, content, cas, delay, cb);
         case FAIL_OTHER:
             return op_completed_with_error(cb, transaction_operation_failed(ec, "error in create_staged_insert"));
         case FAIL_HARD:
@@ -2091,13 +2381,13 @@ attempt_context_impl::create_staged_insert_error_handler(const core::document_id
                                 doc->links().is_deleted());
                           auto err = forward_compat::check(forward_compat_stage::WWC_INSERTING_GET, doc->links().forward_compat());
                           if (err) {
-                              return op_completed_with_error(std::move(cb), *err);
+                              return after_retry_delay(*err,
+                                                       [this, cb, err = *err]() mutable { op_completed_with_error(std::move(cb), err); });
                           }
                           if (!doc->links().is_document_in_transaction() && doc->links().is_deleted()) {
                               // it is just a deleted doc, so we are ok.  Let's try again, but with the cas
                               debug("create staged insert found existing deleted doc, retrying with cas {}", doc->cas());
-                              delay();
-                              return create_staged_insert(id, content, doc->cas(), delay, cb);
+                              return retry_create_staged_insert(id, content, doc->cas(), delay, cb);
                           }
                           if (!doc->links().is_document_in_transaction()) {
                               // doc was inserted outside txn elsewhere
@@ -2120,8 +2410,7 @@ attempt_context_impl::create_staged_insert_error_handler(const core::document_id
                                     return op_completed_with_error(cb, *err);
                                 }
                                 debug("doc ok to overwrite, retrying create_staged_insert with cas {}", doc->cas());
-                                delay();
-                                return create_staged_insert(id, content, doc->cas(), delay, cb);
+                                return retry_create_staged_insert(id, content, doc->cas(), delay, cb);
                             });
                       } else {
                           // no doc now, just retry entire txn
@@ -2142,6 +2431,23 @@ attempt_context_impl::create_staged_insert_error_handler(const core::document_id
     }
 }
 
+template<typename Handler, typename Delay>
+void
+attempt_context_impl::retry_create_staged_insert(const core::document_id& id,
+                                                 const std::string& content,
+                                                 uint64_t cas,
+                                                 Delay& delay,
+                                                 Handler&& cb)
+{
+    auto wait = next_delay(delay);
+    if (!wait) {
+        return op_completed_with_error(cb, transaction_operation_failed(FAIL_EXPIRY, "timed out retrying create_staged_insert").expired());
+    }
+    async_delay(overall_.io_context(), *wait, [this, id, content, cas, delay, cb]() mutable {
+        create_staged_insert(id, content, cas, delay, cb);
+    });
+}
+
 template<typename Handler, typename Delay>
 void
 attempt_context_impl::create_staged_insert(const core::document_id& id,
@@ -2176,13 +2482,15 @@ attempt_context_impl::create_staged_insert(const core::document_id& id,
             debug("inserted doc {} CAS={}, {}", id, resp.cas.value(), resp.ctx.ec().message());
 
             // TODO: clean this up (do most of this in transactions_document(...))
+            // the links, the result and the staged mutation all share the one copy of the content
+            auto staged = std::make_shared<const std::string>(content);
             transaction_links links(atr_id_->key(),
                                     id.bucket(),
                                     id.scope(),
                                     id.collection(),
                                     overall_.transaction_id(),
                                     this->id(),
-                                    content,
+                                    std::nullopt,
                                     std::nullopt,
                                     std::nullopt,
                                     std::nullopt,
@@ -2190,8 +2498,9 @@ attempt_context_impl::create_staged_insert(const core::document_id& id,
                                     std::string("insert"),
                                     std::nullopt,
                                     true);
-            transaction_get_result out(id, content, resp.cas.value(), links, std::nullopt);
-            staged_mutations_->add(staged_mutation(out, content, staged_mutation_type::INSERT));
+            links.staged_content(staged);
+            transaction_get_result out(id, staged, resp.cas.value(), std::move(links), std::nullopt);
+            staged_mutations_->add(staged_mutation(out, staged, staged_mutation_type::INSERT));
             return op_completed_with_callback(cb, std::optional<transaction_get_result>(out));
         }
         ec = error_class_from_response(resp);
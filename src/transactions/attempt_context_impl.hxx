@@ -28,11 +28,14 @@
 #include <couchbase/transactions/attempt_state.hxx>
 #include <couchbase/transactions/transaction_get_result.hxx>
 
+#include "atr_read_coalescer.hxx"
+#include "attempt_arena.hxx"
 #include "attempt_context_testing_hooks.hxx"
 #include "couchbase/transactions/internal/atr_cleanup_entry.hxx"
 #include "couchbase/transactions/internal/exceptions_internal.hxx"
 #include "couchbase/transactions/internal/transaction_context.hxx"
 #include "error_list.hxx"
+#include "request_templates.hxx"
 #include "waitable_op_list.hxx"
 
 namespace couchbase
@@ -56,11 +59,16 @@ namespace transactions
         transaction_context& overall_;
         std::optional<core::document_id> atr_id_;
         bool is_done_;
+        // must outlive everything allocated from it, so it comes first
+        attempt_arena arena_;
         std::unique_ptr<staged_mutation_queue> staged_mutations_;
         attempt_context_testing_hooks& hooks_;
         error_list errors_;
         std::mutex mutex_;
         waitable_op_list op_list_;
+        // precomputed paths of our ATR entry, and the txn xattr we stage documents with once the ATR is picked
+        atr_entry_paths atr_paths_;
+        txn_xattr_writer staging_xattr_;
 
         // commit needs to access the hooks
         friend class staged_mutation_queue;
@@ -77,6 +85,16 @@ namespace transactions
 
         void remove_staged_insert(const core::document_id& id, VoidCallback&& cb);
 
+        struct batch_state;
+        void stage_batch_item(std::shared_ptr<batch_state> state, size_t index);
+        void finish_batch_item(std::shared_ptr<batch_state> state,
+                               size_t index,
+                               std::exception_ptr err,
+                               std::optional<transaction_get_result> res);
+
+        // Concurrent reads of the same foreign ATR, from gets and write-write conflict checks, share one lookup.
+        atr_read_coalescer atr_reads_;
+
         // These are all just stubs for now
         void get_with_query(const core::document_id& id, bool optional, Callback&& cb);
         void insert_raw_with_query(const core::document_id& id, const std::string& content, Callback&& cb);
@@ -293,9 +311,18 @@ namespace transactions
         virtual std::optional<transaction_get_result> get_optional(const core::document_id& id);
         virtual void get_optional(const core::document_id& id, Callback&& cb);
 
+        virtual std::vector<transaction_get_result> get_multi(const std::vector<core::document_id>& ids);
+        virtual void get_multi(const std::vector<core::document_id>& ids, MultiCallback&& cb);
+
+        virtual std::vector<std::optional<transaction_get_result>> get_optional_multi(const std::vector<core::document_id>& ids);
+        virtual void get_optional_multi(const std::vector<core::document_id>& ids, OptionalMultiCallback&& cb);
+
         virtual void remove(const transaction_get_result& document);
         virtual void remove(const transaction_get_result& document, VoidCallback&& cb);
 
+        virtual std::vector<staged_write_result> stage_batch(const staged_write_batch& batch);
+        virtual void stage_batch(const staged_write_batch& batch, BatchCallback&& cb);
+
         virtual void query(const std::string& statement, const transaction_query_options& opts, QueryCallback&& cb);
         virtual core::operations::query_response query(const std::string& statement, const transaction_query_options& opts);
 
@@ -372,6 +399,8 @@ namespace transactions
 
         staged_mutation* check_for_own_write(const core::document_id& id);
 
+        void after_retry_delay(const transaction_operation_failed& err, std::function<void()> fn);
+
         template<typename Handler>
         void check_and_handle_blocking_transactions(const transaction_get_result& doc, forward_compat_stage stage, Handler&& cb);
 
@@ -381,15 +410,15 @@ namespace transactions
         template<typename Handler>
         void check_if_done(Handler& cb);
 
-        void atr_commit(bool ambiguity_resolution_mode);
+        void atr_commit(bool ambiguity_resolution_mode, VoidCallback&& cb);
 
-        void atr_commit_ambiguity_resolution();
+        void atr_commit_ambiguity_resolution(VoidCallback&& cb);
 
-        void atr_complete();
+        void atr_complete(VoidCallback&& cb);
 
-        void atr_abort();
+        void atr_abort(VoidCallback&& cb);
 
-        void atr_rollback_complete();
+        void atr_rollback_complete(VoidCallback&& cb);
 
         void select_atr_if_needed_unlocked(const core::document_id& id,
                                            std::function<void(std::optional<transaction_operation_failed>)>&& cb);
@@ -409,6 +438,9 @@ namespace transactions
         template<typename Handler, typename Delay>
         void create_staged_insert(const core::document_id& id, const std::string& content, uint64_t cas, Delay&& delay, Handler&& cb);
 
+        template<typename Handler, typename Delay>
+        void retry_create_staged_insert(const core::document_id& id, const std::string& content, uint64_t cas, Delay& delay, Handler&& cb);
+
         template<typename Handler>
         void create_staged_replace(const transaction_get_result& document, const std::string& content, Handler&& cb);
 
@@ -24,5 +24,10 @@ namespace transactions
     {
         return std::string(reinterpret_cast<const char*>(input.data()), input.size());
     }
+
+    std::string_view to_string_view(const std::vector<std::byte>& input)
+    {
+        return { reinterpret_cast<const char*>(input.data()), input.size() };
+    }
 } // namespace transactions
 } // namespace couchbase
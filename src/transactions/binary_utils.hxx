@@ -16,6 +16,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace couchbase
@@ -26,5 +27,8 @@ namespace transactions
      * FIXME: will be removed once we migrate to taocpp/json which can parse array's of bytes directly
      */
     std::string to_string(const std::vector<std::byte>& input);
+
+    // a view of the same bytes, for reading without the copy
+    std::string_view to_string_view(const std::vector<std::byte>& input);
 } // namespace transactions
 } // namespace couchbase
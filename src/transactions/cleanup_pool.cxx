@@ -0,0 +1,151 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "cleanup_pool.hxx"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+namespace couchbase::transactions
+{
+namespace
+{
+    // One for_each call.  Threads pick up the next index until there are none left or one has failed.  Shared with
+    // the tasks posted for it, as those may not get to run until after for_each has returned.
+    struct batch {
+        batch(size_t count, const std::function<void(size_t)>& fn)
+          : count(count)
+          , fn(fn)
+        {
+        }
+
+        bool claim(size_t& index)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failed || next >= count) {
+                return false;
+            }
+            index = next++;
+            in_flight++;
+            return true;
+        }
+
+        void finished(std::exception_ptr err)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (err && !failed) {
+                failed = true;
+                first_error = err;
+            }
+            in_flight--;
+            cv.notify_all();
+        }
+
+        // fn is only called for a claimed index, and for_each waits for those, so it never outlives the caller's
+        void run()
+        {
+            size_t index;
+            while (claim(index)) {
+                std::exception_ptr err;
+                try {
+                    fn(index);
+                } catch (...) {
+                    err = std::current_exception();
+                }
+                finished(err);
+            }
+        }
+
+        const size_t count;
+        const std::function<void(size_t)>& fn;
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t next{ 0 };
+        size_t in_flight{ 0 };
+        bool failed{ false };
+        std::exception_ptr first_error;
+    };
+} // namespace
+
+cleanup_pool::~cleanup_pool()
+{
+    stop();
+}
+
+void
+cleanup_pool::for_each(size_t count, const std::function<void(size_t)>& fn)
+{
+    if (count == 0) {
+        return;
+    }
+    auto b = std::make_shared<batch>(count, fn);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopped_) {
+            // this thread takes one share of the work, the pool the rest
+            auto helpers = std::min(count - 1, max_threads_);
+            for (size_t i = 0; i < helpers; i++) {
+                tasks_.emplace_back([b]() { b->run(); });
+            }
+            while (threads_.size() < std::min(tasks_.size(), max_threads_)) {
+                threads_.emplace_back([this]() { worker(); });
+            }
+            cv_.notify_all();
+        }
+    }
+    b->run();
+    std::unique_lock<std::mutex> lock(b->mutex);
+    b->cv.wait(lock, [&]() { return b->in_flight == 0; });
+    if (b->first_error) {
+        std::rethrow_exception(b->first_error);
+    }
+}
+
+void
+cleanup_pool::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [&]() { return stopped_ || !tasks_.empty(); });
+        if (stopped_) {
+            return;
+        }
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+void
+cleanup_pool::stop()
+{
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        // the callers of anything still queued do that work themselves
+        tasks_.clear();
+        threads.swap(threads_);
+        cv_.notify_all();
+    }
+    for (auto& thr : threads) {
+        thr.join();
+    }
+}
+} // namespace couchbase::transactions
@@ -0,0 +1,67 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace couchbase::transactions
+{
+/**
+ * Threads shared by all of cleanup, for the blocking per-document work of cleaning an attempt.
+ *
+ * The threads are started as they are first needed, up to max_threads, and kept until stop.  A caller of for_each
+ * works through its own items too, so it makes progress even when every thread is busy with other callers, and
+ * after stop everything runs on the caller.
+ */
+class cleanup_pool
+{
+  public:
+    explicit cleanup_pool(size_t max_threads)
+      : max_threads_(max_threads)
+    {
+    }
+
+    ~cleanup_pool();
+
+    cleanup_pool(const cleanup_pool&) = delete;
+    cleanup_pool& operator=(const cleanup_pool&) = delete;
+
+    /**
+     * Calls fn with each index in [0, count), on this thread and any of the pool's that are free, and returns once
+     * they have all returned.  Once a call throws no more are started, and the first exception is rethrown.
+     */
+    void for_each(size_t count, const std::function<void(size_t)>& fn);
+
+    void stop();
+
+  private:
+    void worker();
+
+    const size_t max_threads_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    bool stopped_{ false };
+};
+} // namespace couchbase::transactions
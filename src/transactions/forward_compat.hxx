@@ -195,8 +195,9 @@ namespace transactions
                         case forward_compat_behavior::RETRY_TXN:
                             txn_log->trace("forward compatibility RETRY_TXN");
                             if (behavior.retry_delay) {
+                                // the caller waits this out, as it may be on an io thread
                                 txn_log->trace("delay {}ms before retrying", behavior.retry_delay->count());
-                                std::this_thread::sleep_for(*behavior.retry_delay);
+                                return ex.retry(*behavior.retry_delay);
                             }
                             return ex.retry();
                         case forward_compat_behavior::CONTINUE:
@@ -0,0 +1,67 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couchbase/transactions/internal/keyspace_table.hxx"
+
+#include <functional>
+#include <mutex>
+
+namespace couchbase::transactions
+{
+size_t
+keyspace_table::key_hash::operator()(const key& k) const
+{
+    std::hash<std::string_view> hash;
+    size_t seed = hash(k.collection);
+    seed ^= hash(k.scope) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= hash(k.bucket) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+keyspace_table&
+keyspace_table::instance()
+{
+    static keyspace_table table;
+    return table;
+}
+
+keyspace_handle
+keyspace_table::intern(std::string_view bucket, std::string_view scope, std::string_view collection)
+{
+    key k{ bucket, scope, collection };
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        if (auto it = keyspaces_.find(k); it != keyspaces_.end()) {
+            return it->second.get();
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // someone may have beaten us to it
+    if (auto it = keyspaces_.find(k); it != keyspaces_.end()) {
+        return it->second.get();
+    }
+    auto keyspace = std::make_unique<interned_keyspace>(std::string(bucket), std::string(scope), std::string(collection));
+    key stored{ keyspace->bucket(), keyspace->scope(), keyspace->collection() };
+    return keyspaces_.emplace(stored, std::move(keyspace)).first->second.get();
+}
+
+size_t
+keyspace_table::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return keyspaces_.size();
+}
+} // namespace couchbase::transactions
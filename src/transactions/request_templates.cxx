@@ -0,0 +1,157 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "request_templates.hxx"
+
+#include <couchbase/transactions/internal/transaction_fields.hxx>
+#include <couchbase/transactions/internal/utils.hxx>
+
+namespace couchbase::transactions
+{
+const lookup_specs&
+txn_document_lookup_specs()
+{
+    static const lookup_specs specs = lookup_in_specs{
+        lookup_in_specs::get(ATR_ID).xattr(),
+        lookup_in_specs::get(TRANSACTION_ID).xattr(),
+        lookup_in_specs::get(ATTEMPT_ID).xattr(),
+        lookup_in_specs::get(STAGED_DATA).xattr(),
+        lookup_in_specs::get(ATR_BUCKET_NAME).xattr(),
+        lookup_in_specs::get(ATR_SCOPE_NAME).xattr(),
+        lookup_in_specs::get(ATR_COLL_NAME).xattr(),
+        lookup_in_specs::get(TRANSACTION_RESTORE_PREFIX_ONLY).xattr(),
+        lookup_in_specs::get(TYPE).xattr(),
+        lookup_in_specs::get(subdoc::lookup_in_macro::document).xattr(),
+        lookup_in_specs::get(CRC32_OF_STAGING).xattr(),
+        lookup_in_specs::get(FORWARD_COMPAT).xattr(),
+        lookup_in_specs::get(""),
+    }.specs();
+    return specs;
+}
+
+atr_entry_paths::atr_entry_paths(const std::string& attempt_id)
+  : entry(ATR_FIELD_ATTEMPTS + "." + attempt_id)
+{
+    std::string prefix = entry + ".";
+    transaction_id = prefix + ATR_FIELD_TRANSACTION_ID;
+    status = prefix + ATR_FIELD_STATUS;
+    start_timestamp = prefix + ATR_FIELD_START_TIMESTAMP;
+    expires_after_msecs = prefix + ATR_FIELD_EXPIRES_AFTER_MSECS;
+    start_commit = prefix + ATR_FIELD_START_COMMIT;
+    timestamp_rollback_start = prefix + ATR_FIELD_TIMESTAMP_ROLLBACK_START;
+    durability_level = prefix + ATR_FIELD_DURABILITY_LEVEL;
+    prevent_collision = prefix + ATR_FIELD_PREVENT_COLLLISION;
+    docs_inserted = prefix + ATR_FIELD_DOCS_INSERTED;
+    docs_replaced = prefix + ATR_FIELD_DOCS_REPLACED;
+    docs_removed = prefix + ATR_FIELD_DOCS_REMOVED;
+}
+
+void
+append_json_string(std::string& out, std::string_view value)
+{
+    static const char* hex = "0123456789abcdef";
+    out.push_back('"');
+    for (char c : value) {
+        switch (c) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\b':
+                out.append("\\b");
+                break;
+            case '\f':
+                out.append("\\f");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out.append("\\u00");
+                    out.push_back(hex[(c >> 4) & 0x0f]);
+                    out.push_back(hex[c & 0x0f]);
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+txn_xattr_writer::txn_xattr_writer(const std::string& transaction_id, const std::string& attempt_id, const core::document_id& atr_id)
+{
+    head_.reserve(128 + transaction_id.size() + attempt_id.size() + atr_id.key().size());
+    head_.append(R"({"atr":{"bkt":)");
+    append_json_string(head_, atr_id.bucket());
+    head_.append(R"(,"coll":)");
+    append_json_string(head_, atr_id.collection());
+    head_.append(R"(,"id":)");
+    append_json_string(head_, atr_id.key());
+    head_.append(R"(,"scp":)");
+    append_json_string(head_, atr_id.scope());
+    head_.append(R"(},"id":{"atmpt":)");
+    append_json_string(head_, attempt_id);
+    head_.append(R"(,"txn":)");
+    append_json_string(head_, transaction_id);
+    head_.append("},");
+}
+
+std::string
+txn_xattr_writer::write(std::string_view op_type, const std::optional<document_metadata>& restore) const
+{
+    std::string out;
+    out.reserve(head_.size() + 128);
+    out.append(head_);
+    out.append(R"("op":{"type":)");
+    append_json_string(out, op_type);
+    out.push_back('}');
+    if (restore) {
+        out.append(R"(,"restore":{)");
+        bool first = true;
+        auto field = [&](const char* name) {
+            if (!first) {
+                out.push_back(',');
+            }
+            first = false;
+            out.append(name);
+        };
+        if (auto cas = restore->cas()) {
+            field(R"("CAS":)");
+            append_json_string(out, *cas);
+        }
+        if (auto exptime = restore->exptime()) {
+            field(R"("exptime":)");
+            out.append(std::to_string(*exptime));
+        }
+        if (auto revid = restore->revid()) {
+            field(R"("revid":)");
+            append_json_string(out, *revid);
+        }
+        out.push_back('}');
+    }
+    out.push_back('}');
+    return out;
+}
+} // namespace couchbase::transactions
@@ -0,0 +1,82 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <core/document_id.hxx>
+#include <core/operations.hxx>
+#include <couchbase/transactions/document_metadata.hxx>
+
+/**
+ * Pieces of the KV requests on the transaction hot paths which only need building once: the lookup specs for
+ * reading a document's transactional metadata, the paths of an attempt's ATR entry, and the txn xattr written
+ * when staging a document.
+ */
+namespace couchbase::transactions
+{
+using lookup_specs = decltype(core::operations::lookup_in_request::specs);
+
+// Specs for reading a document with all of its txn xattrs, see transaction_get_result::create_from.
+const lookup_specs&
+txn_document_lookup_specs();
+
+// Paths of the fields of one attempt's entry in its ATR.
+struct atr_entry_paths {
+    atr_entry_paths() = default;
+    explicit atr_entry_paths(const std::string& attempt_id);
+
+    // the entry itself, "attempts.<attempt id>"
+    std::string entry;
+    std::string transaction_id;
+    std::string status;
+    std::string start_timestamp;
+    std::string expires_after_msecs;
+    std::string start_commit;
+    std::string timestamp_rollback_start;
+    std::string durability_level;
+    std::string prevent_collision;
+    std::string docs_inserted;
+    std::string docs_replaced;
+    std::string docs_removed;
+};
+
+// Appends value to out as a JSON string, quoted and escaped.
+void
+append_json_string(std::string& out, std::string_view value);
+
+/**
+ * Writes the txn xattr of a staged document straight to a string.
+ *
+ * Everything but the op type and restore fields is the same for every document an attempt stages, so that is
+ * written once up front.  The output matches nlohmann::json's dump() of the same object, keys in sorted order.
+ */
+class txn_xattr_writer
+{
+  public:
+    txn_xattr_writer() = default;
+    txn_xattr_writer(const std::string& transaction_id, const std::string& attempt_id, const core::document_id& atr_id);
+
+    CB_NODISCARD std::string write(std::string_view op_type, const std::optional<document_metadata>& restore) const;
+
+  private:
+    // {"atr":{...},"id":{...},
+    std::string head_;
+};
+} // namespace couchbase::transactions
@@ -35,108 +35,133 @@ tx::staged_mutation_queue::add(const tx::staged_mutation& mutation)
 {
     std::lock_guard<std::mutex> lock(mutex_);
     // Can only have one staged mutation per document.
-    auto new_end = std::remove_if(
-      queue_.begin(), queue_.end(), [&mutation](const staged_mutation& item) { return document_ids_equal(item.id(), mutation.id()); });
-    queue_.erase(new_end, queue_.end());
+    erase_unlocked(mutation.id());
+    index_.emplace(mutation.id(), queue_.size());
     queue_.push_back(mutation);
 }
 
 void
-tx::staged_mutation_queue::extract_to(const std::string& prefix, core::operations::mutate_in_request& req)
+tx::staged_mutation_queue::extract_to(const atr_entry_paths& paths, core::operations::mutate_in_request& req)
 {
+    static const std::string bucket_key = "{\"" + ATR_FIELD_PER_DOC_BUCKET + "\":";
+    static const std::string collection_key = ",\"" + ATR_FIELD_PER_DOC_COLLECTION + "\":";
+    static const std::string id_key = ",\"" + ATR_FIELD_PER_DOC_ID + "\":";
+    static const std::string scope_key = ",\"" + ATR_FIELD_PER_DOC_SCOPE + "\":";
     std::lock_guard<std::mutex> lock(mutex_);
-    nlohmann::json inserts;
-    nlohmann::json replaces;
-    nlohmann::json removes;
+    // Written directly, as the same JSON nlohmann::json would dump: null for an empty list, keys sorted.
+    std::string inserts;
+    std::string replaces;
+    std::string removes;
 
     for (auto& mutation : queue_) {
-        nlohmann::json doc{ { ATR_FIELD_PER_DOC_ID, mutation.doc().id().key() },
-                            { ATR_FIELD_PER_DOC_BUCKET, mutation.doc().id().bucket() },
-                            { ATR_FIELD_PER_DOC_SCOPE, mutation.doc().id().scope() },
-                            { ATR_FIELD_PER_DOC_COLLECTION, mutation.doc().id().collection() } };
+        std::string* list = nullptr;
         switch (mutation.type()) {
             case staged_mutation_type::INSERT:
-                inserts.push_back(doc);
+                list = &inserts;
                 break;
             case staged_mutation_type::REMOVE:
-                removes.push_back(doc);
+                list = &removes;
                 break;
             case staged_mutation_type::REPLACE:
-                replaces.push_back(doc);
+                list = &replaces;
                 break;
         }
+        const auto& id = mutation.doc().id();
+        list->push_back(list->empty() ? '[' : ',');
+        list->append(bucket_key);
+        append_json_string(*list, id.bucket());
+        list->append(collection_key);
+        append_json_string(*list, id.collection());
+        list->append(id_key);
+        append_json_string(*list, id.key());
+        list->append(scope_key);
+        append_json_string(*list, id.scope());
+        list->push_back('}');
     }
-    req.specs =
+    for (auto* list : { &inserts, &replaces, &removes }) {
+        if (list->empty()) {
+            list->assign("null");
+        } else {
+            list->push_back(']');
+        }
+    }
+    // append to whatever specs the caller has already put in the request
+    auto specs =
       couchbase::mutate_in_specs{
-          couchbase::mutate_in_specs::upsert_raw(prefix + ATR_FIELD_DOCS_INSERTED, core::utils::to_binary(inserts.dump()))
-            .xattr()
-            .create_path(),
-          couchbase::mutate_in_specs::upsert_raw(prefix + ATR_FIELD_DOCS_REPLACED, core::utils::to_binary(replaces.dump()))
-            .xattr()
-            .create_path(),
-          couchbase::mutate_in_specs::upsert_raw(prefix + ATR_FIELD_DOCS_REMOVED, core::utils::to_binary(removes.dump()))
-            .xattr()
-            .create_path(),
+          couchbase::mutate_in_specs::upsert_raw(paths.docs_inserted, core::utils::to_binary(inserts)).xattr().create_path(),
+          couchbase::mutate_in_specs::upsert_raw(paths.docs_replaced, core::utils::to_binary(replaces)).xattr().create_path(),
+          couchbase::mutate_in_specs::upsert_raw(paths.docs_removed, core::utils::to_binary(removes)).xattr().create_path(),
       }
         .specs();
+    req.specs.insert(req.specs.end(), specs.begin(), specs.end());
 }
 
 void
 tx::staged_mutation_queue::remove_any(const core::document_id& id)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    auto new_end =
-      std::remove_if(queue_.begin(), queue_.end(), [id](const staged_mutation& item) { return document_ids_equal(item.id(), id); });
-    queue_.erase(new_end, queue_.end());
+    erase_unlocked(id);
+}
+
+void
+tx::staged_mutation_queue::erase_unlocked(const core::document_id& id)
+{
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+        return;
+    }
+    // Removing is rare (a remove of our own insert, or a second write to a document), so just shift the rest
+    // down and fix up their positions.
+    auto pos = it->second;
+    index_.erase(it);
+    queue_.erase(queue_.begin() + static_cast<std::ptrdiff_t>(pos));
+    for (auto i = pos; i < queue_.size(); i++) {
+        index_[queue_[i].id()] = i;
+    }
+}
+
+tx::staged_mutation*
+tx::staged_mutation_queue::find_unlocked(const core::document_id& id, std::optional<staged_mutation_type> type)
+{
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    auto& item = queue_[it->second];
+    if (type && item.type() != *type) {
+        return nullptr;
+    }
+    return &item;
 }
 
 tx::staged_mutation*
 tx::staged_mutation_queue::find_any(const core::document_id& id)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& item : queue_) {
-        if (document_ids_equal(item.doc().id(), id)) {
-            return &item;
-        }
-    }
-    return nullptr;
+    return find_unlocked(id);
 }
 
 tx::staged_mutation*
 tx::staged_mutation_queue::find_replace(const core::document_id& id)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& item : queue_) {
-        if (item.type() == staged_mutation_type::REPLACE && document_ids_equal(item.doc().id(), id)) {
-            return &item;
-        }
-    }
-    return nullptr;
+    return find_unlocked(id, staged_mutation_type::REPLACE);
 }
 
 tx::staged_mutation*
 tx::staged_mutation_queue::find_insert(const core::document_id& id)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& item : queue_) {
-        if (item.type() == staged_mutation_type::INSERT && document_ids_equal(item.doc().id(), id)) {
-            return &item;
-        }
-    }
-    return nullptr;
+    return find_unlocked(id, staged_mutation_type::INSERT);
 }
 
 tx::staged_mutation*
 tx::staged_mutation_queue::find_remove(const core::document_id& id)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& item : queue_) {
-        if (item.type() == staged_mutation_type::REMOVE && document_ids_equal(item.doc().id(), id)) {
-            return &item;
-        }
-    }
-    return nullptr;
+    return find_unlocked(id, staged_mutation_type::REMOVE);
 }
+
 void
 tx::staged_mutation_queue::iterate(std::function<void(staged_mutation&)> op)
 {
@@ -146,265 +171,389 @@ tx::staged_mutation_queue::iterate(std::function<void(staged_mutation&)> op)
     }
 }
 
+// state shared by all the writes of one unstaging pass
+struct tx::staged_mutation_queue::unstaging_state {
+    std::mutex mutex;
+    size_t next{ 0 };
+    size_t in_flight{ 0 };
+    bool done{ false };
+    // unstage_next is filling the window, and should go round again once it has
+    bool filling{ false };
+    bool refill{ false };
+    bool stop_on_error{ true };
+    size_t failed{ 0 };
+    std::exception_ptr first_error;
+    unstage_func func;
+    async_retry_handler cb;
+};
+
 void
-tx::staged_mutation_queue::commit(attempt_context_impl& ctx)
+tx::staged_mutation_queue::unstage(attempt_context_impl& ctx, unstage_func&& func, async_retry_handler&& cb, bool stop_on_error)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& item : queue_) {
-        switch (item.type()) {
-            case staged_mutation_type::REMOVE:
-                remove_doc(ctx, item);
-                break;
-            case staged_mutation_type::INSERT:
-            case staged_mutation_type::REPLACE:
-                commit_doc(ctx, item);
-                break;
-        }
-    }
+    // ops are blocked once commit or rollback starts, so the queue can't change underneath us.
+    window_ = std::make_shared<unstaging_window>(ctx.overall_.config().max_concurrent_unstaging());
+    auto state = std::make_shared<unstaging_state>();
+    state->func = std::move(func);
+    state->cb = std::move(cb);
+    state->stop_on_error = stop_on_error;
+    unstage_next(state);
 }
 
 void
-tx::staged_mutation_queue::rollback(attempt_context_impl& ctx)
+tx::staged_mutation_queue::unstage_next(std::shared_ptr<unstaging_state> state)
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& item : queue_) {
-        switch (item.type()) {
-            case staged_mutation_type::INSERT:
-                retry_op_exp<void>([&]() { rollback_insert(ctx, item); });
-                break;
-            case staged_mutation_type::REMOVE:
-            case staged_mutation_type::REPLACE:
-                retry_op_exp<void>([&]() { rollback_remove_or_replace(ctx, item); });
-                break;
+    // Fill the window, in queue order.  Each completion calls this again, to refill the window or, once
+    // the last write is done, to call the callback.  If stop_on_error is set, once a write fails we issue no
+    // more, otherwise we carry on and report the first error at the end.  A completion that comes in while the
+    // window is being filled - including one that completes synchronously, inside func - just asks the filling
+    // call to go round again, so the stack doesn't grow with the number of mutations.
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (state->filling) {
+        state->refill = true;
+        return;
+    }
+    state->filling = true;
+    do {
+        state->refill = false;
+        std::vector<staged_mutation*> to_start;
+        while (!(state->stop_on_error && state->first_error) && state->next < queue_.size() && state->in_flight < window_->size()) {
+            to_start.push_back(&queue_[state->next++]);
+            state->in_flight++;
+        }
+        if (to_start.empty() && state->in_flight == 0 && !state->done) {
+            state->done = true;
+            state->filling = false;
+            if (state->failed > 1) {
+                txn_log->trace("{} of {} staged mutations failed to unstage, reporting the first", state->failed, state->next);
+            }
+            lock.unlock();
+            return state->cb(state->first_error);
         }
+        lock.unlock();
+        for (auto item : to_start) {
+            async_retry_handler done = [this, state](std::exception_ptr err) {
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->in_flight--;
+                    if (err) {
+                        state->failed++;
+                        if (!state->first_error) {
+                            state->first_error = err;
+                        }
+                    }
+                }
+                if (!err) {
+                    window_->success();
+                }
+                unstage_next(state);
+            };
+            try {
+                state->func(*item, async_retry_handler(done));
+            } catch (...) {
+                done(std::current_exception());
+            }
+        }
+        lock.lock();
+    } while (state->refill);
+    state->filling = false;
+}
+
+void
+tx::staged_mutation_queue::adapt_window(error_class ec)
+{
+    if (!window_) {
+        return;
+    }
+    switch (ec) {
+        case FAIL_TRANSIENT:
+        case FAIL_AMBIGUOUS:
+            window_->transient_error();
+            break;
+        default:
+            break;
     }
 }
 
 void
-tx::staged_mutation_queue::rollback_insert(attempt_context_impl& ctx, staged_mutation& item)
+tx::staged_mutation_queue::commit(attempt_context_impl& ctx, async_retry_handler&& cb)
 {
-    try {
-        ctx.trace("rolling back staged insert for {} with cas {}", item.doc().id(), item.doc().cas());
-        auto ec = ctx.error_if_expired_and_not_in_overtime(STAGE_DELETE_INSERTED, item.doc().id().key());
-        if (ec) {
-            throw client_error(*ec, "expired in rollback and not in overtime mode");
-        }
-        ec = ctx.hooks_.before_rollback_delete_inserted(&ctx, item.doc().id().key());
-        if (ec) {
-            throw client_error(*ec, "before_rollback_delete_insert hook threw error");
-        }
-        core::operations::mutate_in_request req{ item.doc().id() };
-        req.specs =
-          couchbase::mutate_in_specs{
-              couchbase::mutate_in_specs::remove(TRANSACTION_INTERFACE_PREFIX_ONLY).xattr(),
+    unstage(
+      ctx,
+      [this, &ctx](staged_mutation& item, async_retry_handler&& done) {
+          switch (item.type()) {
+              case staged_mutation_type::REMOVE:
+                  return remove_doc(ctx, item, std::move(done));
+              case staged_mutation_type::INSERT:
+              case staged_mutation_type::REPLACE:
+                  return commit_doc(ctx, item, std::move(done));
           }
-            .specs();
-        req.access_deleted = true;
-        req.cas = couchbase::cas(item.doc().cas());
-        wrap_durable_request(req, ctx.overall_.config());
-        auto barrier = std::make_shared<std::promise<result>>();
-        auto f = barrier->get_future();
-        ctx.cluster_ref().execute(
-          req, [barrier](core::operations::mutate_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
-        auto res = wrap_operation_future(f);
-        ctx.trace("rollback result {}", res);
-        ec = ctx.hooks_.after_rollback_delete_inserted(&ctx, item.doc().id().key());
-        if (ec) {
-            throw client_error(*ec, "after_rollback_delete_insert hook threw error");
-        }
-    } catch (const client_error& e) {
-        auto ec = e.ec();
+      },
+      std::move(cb));
+}
+
+void
+tx::staged_mutation_queue::rollback(attempt_context_impl& ctx, async_retry_handler&& cb)
+{
+    // Unlike commit, a failure rolling back one document doesn't stop us rolling back the rest - whatever we
+    // leave behind is left for cleanup, so undo as much as we can now.
+    unstage(
+      ctx,
+      [this, &ctx](staged_mutation& item, async_retry_handler&& done) {
+          switch (item.type()) {
+              case staged_mutation_type::INSERT:
+                  return async_retry_op_exp(
+                    ctx.overall_.io_context(),
+                    [this, &ctx, &item](async_retry_handler handler) { rollback_insert(ctx, item, std::move(handler)); },
+                    std::move(done));
+              case staged_mutation_type::REMOVE:
+              case staged_mutation_type::REPLACE:
+                  return async_retry_op_exp(
+                    ctx.overall_.io_context(),
+                    [this, &ctx, &item](async_retry_handler handler) { rollback_remove_or_replace(ctx, item, std::move(handler)); },
+                    std::move(done));
+          }
+      },
+      std::move(cb),
+      false);
+}
+
+void
+tx::staged_mutation_queue::rollback_insert(attempt_context_impl& ctx, staged_mutation& item, async_retry_handler&& cb)
+{
+    auto error_handler = [this, &ctx, &item, cb](error_class ec, const std::string& message) {
         if (ctx.expiry_overtime_mode_.load()) {
-            ctx.trace("rollback_insert for {} error while in overtime mode {}", item.doc().id(), e.what());
-            throw transaction_operation_failed(FAIL_EXPIRY, std::string("expired while rolling back insert with {} ") + e.what())
-              .no_rollback()
-              .expired();
+            ctx.trace("rollback_insert for {} error while in overtime mode {}", item.doc().id(), message);
+            return cb(std::make_exception_ptr(
+              transaction_operation_failed(FAIL_EXPIRY, std::string("expired while rolling back insert with {} ") + message)
+                .no_rollback()
+                .expired()));
         }
+        adapt_window(ec);
         switch (ec) {
             case FAIL_HARD:
             case FAIL_CAS_MISMATCH:
-                throw transaction_operation_failed(ec, e.what()).no_rollback();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback()));
             case FAIL_EXPIRY:
                 ctx.expiry_overtime_mode_ = true;
                 ctx.trace("rollback_insert in expiry overtime mode, retrying...");
-                throw retry_operation("retry rollback_insert");
+                return cb(std::make_exception_ptr(retry_operation("retry rollback_insert")));
             case FAIL_DOC_NOT_FOUND:
             case FAIL_PATH_NOT_FOUND:
                 // already cleaned up?
-                return;
+                return cb({});
             default:
-                throw retry_operation("retry rollback insert");
+                return cb(std::make_exception_ptr(retry_operation("retry rollback insert")));
         }
+    };
+    ctx.trace("rolling back staged insert for {} with cas {}", item.doc().id(), item.doc().cas());
+    auto ec = ctx.error_if_expired_and_not_in_overtime(STAGE_DELETE_INSERTED, item.doc().id().key());
+    if (ec) {
+        return error_handler(*ec, "expired in rollback and not in overtime mode");
+    }
+    ec = ctx.hooks_.before_rollback_delete_inserted(&ctx, item.doc().id().key());
+    if (ec) {
+        return error_handler(*ec, "before_rollback_delete_insert hook threw error");
     }
+    core::operations::mutate_in_request req{ item.doc().id() };
+    req.specs =
+      couchbase::mutate_in_specs{
+          couchbase::mutate_in_specs::remove(TRANSACTION_INTERFACE_PREFIX_ONLY).xattr(),
+      }
+        .specs();
+    req.access_deleted = true;
+    req.cas = couchbase::cas(item.doc().cas());
+    wrap_durable_request(req, ctx.overall_.config());
+    ctx.cluster_ref().execute(req, [&ctx, &item, cb, error_handler](core::operations::mutate_in_response resp) {
+        auto ec = error_class_from_response(resp);
+        if (ec) {
+            return error_handler(*ec, resp.ctx.ec().message());
+        }
+        ctx.trace("rollback result {}", result::create_from_subdoc_response(resp));
+        if (!!(ec = ctx.hooks_.after_rollback_delete_inserted(&ctx, item.doc().id().key()))) {
+            return error_handler(*ec, "after_rollback_delete_insert hook threw error");
+        }
+        return cb({});
+    });
 }
 
 void
-tx::staged_mutation_queue::rollback_remove_or_replace(attempt_context_impl& ctx, staged_mutation& item)
+tx::staged_mutation_queue::rollback_remove_or_replace(attempt_context_impl& ctx, staged_mutation& item, async_retry_handler&& cb)
 {
-    try {
-        ctx.trace("rolling back staged remove/replace for {} with cas {}", item.doc().id(), item.doc().cas());
-        auto ec = ctx.error_if_expired_and_not_in_overtime(STAGE_ROLLBACK_DOC, item.doc().id().key());
-        if (ec) {
-            throw client_error(*ec, "expired in rollback_remove_or_replace and not in expiry overtime");
-        }
-        ec = ctx.hooks_.before_doc_rolled_back(&ctx, item.doc().id().key());
-        if (ec) {
-            throw client_error(*ec, "before_doc_rolled_back hook threw error");
-        }
-        core::operations::mutate_in_request req{ item.doc().id() };
-        req.specs =
-          couchbase::mutate_in_specs{
-              couchbase::mutate_in_specs::remove(TRANSACTION_INTERFACE_PREFIX_ONLY).xattr(),
-          }
-            .specs();
-        req.cas = couchbase::cas(item.doc().cas());
-        wrap_durable_request(req, ctx.overall_.config());
-        auto barrier = std::make_shared<std::promise<result>>();
-        auto f = barrier->get_future();
-        ctx.cluster_ref().execute(
-          req, [barrier](core::operations::mutate_in_response resp) { barrier->set_value(result::create_from_subdoc_response(resp)); });
-        auto res = wrap_operation_future(f);
-        ctx.trace("rollback result {}", res);
-        ec = ctx.hooks_.after_rollback_replace_or_remove(&ctx, item.doc().id().key());
-        if (ec) {
-            throw client_error(*ec, "after_rollback_replace_or_remove hook threw error");
-        }
-    } catch (const client_error& e) {
-        auto ec = e.ec();
+    auto error_handler = [this, &ctx, cb](error_class ec, const std::string& message) {
         if (ctx.expiry_overtime_mode_.load()) {
-            throw transaction_operation_failed(FAIL_EXPIRY, std::string("expired while handling ") + e.what()).no_rollback();
+            return cb(std::make_exception_ptr(
+              transaction_operation_failed(FAIL_EXPIRY, std::string("expired while handling ") + message).no_rollback()));
         }
+        adapt_window(ec);
         switch (ec) {
             case FAIL_HARD:
             case FAIL_DOC_NOT_FOUND:
             case FAIL_CAS_MISMATCH:
-                throw transaction_operation_failed(ec, e.what()).no_rollback();
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback()));
             case FAIL_EXPIRY:
                 ctx.expiry_overtime_mode_ = true;
                 ctx.trace("setting expiry overtime mode in {}", STAGE_ROLLBACK_DOC);
-                throw retry_operation("retry rollback_remove_or_replace");
+                return cb(std::make_exception_ptr(retry_operation("retry rollback_remove_or_replace")));
             case FAIL_PATH_NOT_FOUND:
                 // already cleaned up?
-                return;
+                return cb({});
             default:
-                throw retry_operation("retry rollback_remove_or_replace");
+                return cb(std::make_exception_ptr(retry_operation("retry rollback_remove_or_replace")));
         }
+    };
+    ctx.trace("rolling back staged remove/replace for {} with cas {}", item.doc().id(), item.doc().cas());
+    auto ec = ctx.error_if_expired_and_not_in_overtime(STAGE_ROLLBACK_DOC, item.doc().id().key());
+    if (ec) {
+        return error_handler(*ec, "expired in rollback_remove_or_replace and not in expiry overtime");
     }
+    ec = ctx.hooks_.before_doc_rolled_back(&ctx, item.doc().id().key());
+    if (ec) {
+        return error_handler(*ec, "before_doc_rolled_back hook threw error");
+    }
+    core::operations::mutate_in_request req{ item.doc().id() };
+    req.specs =
+      couchbase::mutate_in_specs{
+          couchbase::mutate_in_specs::remove(TRANSACTION_INTERFACE_PREFIX_ONLY).xattr(),
+      }
+        .specs();
+    req.cas = couchbase::cas(item.doc().cas());
+    wrap_durable_request(req, ctx.overall_.config());
+    ctx.cluster_ref().execute(req, [&ctx, &item, cb, error_handler](core::operations::mutate_in_response resp) {
+        auto ec = error_class_from_response(resp);
+        if (ec) {
+            return error_handler(*ec, resp.ctx.ec().message());
+        }
+        ctx.trace("rollback result {}", result::create_from_subdoc_response(resp));
+        if (!!(ec = ctx.hooks_.after_rollback_replace_or_remove(&ctx, item.doc().id().key()))) {
+            return error_handler(*ec, "after_rollback_replace_or_remove hook threw error");
+        }
+        return cb({});
+    });
 }
+
 void
-tx::staged_mutation_queue::commit_doc(attempt_context_impl& ctx, staged_mutation& item, bool ambiguity_resolution_mode, bool cas_zero_mode)
+tx::staged_mutation_queue::commit_doc(attempt_context_impl& ctx,
+                                      staged_mutation& item,
+                                      async_retry_handler&& cb,
+                                      bool ambiguity_resolution_mode,
+                                      bool cas_zero_mode)
 {
-    retry_op<void>([&] {
-        ctx.trace(
-          "commit doc {}, cas_zero_mode {}, ambiguity_resolution_mode {}", item.doc().id(), cas_zero_mode, ambiguity_resolution_mode);
-        try {
-            ctx.check_expiry_during_commit_or_rollback(STAGE_COMMIT_DOC, std::optional<const std::string>(item.doc().id().key()));
-            auto ec = ctx.hooks_.before_doc_committed(&ctx, item.doc().id().key());
-            if (ec) {
-                throw client_error(*ec, "before_doc_committed hook threw error");
-            }
+    auto error_handler = [this, &ctx, &item, cb, ambiguity_resolution_mode, cas_zero_mode](error_class ec, const std::string& message) {
+        auto retry = [this, &ctx, &item, cb](bool ambiguity_resolution_mode, bool cas_zero_mode) {
+            async_delay(ctx.overall_.io_context(),
+                        DEFAULT_RETRY_OP_DELAY,
+                        [this, &ctx, &item, cb, ambiguity_resolution_mode, cas_zero_mode]() mutable {
+                            commit_doc(ctx, item, std::move(cb), ambiguity_resolution_mode, cas_zero_mode);
+                        });
+        };
+        if (ctx.expiry_overtime_mode_.load()) {
+            return cb(std::make_exception_ptr(
+              transaction_operation_failed(FAIL_EXPIRY, "expired during commit").no_rollback().failed_post_commit()));
+        }
+        adapt_window(ec);
+        switch (ec) {
+            case FAIL_AMBIGUOUS:
+                return retry(true, cas_zero_mode);
+            case FAIL_CAS_MISMATCH:
+            case FAIL_DOC_ALREADY_EXISTS:
+                if (ambiguity_resolution_mode) {
+                    return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().failed_post_commit()));
+                }
+                return retry(true, true);
+            default:
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().failed_post_commit()));
+        }
+    };
+    auto on_committed = [&ctx, &item, cb, error_handler](uint64_t cas) {
+        // TODO: mutation tokens
+        auto ec = ctx.hooks_.after_doc_committed_before_saving_cas(&ctx, item.doc().id().key());
+        if (ec) {
+            return error_handler(*ec, "after_doc_committed_before_saving_cas threw error");
+        }
+        item.doc().cas(cas);
+        if (!!(ec = ctx.hooks_.after_doc_committed(&ctx, item.doc().id().key()))) {
+            return error_handler(*ec, "after_doc_committed threw error");
+        }
+        return cb({});
+    };
+    ctx.trace("commit doc {}, cas_zero_mode {}, ambiguity_resolution_mode {}", item.doc().id(), cas_zero_mode, ambiguity_resolution_mode);
+    ctx.check_expiry_during_commit_or_rollback(STAGE_COMMIT_DOC, std::optional<const std::string>(item.doc().id().key()));
+    auto ec = ctx.hooks_.before_doc_committed(&ctx, item.doc().id().key());
+    if (ec) {
+        return error_handler(*ec, "before_doc_committed hook threw error");
+    }
 
-            // move staged content into doc
-            ctx.trace("commit doc id {}, content {}, cas {}", item.doc().id(), item.content(), item.doc().cas());
+    // move staged content into doc
+    ctx.trace("commit doc id {}, content {}, cas {}", item.doc().id(), item.content(), item.doc().cas());
 
-            result res;
-            if (item.type() == staged_mutation_type::INSERT && !cas_zero_mode) {
-                core::operations::insert_request req{ item.doc().id() };
-                auto content = item.doc().content<nlohmann::json>().dump();
-                req.value = core::utils::to_binary(content);
-                wrap_durable_request(req, ctx.overall_.config());
-                auto barrier = std::make_shared<std::promise<result>>();
-                auto f = barrier->get_future();
-                ctx.cluster_ref().execute(req, [barrier](core::operations::insert_response resp) {
-                    barrier->set_value(result::create_from_mutation_response(resp));
-                });
-                res = wrap_operation_future(f);
-            } else {
-                core::operations::mutate_in_request req{ item.doc().id() };
-                req.specs =
-                  couchbase::mutate_in_specs{
-                      couchbase::mutate_in_specs::remove(TRANSACTION_INTERFACE_PREFIX_ONLY).xattr(),
-                      // subdoc::opcode::set_doc used in replace w/ empty path
-                      couchbase::mutate_in_specs::replace_raw("", core::utils::to_binary(item.content())),
-                  }
-                    .specs();
-                req.store_semantics = couchbase::store_semantics::replace;
-                req.cas = couchbase::cas(cas_zero_mode ? 0 : item.doc().cas());
-                wrap_durable_request(req, ctx.overall_.config());
-                auto barrier = std::make_shared<std::promise<result>>();
-                auto f = barrier->get_future();
-                ctx.cluster_ref().execute(req, [barrier](core::operations::mutate_in_response resp) {
-                    barrier->set_value(result::create_from_subdoc_response(resp));
-                });
-                res = wrap_operation_future(f);
-            }
-            ctx.trace("commit doc result {}", res);
-            // TODO: mutation tokens
-            ec = ctx.hooks_.after_doc_committed_before_saving_cas(&ctx, item.doc().id().key());
-            if (ec) {
-                throw client_error(*ec, "after_doc_committed_before_saving_cas threw error");
-            }
-            item.doc().cas(res.cas);
-            ec = ctx.hooks_.after_doc_committed(&ctx, item.doc().id().key());
+    if (item.type() == staged_mutation_type::INSERT && !cas_zero_mode) {
+        core::operations::insert_request req{ item.doc().id() };
+        auto content = item.doc().content<nlohmann::json>().dump();
+        req.value = core::utils::to_binary(content);
+        wrap_durable_request(req, ctx.overall_.config());
+        return ctx.cluster_ref().execute(req, [&ctx, error_handler, on_committed](core::operations::insert_response resp) {
+            auto ec = error_class_from_response(resp);
             if (ec) {
-                throw client_error(*ec, "after_doc_committed threw error");
-            }
-        } catch (const client_error& e) {
-            error_class ec = e.ec();
-            if (ctx.expiry_overtime_mode_.load()) {
-                throw transaction_operation_failed(FAIL_EXPIRY, "expired during commit").no_rollback().failed_post_commit();
-            }
-            switch (ec) {
-                case FAIL_AMBIGUOUS:
-                    ambiguity_resolution_mode = true;
-                    throw retry_operation("FAIL_AMBIGUOUS in commit_doc");
-                case FAIL_CAS_MISMATCH:
-                case FAIL_DOC_ALREADY_EXISTS:
-                    if (ambiguity_resolution_mode) {
-                        throw transaction_operation_failed(ec, e.what()).no_rollback().failed_post_commit();
-                    }
-                    ambiguity_resolution_mode = true;
-                    cas_zero_mode = true;
-                    throw retry_operation("FAIL_DOC_ALREADY_EXISTS in commit_doc");
-                default:
-                    throw transaction_operation_failed(ec, e.what()).no_rollback().failed_post_commit();
+                return error_handler(*ec, resp.ctx.ec().message());
             }
+            ctx.trace("commit doc result {}", result::create_from_mutation_response(resp));
+            return on_committed(resp.cas.value());
+        });
+    }
+    core::operations::mutate_in_request req{ item.doc().id() };
+    req.specs =
+      couchbase::mutate_in_specs{
+          couchbase::mutate_in_specs::remove(TRANSACTION_INTERFACE_PREFIX_ONLY).xattr(),
+          // subdoc::opcode::set_doc used in replace w/ empty path
+          couchbase::mutate_in_specs::replace_raw("", core::utils::to_binary(item.content())),
+      }
+        .specs();
+    req.store_semantics = couchbase::store_semantics::replace;
+    req.cas = couchbase::cas(cas_zero_mode ? 0 : item.doc().cas());
+    wrap_durable_request(req, ctx.overall_.config());
+    ctx.cluster_ref().execute(req, [&ctx, error_handler, on_committed](core::operations::mutate_in_response resp) {
+        auto ec = error_class_from_response(resp);
+        if (ec) {
+            return error_handler(*ec, resp.ctx.ec().message());
         }
+        ctx.trace("commit doc result {}", result::create_from_subdoc_response(resp));
+        return on_committed(resp.cas.value());
     });
 }
 
 void
-tx::staged_mutation_queue::remove_doc(attempt_context_impl& ctx, staged_mutation& item)
+tx::staged_mutation_queue::remove_doc(attempt_context_impl& ctx, staged_mutation& item, async_retry_handler&& cb)
 {
-    retry_op<void>([&] {
-        try {
-            ctx.check_expiry_during_commit_or_rollback(STAGE_REMOVE_DOC, std::optional<const std::string>(item.doc().id().key()));
-            auto ec = ctx.hooks_.before_doc_removed(&ctx, item.doc().id().key());
-            if (ec) {
-                throw client_error(*ec, "before_doc_removed hook threw error");
-            }
-            core::operations::remove_request req{ item.doc().id() };
-            wrap_durable_request(req, ctx.overall_.config());
-            auto barrier = std::make_shared<std::promise<result>>();
-            auto f = barrier->get_future();
-            ctx.cluster_ref().execute(
-              req, [barrier](core::operations::remove_response resp) { barrier->set_value(result::create_from_mutation_response(resp)); });
-            wrap_operation_future(f);
-            ec = ctx.hooks_.after_doc_removed_pre_retry(&ctx, item.doc().id().key());
-            if (ec) {
-                throw client_error(*ec, "after_doc_removed_pre_retry threw error");
-            }
-        } catch (const client_error& e) {
-            error_class ec = e.ec();
-            if (ctx.expiry_overtime_mode_.load()) {
-                throw transaction_operation_failed(ec, e.what()).no_rollback().failed_post_commit();
-            }
-            switch (ec) {
-                case FAIL_AMBIGUOUS:
-                    throw retry_operation("remove_doc got FAIL_AMBIGUOUS");
-                default:
-                    throw transaction_operation_failed(ec, e.what()).no_rollback().failed_post_commit();
-            }
+    auto error_handler = [this, &ctx, &item, cb](error_class ec, const std::string& message) {
+        if (ctx.expiry_overtime_mode_.load()) {
+            return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().failed_post_commit()));
+        }
+        adapt_window(ec);
+        switch (ec) {
+            case FAIL_AMBIGUOUS:
+                ctx.trace("remove_doc got FAIL_AMBIGUOUS, retrying");
+                return async_delay(ctx.overall_.io_context(), DEFAULT_RETRY_OP_DELAY, [this, &ctx, &item, cb]() mutable {
+                    remove_doc(ctx, item, std::move(cb));
+                });
+            default:
+                return cb(std::make_exception_ptr(transaction_operation_failed(ec, message).no_rollback().failed_post_commit()));
+        }
+    };
+    ctx.check_expiry_during_commit_or_rollback(STAGE_REMOVE_DOC, std::optional<const std::string>(item.doc().id().key()));
+    auto ec = ctx.hooks_.before_doc_removed(&ctx, item.doc().id().key());
+    if (ec) {
+        return error_handler(*ec, "before_doc_removed hook threw error");
+    }
+    core::operations::remove_request req{ item.doc().id() };
+    wrap_durable_request(req, ctx.overall_.config());
+    ctx.cluster_ref().execute(req, [&ctx, &item, cb, error_handler](core::operations::remove_response resp) {
+        auto ec = error_class_from_response(resp);
+        if (ec) {
+            return error_handler(*ec, resp.ctx.ec().message());
+        }
+        if (!!(ec = ctx.hooks_.after_doc_removed_pre_retry(&ctx, item.doc().id().key()))) {
+            return error_handler(*ec, "after_doc_removed_pre_retry threw error");
         }
+        return cb({});
     });
 }
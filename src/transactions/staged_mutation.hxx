@@ -16,12 +16,18 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "attempt_context_impl.hxx"
 #include "couchbase/transactions/internal/utils.hxx"
+#include "request_templates.hxx"
 #include <couchbase/transactions/transaction_get_result.hxx>
 
 namespace couchbase
@@ -35,12 +41,20 @@ namespace transactions
       private:
         transaction_get_result doc_;
         staged_mutation_type type_;
-        std::string content_;
+        // usually the same buffer as the staged content in doc_'s links
+        std::shared_ptr<const std::string> content_;
 
       public:
         template<typename Content>
-        staged_mutation(transaction_get_result& doc, Content content, staged_mutation_type type)
-          : doc_(std::move(doc))
+        staged_mutation(const transaction_get_result& doc, Content content, staged_mutation_type type)
+          : doc_(doc)
+          , type_(type)
+          , content_(std::make_shared<const std::string>(std::move(content)))
+        {
+        }
+
+        staged_mutation(const transaction_get_result& doc, std::shared_ptr<const std::string> content, staged_mutation_type type)
+          : doc_(doc)
           , type_(type)
           , content_(std::move(content))
         {
@@ -77,13 +91,19 @@ namespace transactions
         }
 
         const std::string& content() const
+        {
+            static const std::string empty;
+            return content_ ? *content_ : empty;
+        }
+
+        CB_NODISCARD const std::shared_ptr<const std::string>& content_buffer() const
         {
             return content_;
         }
 
         void content(const std::string& content)
         {
-            content_ = content;
+            content_ = std::make_shared<const std::string>(content);
         }
 
         std::string type_as_string() const
@@ -100,25 +120,84 @@ namespace transactions
         }
     };
 
+    /**
+     * Number of staged mutations that may be unstaged concurrently.  Starts at the configured maximum, halves
+     * (down to 1) whenever the cluster returns a transient or ambiguous error, and grows back by one for each
+     * document that is unstaged successfully.
+     */
+    class unstaging_window
+    {
+      public:
+        explicit unstaging_window(size_t max)
+          : max_(std::max<size_t>(1, max))
+          , current_(max_)
+        {
+        }
+
+        CB_NODISCARD size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return current_;
+        }
+
+        void success()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (current_ < max_) {
+                current_++;
+            }
+        }
+
+        void transient_error()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            current_ = std::max<size_t>(1, current_ / 2);
+        }
+
+      private:
+        mutable std::mutex mutex_;
+        const size_t max_;
+        size_t current_;
+    };
+
     class staged_mutation_queue
     {
       private:
         std::mutex mutex_;
-        std::vector<staged_mutation> queue_;
+        // in the order they were staged, which is the order they are committed in
+        std::pmr::vector<staged_mutation> queue_;
+        // position of each document's mutation in queue_, there is at most one per document
+        std::pmr::unordered_map<core::document_id, size_t, document_id_hash, document_id_equal> index_;
+        staged_mutation* find_unlocked(const core::document_id& id, std::optional<staged_mutation_type> type = std::nullopt);
+        void erase_unlocked(const core::document_id& id);
+        std::shared_ptr<unstaging_window> window_;
+        using unstage_func = std::function<void(staged_mutation&, async_retry_handler&&)>;
+        struct unstaging_state;
+        void unstage(attempt_context_impl& ctx, unstage_func&& func, async_retry_handler&& cb, bool stop_on_error = true);
+        void unstage_next(std::shared_ptr<unstaging_state> state);
+        void adapt_window(error_class ec);
         void commit_doc(attempt_context_impl& ctx,
                         staged_mutation& item,
+                        async_retry_handler&& cb,
                         bool ambiguity_resolution_mode = false,
                         bool cas_zero_mode = false);
-        void remove_doc(attempt_context_impl& ctx, staged_mutation& item);
-        void rollback_insert(attempt_context_impl& ctx, staged_mutation& item);
-        void rollback_remove_or_replace(attempt_context_impl& ctx, staged_mutation& item);
+        void remove_doc(attempt_context_impl& ctx, staged_mutation& item, async_retry_handler&& cb);
+        void rollback_insert(attempt_context_impl& ctx, staged_mutation& item, async_retry_handler&& cb);
+        void rollback_remove_or_replace(attempt_context_impl& ctx, staged_mutation& item, async_retry_handler&& cb);
 
       public:
+        // the queue's own storage comes from resource, which is normally the attempt's arena
+        explicit staged_mutation_queue(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+          : queue_(resource)
+          , index_(resource)
+        {
+        }
+
         bool empty();
         void add(const staged_mutation& mutation);
-        void extract_to(const std::string& prefix, core::operations::mutate_in_request& req);
-        void commit(attempt_context_impl& ctx);
-        void rollback(attempt_context_impl& ctx);
+        void extract_to(const atr_entry_paths& paths, core::operations::mutate_in_request& req);
+        void commit(attempt_context_impl& ctx, async_retry_handler&& cb);
+        void rollback(attempt_context_impl& ctx, async_retry_handler&& cb);
         void iterate(std::function<void(staged_mutation&)>);
         void remove_any(const core::document_id&);
 
@@ -0,0 +1,105 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "token_bucket.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+
+namespace couchbase::transactions
+{
+/**
+ * When each bucket is next due a lost attempts sweep.
+ *
+ * Each bucket is swept once per cleanup window, on its own cadence.  A bucket is due as soon as it is added, and after
+ * each sweep it is due again a window after that sweep started, or straight away if the sweep overran.  A bucket being
+ * swept stays known, but isn't due until it is put back.  Not thread-safe.
+ */
+class sweep_schedule
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit sweep_schedule(std::chrono::milliseconds window)
+      : window_(window)
+    {
+    }
+
+    /**
+     * Paces the ATR reads of one sweep of num_atrs ATRs so they are spread evenly over the window, with up to
+     * max_in_flight of them allowed in a burst.
+     */
+    static token_bucket pacer(size_t num_atrs, std::chrono::milliseconds window, size_t max_in_flight, clock::time_point start)
+    {
+        return { static_cast<double>(num_atrs) * 1000.0 / static_cast<double>(std::max<int64_t>(1, window.count())),
+                 max_in_flight,
+                 start };
+    }
+
+    // Makes a bucket not seen before due now.  Returns false if it is already known.
+    bool add(const std::string& bucket, clock::time_point now = clock::now())
+    {
+        if (!known_.insert(bucket).second) {
+            return false;
+        }
+        due_.emplace(now, bucket);
+        return true;
+    }
+
+    size_t size() const
+    {
+        return known_.size();
+    }
+
+    // When the next bucket is due, if any are waiting to be swept.
+    std::optional<clock::time_point> next_due() const
+    {
+        if (due_.empty()) {
+            return {};
+        }
+        return due_.begin()->first;
+    }
+
+    // Takes the bucket that has been due longest, if any are due by now.
+    std::optional<std::string> take(clock::time_point now = clock::now())
+    {
+        if (due_.empty() || due_.begin()->first > now) {
+            return {};
+        }
+        auto bucket = due_.begin()->second;
+        due_.erase(due_.begin());
+        return bucket;
+    }
+
+    // Puts back a bucket taken to be swept, whose sweep started at start.
+    void done(const std::string& bucket, clock::time_point start, clock::time_point now = clock::now())
+    {
+        due_.emplace(std::max(start + window_, now), bucket);
+    }
+
+  private:
+    std::chrono::milliseconds window_;
+    std::set<std::string> known_;
+    std::multimap<clock::time_point, std::string> due_;
+};
+} // namespace couchbase::transactions
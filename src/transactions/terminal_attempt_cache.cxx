@@ -0,0 +1,116 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "terminal_attempt_cache.hxx"
+
+#include <algorithm>
+#include <functional>
+
+namespace couchbase::transactions
+{
+namespace
+{
+// heap used by a key, beyond what's in its node
+size_t
+key_bytes(const std::string& key)
+{
+    // strings up to this long are usually stored inline
+    return key.size() > 15 ? key.capacity() + 1 : 0;
+}
+
+constexpr size_t node_bytes = sizeof(std::pair<const std::string, attempt_state>) + 2 * sizeof(void*);
+} // namespace
+
+terminal_attempt_cache::terminal_attempt_cache(size_t capacity)
+  : generation_size_(std::max<size_t>(1, capacity / shard_count / 2))
+{
+}
+
+terminal_attempt_cache&
+terminal_attempt_cache::instance()
+{
+    static terminal_attempt_cache cache;
+    return cache;
+}
+
+terminal_attempt_cache::shard&
+terminal_attempt_cache::shard_for(const std::string& attempt_id)
+{
+    return shards_[std::hash<std::string>{}(attempt_id) % shard_count];
+}
+
+void
+terminal_attempt_cache::insert(shard& s, std::string attempt_id, attempt_state state)
+{
+    if (s.current.size() >= generation_size_) {
+        for (const auto& [id, _] : s.previous) {
+            key_bytes_ -= key_bytes(id);
+        }
+        entries_ -= s.previous.size();
+        s.previous = std::move(s.current);
+        s.current.clear();
+    }
+    auto bytes = key_bytes(attempt_id);
+    if (s.current.emplace(std::move(attempt_id), state).second) {
+        ++entries_;
+        key_bytes_ += bytes;
+    }
+}
+
+void
+terminal_attempt_cache::add(const atr_entry& entry)
+{
+    if ((entry.state() != attempt_state::COMPLETED && entry.state() != attempt_state::ROLLED_BACK) || entry.forward_compat()) {
+        return;
+    }
+    auto& s = shard_for(entry.attempt_id());
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.current.count(entry.attempt_id()) > 0 || s.previous.count(entry.attempt_id()) > 0) {
+        return;
+    }
+    insert(s, entry.attempt_id(), entry.state());
+}
+
+std::optional<attempt_state>
+terminal_attempt_cache::find(const std::string& attempt_id)
+{
+    ++lookups_;
+    auto& s = shard_for(attempt_id);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (auto it = s.current.find(attempt_id); it != s.current.end()) {
+        ++hits_;
+        return it->second;
+    }
+    if (auto it = s.previous.find(attempt_id); it != s.previous.end()) {
+        ++hits_;
+        auto state = it->second;
+        // still in use, so keep it for another generation
+        key_bytes_ -= key_bytes(it->first);
+        --entries_;
+        s.previous.erase(it);
+        insert(s, attempt_id, state);
+        return state;
+    }
+    return {};
+}
+
+terminal_attempt_stats
+terminal_attempt_cache::stats() const
+{
+    auto entries = entries_.load();
+    return { lookups_.load(), hits_.load(), entries, entries * node_bytes + key_bytes_.load() };
+}
+} // namespace couchbase::transactions
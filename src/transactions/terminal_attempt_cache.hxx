@@ -0,0 +1,92 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <couchbase/transactions/attempt_state.hxx>
+#include <couchbase/transactions/internal/atr_entry.hxx>
+
+namespace couchbase::transactions
+{
+/** Counters for a @ref terminal_attempt_cache */
+struct terminal_attempt_stats {
+    size_t lookups{ 0 };
+    size_t hits{ 0 };
+    // attempts remembered, and roughly how much memory that takes
+    size_t entries{ 0 };
+    size_t memory_bytes{ 0 };
+
+    CB_NODISCARD double hit_rate() const
+    {
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+};
+
+/**
+ * Process-wide cache of attempts known to be COMPLETED or ROLLED_BACK.
+ *
+ * Once an ATR entry reaches either state it never changes, so a read or write which finds a document staged by
+ * such an attempt doesn't need to read the entry again.  Entries with forward compatibility requirements aren't
+ * remembered, as those have to be checked on every read.
+ *
+ * The cache is split into shards, each with its own lock.  A shard keeps two generations: when the current one is
+ * full it becomes the previous one, and the previous one is dropped.  Lookups which hit the previous generation
+ * move the attempt back into the current one, so attempts still being seen stay cached.
+ */
+class terminal_attempt_cache
+{
+  public:
+    static constexpr size_t default_capacity = 16384;
+
+    explicit terminal_attempt_cache(size_t capacity = default_capacity);
+
+    static terminal_attempt_cache& instance();
+
+    /** Remembers the entry's attempt if it is in a terminal state, otherwise does nothing. */
+    void add(const atr_entry& entry);
+
+    CB_NODISCARD std::optional<attempt_state> find(const std::string& attempt_id);
+
+    CB_NODISCARD terminal_attempt_stats stats() const;
+
+  private:
+    static constexpr size_t shard_count = 16;
+
+    struct shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, attempt_state> current;
+        std::unordered_map<std::string, attempt_state> previous;
+    };
+
+    // most attempts per generation per shard
+    const size_t generation_size_;
+    std::array<shard, shard_count> shards_;
+    std::atomic<size_t> lookups_{ 0 };
+    std::atomic<size_t> hits_{ 0 };
+    std::atomic<size_t> entries_{ 0 };
+    std::atomic<size_t> key_bytes_{ 0 };
+
+    shard& shard_for(const std::string& attempt_id);
+    void insert(shard& s, std::string attempt_id, attempt_state state);
+};
+} // namespace couchbase::transactions
@@ -0,0 +1,71 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace couchbase::transactions
+{
+/**
+ * Paces work to a steady rate, allowing short bursts.
+ *
+ * Tokens accrue at rate_per_second, up to burst of them, and each piece of work takes one.  The bucket starts with a
+ * single token, so work is spread out from the start rather than front-loaded.  Rather than counting tokens this
+ * tracks when the next one is due (the "virtual scheduling" form), which keeps it exact in integer time.  Not
+ * thread-safe.
+ */
+class token_bucket
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    token_bucket(double rate_per_second, size_t burst, clock::time_point now = clock::now())
+      : interval_(rate_per_second > 0 ? std::chrono::nanoseconds(static_cast<int64_t>(1e9 / rate_per_second))
+                                      : std::chrono::nanoseconds::max())
+      , tolerance_(rate_per_second > 0 ? interval_ * static_cast<int64_t>(std::max<size_t>(1, burst) - 1)
+                                       : std::chrono::nanoseconds(0))
+      , due_(now + tolerance_)
+    {
+    }
+
+    /**
+     * Takes a token if one is available, returning zero.  Otherwise takes nothing, and returns how long until there
+     * will be one.
+     */
+    std::chrono::microseconds try_acquire(clock::time_point now = clock::now())
+    {
+        if (interval_ == std::chrono::nanoseconds::max()) {
+            return std::chrono::microseconds::max();
+        }
+        if (due_ - now > tolerance_) {
+            return std::chrono::ceil<std::chrono::microseconds>(due_ - tolerance_ - now);
+        }
+        due_ = std::max(due_, now) + interval_;
+        return std::chrono::microseconds(0);
+    }
+
+  private:
+    // time between tokens, and how far ahead of that a burst may run
+    std::chrono::nanoseconds interval_;
+    std::chrono::nanoseconds tolerance_;
+    // when the bucket is next empty, if nothing else is taken
+    clock::time_point due_;
+};
+} // namespace couchbase::transactions
@@ -32,6 +32,12 @@ namespace transactions
       , attempt_context_hooks_(new attempt_context_testing_hooks())
       , cleanup_hooks_(new cleanup_testing_hooks())
       , scan_consistency_(core::query_scan_consistency::request_plus)
+      , max_concurrent_unstaging_(16)
+      , max_concurrent_transactions_(0)
+      , max_queued_transactions_(1024)
+      , cleanup_client_attempts_workers_(4)
+      , cleanup_concurrent_documents_(16)
+      , cleanup_lost_attempts_workers_(4)
     {
     }
 
@@ -47,7 +53,12 @@ namespace transactions
       , cleanup_hooks_(new cleanup_testing_hooks(config.cleanup_hooks()))
       , scan_consistency_(config.scan_consistency())
       , custom_metadata_collection_(config.custom_metadata_collection())
-
+      , max_concurrent_unstaging_(config.max_concurrent_unstaging())
+      , max_concurrent_transactions_(config.max_concurrent_transactions())
+      , max_queued_transactions_(config.max_queued_transactions())
+      , cleanup_client_attempts_workers_(config.cleanup_client_attempts_workers())
+      , cleanup_concurrent_documents_(config.cleanup_concurrent_documents())
+      , cleanup_lost_attempts_workers_(config.cleanup_lost_attempts_workers())
     {
     }
 
@@ -62,6 +73,12 @@ namespace transactions
         cleanup_hooks_.reset(new cleanup_testing_hooks(c.cleanup_hooks()));
         scan_consistency_ = c.scan_consistency();
         custom_metadata_collection_ = c.custom_metadata_collection();
+        max_concurrent_unstaging_ = c.max_concurrent_unstaging();
+        max_concurrent_transactions_ = c.max_concurrent_transactions();
+        max_queued_transactions_ = c.max_queued_transactions();
+        cleanup_client_attempts_workers_ = c.cleanup_client_attempts_workers();
+        cleanup_concurrent_documents_ = c.cleanup_concurrent_documents();
+        cleanup_lost_attempts_workers_ = c.cleanup_lost_attempts_workers();
         return *this;
     }
 
@@ -68,31 +68,36 @@ namespace transactions
         return is_expired;
     }
 
-    void transaction_context::retry_delay()
+    void transaction_context::retry_delay(std::function<void()>&& fn)
     {
         // when we retry an operation, we typically call that function recursively.  So, we need to
         // limit total number of times we do it.  Later we can be more sophisticated, perhaps.
         auto delay = config_.expiration_time() / 100; // the 100 is arbitrary
-        txn_log->trace("about to sleep for {} ms", std::chrono::duration_cast<std::chrono::milliseconds>(delay).count());
-        std::this_thread::sleep_for(delay);
+        txn_log->trace("retrying in {} ms", std::chrono::duration_cast<std::chrono::milliseconds>(delay).count());
+        async_delay(io_context(), delay, std::move(fn));
     }
 
     void transaction_context::new_attempt_context(async_attempt_context::VoidCallback&& cb)
     {
-        // thread.detach hack for async - move the delay to an asio timer
-        std::thread([this, cb = std::move(cb)] {
-            // the first time we call the delay, it just records an end time.  After that, it
-            // actually delays.
+        // the first time we call the delay, it just records an end time.  After that, it
+        // returns the backoff, which we wait out on a timer rather than a thread.
+        std::chrono::nanoseconds delay;
+        try {
+            delay = delay_->next();
+        } catch (...) {
+            return cb(std::current_exception());
+        }
+        auto timer = std::make_shared<asio::steady_timer>(io_context());
+        timer->expires_after(delay);
+        timer->async_wait([this, timer, cb = std::move(cb)](std::error_code) {
             try {
-                (*delay_)();
                 current_attempt_context_ = std::make_shared<attempt_context_impl>(*this);
                 txn_log->info("starting attempt {}/{}/{}/", num_attempts(), transaction_id(), current_attempt_context_->id());
-                cb(nullptr);
             } catch (...) {
-                cb(std::current_exception());
+                return cb(std::current_exception());
             }
-        })
-          .detach();
+            cb(nullptr);
+        });
     }
 
     std::shared_ptr<attempt_context_impl> transaction_context::current_attempt_context()
@@ -187,67 +192,81 @@ namespace transactions
             txn_log->error("got transaction_operation_failed {}", er.what());
             if (er.should_rollback()) {
                 txn_log->trace("got rollback-able exception, rolling back");
-                try {
-                    current_attempt_context_->rollback();
-                } catch (const std::exception& er_rollback) {
-                    cleanup().add_attempt(*current_attempt_context_);
-                    txn_log->trace("got error {} while auto rolling back, throwing original error", er_rollback.what(), er.what());
-                    auto final = er.get_final_exception(*this);
-                    // if you get here, we didn't throw, yet we had an error.  Fall through in
-                    // this case.  Note the current logic is such that rollback will not have a
-                    // commit ambiguous error, so we should always throw.
-                    assert(final);
-                    return callback(final, std::nullopt);
-                }
-                if (er.should_retry() && has_expired_client_side()) {
-                    txn_log->trace("auto rollback succeeded, however we are expired so no retry");
-
-                    return callback(transaction_operation_failed(FAIL_EXPIRY, "expired in auto rollback")
-                                      .no_rollback()
-                                      .expired()
-                                      .get_final_exception(*this),
-                                    {});
-                }
-            }
-            if (er.should_retry()) {
-                txn_log->trace("got retryable exception, retrying");
-                cleanup().add_attempt(*current_attempt_context_);
-                return callback(std::nullopt, std::nullopt);
-            }
+                return current_attempt_context_->rollback(
+                  [this, er, callback = std::move(callback)](std::exception_ptr err_rollback) mutable {
+                      if (err_rollback) {
+                          cleanup().add_attempt(*current_attempt_context_);
+                          try {
+                              std::rethrow_exception(err_rollback);
+                          } catch (const std::exception& er_rollback) {
+                              txn_log->trace(
+                                "got error {} while auto rolling back, throwing original error", er_rollback.what(), er.what());
+                          } catch (...) {
+                              txn_log->trace("got unexpected error while auto rolling back, throwing original error {}", er.what());
+                          }
+                          auto final = er.get_final_exception(*this);
+                          // if you get here, we didn't throw, yet we had an error.  Fall through in
+                          // this case.  Note the current logic is such that rollback will not have a
+                          // commit ambiguous error, so we should always throw.
+                          assert(final);
+                          return callback(final, std::nullopt);
+                      }
+                      if (er.should_retry() && has_expired_client_side()) {
+                          txn_log->trace("auto rollback succeeded, however we are expired so no retry");
 
-            // throw the expected exception here
-            cleanup().add_attempt(*current_attempt_context_);
-            auto final = er.get_final_exception(*this);
-            std::optional<transaction_result> res;
-            if (!final) {
-                res = get_transaction_result();
+                          return callback(transaction_operation_failed(FAIL_EXPIRY, "expired in auto rollback")
+                                            .no_rollback()
+                                            .expired()
+                                            .get_final_exception(*this),
+                                          {});
+                      }
+                      return handle_error_after_rollback(er, std::move(callback));
+                  });
             }
-            return callback(final, res);
+            return handle_error_after_rollback(er, std::move(callback));
         } catch (const std::exception& ex) {
             txn_log->error("got runtime error {}", ex.what());
-            try {
-                current_attempt_context_->rollback();
-            } catch (...) {
-                txn_log->error("got error rolling back {}", ex.what());
-            }
-            cleanup().add_attempt(*current_attempt_context_);
             // the assumption here is this must come from the logic, not
             // our operations (which only throw transaction_operation_failed),
             auto op_failed = transaction_operation_failed(FAIL_OTHER, ex.what());
-            return callback(op_failed.get_final_exception(*this), std::nullopt);
+            return current_attempt_context_->rollback([this, op_failed, callback = std::move(callback)](std::exception_ptr err_rollback) {
+                if (err_rollback) {
+                    txn_log->error("got error rolling back {}", op_failed.what());
+                }
+                cleanup().add_attempt(*current_attempt_context_);
+                return callback(op_failed.get_final_exception(*this), std::nullopt);
+            });
         } catch (...) {
             txn_log->error("got unexpected error, rolling back");
-            try {
-                current_attempt_context_->rollback();
-            } catch (...) {
-                txn_log->error("got error rolling back unexpected error");
-            }
-            cleanup().add_attempt(*current_attempt_context_);
             // the assumption here is this must come from the logic, not
             // our operations (which only throw transaction_operation_failed),
             auto op_failed = transaction_operation_failed(FAIL_OTHER, "Unexpected error");
-            return callback(op_failed.get_final_exception(*this), std::nullopt);
+            return current_attempt_context_->rollback([this, op_failed, callback = std::move(callback)](std::exception_ptr err_rollback) {
+                if (err_rollback) {
+                    txn_log->error("got error rolling back unexpected error");
+                }
+                cleanup().add_attempt(*current_attempt_context_);
+                return callback(op_failed.get_final_exception(*this), std::nullopt);
+            });
+        }
+    }
+
+    void transaction_context::handle_error_after_rollback(const transaction_operation_failed& er, txn_complete_callback&& callback)
+    {
+        if (er.should_retry()) {
+            txn_log->trace("got retryable exception, retrying");
+            cleanup().add_attempt(*current_attempt_context_);
+            return callback(std::nullopt, std::nullopt);
+        }
+
+        // throw the expected exception here
+        cleanup().add_attempt(*current_attempt_context_);
+        auto final = er.get_final_exception(*this);
+        std::optional<transaction_result> res;
+        if (!final) {
+            res = get_transaction_result();
         }
+        return callback(final, res);
     }
 
     void transaction_context::finalize(txn_complete_callback&& cb)
@@ -14,6 +14,7 @@
  *   limitations under the License.
  */
 #include "result.hxx"
+#include "xattr_decoder.hxx"
 #include <couchbase/transactions/transaction_get_result.hxx>
 
 namespace couchbase::transactions
@@ -46,50 +47,50 @@ transaction_get_result::create_from(const core::operations::lookup_in_response&
     std::string content;
 
     if (resp.fields[0].status == key_value_status_code::success) {
-        atr_id = default_json_serializer::deserialize_from_json_string<std::string>(to_string(resp.fields[0].value));
+        atr_id = decode_json_string(to_string_view(resp.fields[0].value));
     }
     if (resp.fields[1].status == key_value_status_code::success) {
-        transaction_id = default_json_serializer::deserialize_from_json_string<std::string>(to_string(resp.fields[1].value));
+        transaction_id = decode_json_string(to_string_view(resp.fields[1].value));
     }
     if (resp.fields[2].status == key_value_status_code::success) {
-        attempt_id = default_json_serializer::deserialize_from_json_string<std::string>(to_string(resp.fields[2].value));
+        attempt_id = decode_json_string(to_string_view(resp.fields[2].value));
     }
     if (resp.fields[3].status == key_value_status_code::success) {
         staged_content = to_string(resp.fields[3].value);
     }
     if (resp.fields[4].status == key_value_status_code::success) {
-        atr_bucket_name = default_json_serializer::deserialize_from_json_string<std::string>(to_string(resp.fields[4].value));
+        atr_bucket_name = decode_json_string(to_string_view(resp.fields[4].value));
     }
     if (resp.fields[5].status == key_value_status_code::success) {
-        atr_scope_name = default_json_serializer::deserialize_from_json_string<std::string>(to_string(resp.fields[5].value));
+        atr_scope_name = decode_json_string(to_string_view(resp.fields[5].value));
     }
     if (resp.fields[6].status == key_value_status_code::success) {
-        atr_collection_name = default_json_serializer::deserialize_from_json_string<std::string>(to_string(resp.fields[6].value));
+        atr_collection_name = decode_json_string(to_string_view(resp.fields[6].value));
     }
 
     if (resp.fields[7].status == key_value_status_code::success) {
-        auto restore = nlohmann::json::parse(to_string(resp.fields[7].value));
-        cas_pre_txn = restore["CAS"].get<std::string>();
+        auto restore = decode_restore(to_string_view(resp.fields[7].value));
+        cas_pre_txn = std::move(restore.cas);
         // only present in 6.5+
-        revid_pre_txn = restore["revid"].get<std::string>();
-        exptime_pre_txn = restore["exptime"].get<uint32_t>();
+        revid_pre_txn = std::move(restore.revid);
+        exptime_pre_txn = restore.exptime;
     }
     if (resp.fields[8].status == key_value_status_code::success) {
-        op = default_json_serializer::deserialize_from_json_string<std::string>(to_string(resp.fields[8].value));
+        op = decode_json_string(to_string_view(resp.fields[8].value));
     }
     if (resp.fields[9].status == key_value_status_code::success) {
-        auto doc = nlohmann::json::parse(to_string(resp.fields[9].value));
-        cas_from_doc = doc["CAS"].get<std::string>();
+        auto doc = decode_document_vattr(to_string_view(resp.fields[9].value));
+        cas_from_doc = std::move(doc.cas);
         // only present in 6.5+
-        revid_from_doc = doc["revid"].get<std::string>();
-        exptime_from_doc = doc["exptime"].get<uint32_t>();
-        crc32_from_doc = doc["value_crc32c"].get<std::string>();
+        revid_from_doc = std::move(doc.revid);
+        exptime_from_doc = doc.exptime;
+        crc32_from_doc = std::move(doc.value_crc32c);
     }
     if (resp.fields[10].status == key_value_status_code::success) {
-        crc32_of_staging = default_json_serializer::deserialize_from_json_string<std::string>(to_string(resp.fields[10].value));
+        crc32_of_staging = decode_json_string(to_string_view(resp.fields[10].value));
     }
     if (resp.fields[11].status == key_value_status_code::success) {
-        forward_compat = nlohmann::json::parse(to_string(resp.fields[11].value));
+        forward_compat = nlohmann::json::parse(to_string_view(resp.fields[11].value));
     } else {
         forward_compat = nlohmann::json::object();
     }
@@ -103,7 +104,7 @@ transaction_get_result::create_from(const core::operations::lookup_in_response&
                             atr_collection_name,
                             transaction_id,
                             attempt_id,
-                            staged_content,
+                            std::move(staged_content),
                             cas_pre_txn,
                             revid_pre_txn,
                             exptime_pre_txn,
@@ -113,9 +114,9 @@ transaction_get_result::create_from(const core::operations::lookup_in_response&
                             resp.deleted);
     document_metadata md(cas_from_doc, revid_from_doc, exptime_from_doc, crc32_from_doc);
     return { { resp.ctx.bucket(), resp.ctx.scope(), resp.ctx.collection(), resp.ctx.id() },
-             content,
+             std::move(content),
              resp.cas.value(),
-             links,
+             std::move(links),
              std::make_optional(md) };
 }
 
@@ -147,46 +148,46 @@ transaction_get_result::create_from(const core::document_id& id, const result& r
     std::string content;
 
     if (res.values[0].has_value()) {
-        atr_id = res.values[0].content_as<std::string>();
+        atr_id = decode_json_string(res.values[0].raw_value);
     }
     if (res.values[1].has_value()) {
-        transaction_id = res.values[1].content_as<std::string>();
+        transaction_id = decode_json_string(res.values[1].raw_value);
     }
     if (res.values[2].has_value()) {
-        attempt_id = res.values[2].content_as<std::string>();
+        attempt_id = decode_json_string(res.values[2].raw_value);
     }
     if (res.values[3].has_value()) {
-        staged_content = res.values[3].content_as<nlohmann::json>().dump();
+        staged_content = res.values[3].raw_value;
     }
     if (res.values[4].has_value()) {
-        atr_bucket_name = res.values[4].content_as<std::string>();
+        atr_bucket_name = decode_json_string(res.values[4].raw_value);
     }
     if (res.values[5].has_value()) {
-        atr_scope_name = res.values[5].content_as<std::string>();
+        atr_scope_name = decode_json_string(res.values[5].raw_value);
     }
     if (res.values[6].has_value()) {
-        atr_collection_name = res.values[6].content_as<std::string>();
+        atr_collection_name = decode_json_string(res.values[6].raw_value);
     }
     if (res.values[7].has_value()) {
-        auto restore = res.values[7].content_as<nlohmann::json>();
-        cas_pre_txn = restore["CAS"].get<std::string>();
+        auto restore = decode_restore(res.values[7].raw_value);
+        cas_pre_txn = std::move(restore.cas);
         // only present in 6.5+
-        revid_pre_txn = restore["revid"].get<std::string>();
-        exptime_pre_txn = restore["exptime"].get<uint32_t>();
+        revid_pre_txn = std::move(restore.revid);
+        exptime_pre_txn = restore.exptime;
     }
     if (res.values[8].has_value()) {
-        op = res.values[8].content_as<std::string>();
+        op = decode_json_string(res.values[8].raw_value);
     }
     if (res.values[9].has_value()) {
-        auto doc = res.values[9].content_as<nlohmann::json>();
-        cas_from_doc = doc["CAS"].get<std::string>();
+        auto doc = decode_document_vattr(res.values[9].raw_value);
+        cas_from_doc = std::move(doc.cas);
         // only present in 6.5+
-        revid_from_doc = doc["revid"].get<std::string>();
-        exptime_from_doc = doc["exptime"].get<uint32_t>();
-        crc32_from_doc = doc["value_crc32c"].get<std::string>();
+        revid_from_doc = std::move(doc.revid);
+        exptime_from_doc = doc.exptime;
+        crc32_from_doc = std::move(doc.value_crc32c);
     }
     if (res.values[10].has_value()) {
-        crc32_of_staging = res.values[10].content_as<std::string>();
+        crc32_of_staging = decode_json_string(res.values[10].raw_value);
     }
     if (res.values[11].has_value()) {
         forward_compat = res.values[11].content_as<nlohmann::json>();
@@ -194,7 +195,7 @@ transaction_get_result::create_from(const core::document_id& id, const result& r
         forward_compat = nlohmann::json::object();
     }
     if (res.values[12].has_value()) {
-        content = res.values[12].content_as<nlohmann::json>().dump();
+        content = res.values[12].raw_value;
     }
 
     transaction_links links(atr_id,
@@ -203,7 +204,7 @@ transaction_get_result::create_from(const core::document_id& id, const result& r
                             atr_collection_name,
                             transaction_id,
                             attempt_id,
-                            staged_content,
+                            std::move(staged_content),
                             cas_pre_txn,
                             revid_pre_txn,
                             exptime_pre_txn,
@@ -212,6 +213,6 @@ transaction_get_result::create_from(const core::document_id& id, const result& r
                             forward_compat,
                             res.is_deleted);
     document_metadata md(cas_from_doc, revid_from_doc, exptime_from_doc, crc32_from_doc);
-    return { id, content, res.cas, links, std::make_optional(md) };
+    return { id, std::move(content), res.cas, std::move(links), std::make_optional(md) };
 }
 }; // namespace couchbase::transactions
\ No newline at end of file
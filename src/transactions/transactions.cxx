@@ -14,6 +14,7 @@
  *   limitations under the License.
  */
 
+#include "admission_control.hxx"
 #include "attempt_context_impl.hxx"
 #include "couchbase/transactions/internal/exceptions_internal.hxx"
 #include "couchbase/transactions/internal/logging.hxx"
@@ -22,12 +23,16 @@
 #include "couchbase/transactions/internal/utils.hxx"
 #include <couchbase/transactions.hxx>
 
+#include <asio/post.hpp>
+
 namespace tx = couchbase::transactions;
 
 tx::transactions::transactions(core::cluster& cluster, const transaction_config& config)
   : cluster_(cluster)
   , config_(config)
   , cleanup_(new transactions_cleanup(cluster_, config_))
+  , admission_(new admission_control(*io_, config_.max_concurrent_transactions(), config_.max_queued_transactions()))
+  , work_(new asio::executor_work_guard<asio::io_context::executor_type>(asio::make_work_guard(*io_)))
 {
     txn_log->info("couchbase transactions {}{} creating new transaction object", VERSION_STR, VERSION_SHA);
     // if the config specifies custom metadata collection, lets be sure to open that bucket
@@ -54,15 +59,75 @@ tx::transactions::transactions(core::cluster& cluster, const transaction_config&
             throw std::runtime_error(err_msg);
         }
     }
+    for (size_t i = 0; i < num_io_threads_; i++) {
+        io_threads_.emplace_back([io = io_]() { io->run(); });
+    }
+}
+
+tx::transactions::~transactions()
+{
+    close();
+}
+
+tx::admission_stats
+tx::transactions::admission() const
+{
+    return admission_->stats();
+}
+
+static tx::transaction_exception
+admission_failure(const tx::transaction_context& overall, bool shed)
+{
+    if (shed) {
+        return *tx::transaction_operation_failed(tx::FAIL_EXPIRY, "transaction expired waiting to be admitted")
+                  .no_rollback()
+                  .expired()
+                  .get_final_exception(overall);
+    }
+    return *tx::transaction_operation_failed(tx::FAIL_OTHER, "too many concurrent transactions, rejected")
+              .no_rollback()
+              .get_final_exception(overall);
 }
 
-tx::transactions::~transactions() = default;
+static tx::transaction_exception
+closed_failure(const tx::transaction_context& overall)
+{
+    return *tx::transaction_operation_failed(tx::FAIL_OTHER, "transactions object is closed").no_rollback().get_final_exception(overall);
+}
+
+// Releases the admission slot of a sync transaction, however wrap_run exits.
+struct admission_guard {
+    tx::admission_control& admission;
+    std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+
+    ~admission_guard()
+    {
+        admission.release(std::chrono::steady_clock::now() - start);
+    }
+};
 
 template<typename Handler>
 tx::transaction_result
 wrap_run(tx::transactions& txns, const tx::per_transaction_config& config, size_t max_attempts, Handler&& fn)
 {
     tx::transaction_context overall(txns, config);
+    if (txns.closed()) {
+        // there are no io threads left to drive it
+        throw closed_failure(overall);
+    }
+    auto admitted = std::make_shared<std::promise<void>>();
+    auto admitted_future = admitted->get_future();
+    txns.admission_controller().admit(
+      overall.remaining(),
+      [admitted]() { admitted->set_value(); },
+      [admitted, &overall, &txns](bool shed) {
+          // rejected by close() if it raced with the check above
+          auto failure = txns.closed() ? closed_failure(overall) : admission_failure(overall, shed);
+          admitted->set_exception(std::make_exception_ptr(failure));
+      });
+    // throws if rejected or shed
+    admitted_future.get();
+    admission_guard guard{ txns.admission_controller() };
     size_t attempts{ 0 };
     while (attempts++ < max_attempts) {
         // NOTE: new_attempt_context has the exponential backoff built in.  So, after
@@ -118,18 +183,66 @@ tx::transactions::run(const per_transaction_config& config, logic&& logic)
     return wrap_run(*this, config, max_attempts_, std::move(logic));
 }
 
-void
-tx::transactions::run(const per_transaction_config& config, async_logic&& logic, txn_complete_callback&& cb)
+// One step of the async state machine: schedule a new attempt (the backoff is a timer on the transactions
+// io_context), run the logic, then finalize or handle the error.  A retry just schedules the next step, so
+// nothing ever blocks a thread waiting on an attempt.
+static void
+run_async_attempt(std::shared_ptr<tx::transaction_context> overall,
+                  std::shared_ptr<tx::async_deferred_logic> logic,
+                  size_t attempts_remaining,
+                  tx::txn_complete_callback&& cb)
 {
-    std::thread([this, config, logic = std::move(logic), cb = std::move(cb)] {
+    if (attempts_remaining == 0) {
+        // only thing to do here is return, but we really exceeded the max attempts
+        return cb(std::nullopt, overall->get_transaction_result());
+    }
+    overall->new_attempt_context([overall, logic, attempts_remaining, cb = std::move(cb)](std::exception_ptr err) mutable {
+        if (err) {
+            // the only thing new_attempt_context raises is a timeout of its backoff
+            try {
+                std::rethrow_exception(err);
+            } catch (const std::exception& e) {
+                auto final =
+                  tx::transaction_operation_failed(tx::FAIL_EXPIRY, e.what()).no_rollback().expired().get_final_exception(*overall);
+                return cb(final, std::nullopt);
+            }
+        }
+        auto finalize_handler = [overall, logic, attempts_remaining, cb](std::optional<tx::transaction_exception> err,
+                                                                          std::optional<tx::transaction_result> result) mutable {
+            if (result) {
+                return cb(std::nullopt, result);
+            } else if (err) {
+                return cb(err, std::nullopt);
+            }
+            // no return value, no exception means retry.
+            run_async_attempt(overall, logic, attempts_remaining - 1, std::move(cb));
+        };
+        auto logic_done = [overall, finalize_handler](std::exception_ptr err) mutable {
+            if (err) {
+                return overall->handle_error(err, std::move(finalize_handler));
+            }
+            overall->finalize(std::move(finalize_handler));
+        };
         try {
-            auto result = wrap_run(*this, config, max_attempts_, std::move(logic));
-            return cb({}, result);
-        } catch (const transaction_exception& e) {
-            return cb(e, std::nullopt);
+            auto ctx = overall->current_attempt_context();
+            (*logic)(*ctx, std::move(logic_done));
+        } catch (...) {
+            return overall->handle_error(std::current_exception(), std::move(finalize_handler));
         }
-    })
-      .detach();
+    });
+}
+
+void
+tx::transactions::run(const per_transaction_config& config, async_logic&& logic, txn_complete_callback&& cb)
+{
+    // the logic is done as soon as it returns
+    run_deferred(
+      config,
+      [logic = std::move(logic)](async_attempt_context& ctx, async_attempt_context::VoidCallback&& done) {
+          logic(ctx);
+          done({});
+      },
+      std::move(cb));
 }
 void
 tx::transactions::run(async_logic&& logic, txn_complete_callback&& cb)
@@ -138,10 +251,64 @@ tx::transactions::run(async_logic&& logic, txn_complete_callback&& cb)
     return run(config, std::move(logic), std::move(cb));
 }
 
+void
+tx::transactions::run_deferred(const per_transaction_config& config, async_deferred_logic&& logic, txn_complete_callback&& cb)
+{
+    auto overall = std::make_shared<transaction_context>(*this, config);
+    if (closed_.load()) {
+        // there are no io threads left to drive it
+        return cb(closed_failure(*overall), std::nullopt);
+    }
+    auto shared_logic = std::make_shared<async_deferred_logic>(std::move(logic));
+    admission_->admit(
+      overall->remaining(),
+      [this, overall, shared_logic, cb]() {
+          // may be called from the end of another transaction, so start this one afresh on the io_context
+          asio::post(*io_, [this, overall, shared_logic, cb]() {
+              auto start = std::chrono::steady_clock::now();
+              run_async_attempt(overall,
+                                shared_logic,
+                                max_attempts_,
+                                [this, start, cb](std::optional<transaction_exception> err, std::optional<transaction_result> result) {
+                                    // release first: cb may destroy this object, and close() waits for it
+                                    admission_->release(std::chrono::steady_clock::now() - start);
+                                    cb(std::move(err), std::move(result));
+                                });
+          });
+      },
+      [this, overall, cb](bool shed) { cb(closed_.load() ? closed_failure(*overall) : admission_failure(*overall, shed), std::nullopt); });
+}
+void
+tx::transactions::run_deferred(async_deferred_logic&& logic, txn_complete_callback&& cb)
+{
+    per_transaction_config config;
+    return run_deferred(config, std::move(logic), std::move(cb));
+}
+
 void
 tx::transactions::close()
 {
+    if (closed_.exchange(true)) {
+        return;
+    }
     txn_log->info("closing transactions");
     cleanup_->close();
+    // nothing queued will get to run now, and their timers would hold up the io threads
+    admission_->close();
+    // Let the transactions still running finish, as their handlers refer to this object.  They may be waiting on KV
+    // responses rather than on the io_context, so stopping the io threads isn't enough to wait for them.  When closed
+    // from a completion callback, that transaction has already been released, and the other io thread drives the rest.
+    admission_->wait_idle();
+    work_.reset();
+    for (auto& t : io_threads_) {
+        if (t.get_id() == std::this_thread::get_id()) {
+            // closed from a completion callback - this thread can't join itself.  Nothing left on the io_context refers
+            // to this object, and the thread holds its own reference to the io_context, so it is safe to let it go.
+            txn_log->debug("transactions closed from one of its own io threads, not waiting for that thread");
+            t.detach();
+        } else if (t.joinable()) {
+            t.join();
+        }
+    }
     txn_log->info("transactions closed");
 }
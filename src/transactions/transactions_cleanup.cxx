@@ -16,8 +16,11 @@
 
 #include "active_transaction_record.hxx"
 #include "atr_ids.hxx"
+#include "atr_read_coalescer.hxx"
 #include "attempt_context_impl.hxx"
+#include "cleanup_pool.hxx"
 #include "cleanup_testing_hooks.hxx"
+#include "sweep_schedule.hxx"
 #include "couchbase/transactions/internal/client_record.hxx"
 #include "couchbase/transactions/internal/logging.hxx"
 #include "couchbase/transactions/internal/transaction_fields.hxx"
@@ -27,7 +30,10 @@
 
 #include <algorithm>
 #include <chrono>
+#include <deque>
 #include <functional>
+#include <tuple>
+#include <unordered_map>
 
 namespace tx = couchbase::transactions;
 
@@ -42,12 +48,18 @@ tx::transactions_cleanup_attempt::transactions_cleanup_attempt(const tx::atr_cle
 tx::transactions_cleanup::transactions_cleanup(core::cluster& cluster, const tx::transaction_config& config)
   : cluster_(cluster)
   , config_(config)
+  , atr_reads_(std::make_unique<atr_read_coalescer>(cluster))
+  // the cleaning thread works on one document itself
+  , document_pool_(std::make_unique<cleanup_pool>(std::max<size_t>(1, config.cleanup_concurrent_documents()) - 1))
+  , sweeps_(std::make_unique<sweep_schedule>(config.cleanup_window()))
   , client_uuid_(uid_generator::next())
   , running_(false)
 {
     if (config.cleanup_client_attempts()) {
         running_ = true;
-        cleanup_thr_ = std::thread(std::bind(&transactions_cleanup::attempts_loop, this));
+        for (size_t i = 0; i < std::max<size_t>(1, config.cleanup_client_attempts_workers()); i++) {
+            cleanup_workers_.emplace_back(std::bind(&transactions_cleanup::attempts_loop, this));
+        }
     }
     if (config.cleanup_lost_attempts()) {
         running_ = true;
@@ -116,106 +128,169 @@ tx::transactions_cleanup::interruptable_wait(std::chrono::duration<R, P> delay)
     return running_.load();
 }
 
-void
+tx::lost_attempts_sweep_stats
 tx::transactions_cleanup::clean_lost_attempts_in_bucket(const std::string& bucket_name)
 {
+    lost_attempts_sweep_stats stats;
     lost_attempts_cleanup_log->info("{} cleanup for {} starting", static_cast<void*>(this), bucket_name);
     if (!running_.load()) {
         lost_attempts_cleanup_log->info("{} cleanup of {} complete", static_cast<void*>(this), bucket_name);
-        return;
+        return stats;
     }
     auto details = get_active_clients(bucket_name, client_uuid_);
     auto all_atrs = atr_ids::all();
+    std::vector<core::document_id> atrs;
+    for (size_t i = details.index_of_this_client; i < all_atrs.size(); i += std::max<size_t>(1, details.num_active_clients)) {
+        atrs.push_back(config_.atr_id_from_bucket_and_key(bucket_name, all_atrs[i]));
+    }
 
-    // TXNCXX-232 - dynamically adjust the budget for fetching each ATR, based on how long is left of the cleanup window and how many are
-    // left to fetch
-    auto atrs_handled_by_this_client = all_atrs.size() / details.num_active_clients;
-    std::chrono::microseconds cleanup_window = std::chrono::duration_cast<std::chrono::microseconds>(config_.cleanup_window());
+    // Spread the ATR reads evenly over the cleanup window.  A few reads are in flight at once, and the
+    // pacing allows a short burst, so a slow ATR (or one with entries to clean) doesn't push the rest past the window.
+    auto cleanup_window = config_.cleanup_window();
     auto start = std::chrono::steady_clock::now();
+    auto pacer = sweep_schedule::pacer(atrs.size(), cleanup_window, max_concurrent_atr_reads_, start);
     lost_attempts_cleanup_log->info("{} {} active clients (including this one), {} atrs to check in {}ms",
                                     static_cast<void*>(this),
                                     details.num_active_clients,
-                                    all_atrs.size(),
-                                    config_.cleanup_window().count());
-
-    for (auto it = all_atrs.begin() + details.index_of_this_client; it < all_atrs.end(); it += details.num_active_clients) {
-        auto atrs_left_for_this_client = std::distance(it, all_atrs.end()) / std::max<size_t>(1, details.num_active_clients);
-        auto now = std::chrono::steady_clock::now();
-        std::chrono::microseconds elapsed_in_cleanup_window = std::chrono::duration_cast<std::chrono::microseconds>(now - start);
-        std::chrono::microseconds remaining_in_cleanup_window = cleanup_window - elapsed_in_cleanup_window;
-        std::chrono::microseconds budget_for_this_atr =
-          std::chrono::microseconds(remaining_in_cleanup_window.count() / std::max<size_t>(1, atrs_left_for_this_client));
-
-        // clean the ATR entry
-        std::string atr_id = *it;
-        if (!running_.load()) {
-            lost_attempts_cleanup_log->debug("{} cleanup of {} complete", static_cast<void*>(this), bucket_name);
-            return;
+                                    atrs.size(),
+                                    cleanup_window.count());
+
+    // reads complete into here, which they keep alive
+    struct completions {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::tuple<core::document_id, std::error_code, atr_read_coalescer::atr_ptr>> done;
+    };
+    auto completed = std::make_shared<completions>();
+    size_t next = 0;
+    size_t in_flight = 0;
+    bool stopping = false;
+    while (in_flight > 0 || (!stopping && next < atrs.size())) {
+        if (!stopping && !running_.load()) {
+            // don't start any more, but let the reads in flight finish
+            lost_attempts_cleanup_log->debug("{} stopping cleanup of {}", static_cast<void*>(this), bucket_name);
+            stopping = true;
         }
-        try {
-            auto id = config_.atr_id_from_bucket_and_key(bucket_name, atr_id);
-            handle_atr_cleanup(id);
-
-        } catch (const std::runtime_error& err) {
-            lost_attempts_cleanup_log->error(
-              "{} cleanup of atr {} failed with {}, moving on", static_cast<void*>(this), atr_id, err.what());
+        std::chrono::microseconds wait = cleanup_loop_delay_;
+        while (!stopping && next < atrs.size() && in_flight < max_concurrent_atr_reads_) {
+            auto until_next = pacer.try_acquire();
+            if (until_next.count() > 0) {
+                wait = std::min(wait, until_next);
+                break;
+            }
+            ++in_flight;
+            atr_reads_->get(atrs[next], [completed, id = atrs[next]](std::error_code ec, atr_read_coalescer::atr_ptr atr) {
+                std::lock_guard<std::mutex> lock(completed->mutex);
+                completed->done.emplace_back(id, ec, std::move(atr));
+                completed->cv.notify_one();
+            });
+            ++next;
         }
 
-        auto atr_end = std::chrono::steady_clock::now();
-        std::chrono::microseconds atr_used = std::chrono::duration_cast<std::chrono::microseconds>(atr_end - now);
-        std::chrono::microseconds atr_left = budget_for_this_atr - atr_used;
-
-        // Too verbose to log, but leaving here commented as it may be useful later for internal debugging
-        /*lost_attempts_cleanup_log->info("{} {} atrs_left_for_this_client={} elapsed_in_cleanup_window={}us "
-                                        "remaining_in_cleanup_window={}us budget_for_this_atr={}us atr_used={}us atr_left={}us",
-                                        bucket_name,
-                                        atr_id,
-                                        atrs_left_for_this_client,
-                                        elapsed_in_cleanup_window.count(),
-                                        remaining_in_cleanup_window.count(),
-                                        budget_for_this_atr.count(),
-                                        atr_used.count(),
-                                        atr_left.count());*/
-
-        if (atr_left.count() > 0 && atr_left.count() < 1000000000) { // safety check protects against bugs
-            std::this_thread::sleep_for(atr_left);
+        std::deque<std::tuple<core::document_id, std::error_code, atr_read_coalescer::atr_ptr>> ready;
+        {
+            std::unique_lock<std::mutex> lock(completed->mutex);
+            completed->cv.wait_for(lock, wait, [&]() { return !completed->done.empty(); });
+            ready.swap(completed->done);
+        }
+        for (auto& [id, ec, atr] : ready) {
+            --in_flight;
+            if (stopping) {
+                continue;
+            }
+            ++stats.atrs_scanned;
+            if (ec) {
+                ++stats.errors;
+                lost_attempts_cleanup_log->error(
+                  "{} cleanup of atr {} failed with {}, moving on", static_cast<void*>(this), id.key(), ec.message());
+                continue;
+            }
+            if (!atr) {
+                continue;
+            }
+            ++stats.atrs_found;
+            try {
+                stats.entries_found += clean_atr_entries(id, *atr).num_entries;
+            } catch (const std::exception& err) {
+                ++stats.errors;
+                lost_attempts_cleanup_log->error(
+                  "{} cleanup of atr {} failed with {}, moving on", static_cast<void*>(this), id.key(), err.what());
+            }
         }
     }
-    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start);
-    lost_attempts_cleanup_log->info("{} cleanup of {} complete in {}s", static_cast<void*>(this), bucket_name, elapsed.count());
+
+    stats.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    stats.overran = stats.elapsed > cleanup_window;
+    lost_attempts_cleanup_log->info("{} cleanup of {} complete in {}ms: {} atrs scanned, {} found with {} entries, {} errors{}",
+                                    static_cast<void*>(this),
+                                    bucket_name,
+                                    stats.elapsed.count(),
+                                    stats.atrs_scanned,
+                                    stats.atrs_found,
+                                    stats.entries_found,
+                                    stats.errors,
+                                    stats.overran ? ", overran the cleanup window" : "");
+    return stats;
 }
 
 const tx::atr_cleanup_stats
 tx::transactions_cleanup::handle_atr_cleanup(const core::document_id& atr_id, std::vector<transactions_cleanup_attempt>* results)
+{
+    auto atr = atr_reads_->get(atr_id);
+    if (!atr) {
+        return {};
+    }
+    return clean_atr_entries(atr_id, *atr, results);
+}
+
+const tx::atr_cleanup_stats
+tx::transactions_cleanup::clean_atr_entries(const core::document_id& atr_id,
+                                            const active_transaction_record& atr,
+                                            std::vector<transactions_cleanup_attempt>* results)
 {
     atr_cleanup_stats stats;
-    auto atr = active_transaction_record::get_atr(cluster_, atr_id);
-    if (atr) {
-        // ok, loop through the attempts and clean them all.  The entry will
-        // check if expired, nothing much to do here except call clean.
-        stats.exists = true;
-        stats.num_entries = atr->entries().size();
-        for (const auto& entry : atr->entries()) {
-            // If we were passed results, then we are testing, and want to set the
-            // check_if_expired to false.
-            atr_cleanup_entry cleanup_entry(entry, atr_id, *this, results == nullptr);
-            try {
-                if (results) {
-                    results->emplace_back(cleanup_entry);
-                }
-                cleanup_entry.clean(lost_attempts_cleanup_log, results ? &results->back() : nullptr);
-                if (results) {
-                    results->back().success(true);
-                }
-            } catch (const std::exception& e) {
-                lost_attempts_cleanup_log->error(
-                  "{} cleanup of {} failed: {}, moving on", static_cast<void*>(this), cleanup_entry, e.what());
-                if (results) {
-                    results->back().success(false);
-                }
+    // ok, loop through the attempts and clean them all.  The entry will
+    // check if expired, nothing much to do here except call clean.
+    stats.exists = true;
+    const std::vector<atr_entry>* entries = nullptr;
+    try {
+        // the entries are decoded here, the first time they are asked for
+        entries = &atr.entries();
+    } catch (const std::exception& e) {
+        lost_attempts_cleanup_log->error(
+          "{} could not decode entries of atr {}: {}, moving on", static_cast<void*>(this), atr_id.key(), e.what());
+        return stats;
+    }
+    stats.num_entries = entries->size();
+    // The cleaned entries are removed from the ATR together at the end, unless we are testing and need to know how
+    // each one went.
+    atr_entry_removals removals(atr_id, *this);
+    for (const auto& entry : *entries) {
+        // If we were passed results, then we are testing, and want to set the
+        // check_if_expired to false.
+        atr_cleanup_entry cleanup_entry(entry, atr_id, *this, results == nullptr);
+        try {
+            if (results) {
+                results->emplace_back(cleanup_entry);
+            }
+            cleanup_entry.clean(lost_attempts_cleanup_log, results ? &results->back() : nullptr, results ? nullptr : &removals);
+            if (results) {
+                results->back().success(true);
+            }
+        } catch (const std::exception& e) {
+            lost_attempts_cleanup_log->error(
+              "{} cleanup of {} failed: {}, moving on", static_cast<void*>(this), cleanup_entry, e.what());
+            if (results) {
+                results->back().success(false);
             }
         }
     }
+    try {
+        removals.remove(lost_attempts_cleanup_log);
+    } catch (const std::exception& e) {
+        lost_attempts_cleanup_log->error(
+          "{} removing cleaned entries from atr {} failed: {}, moving on", static_cast<void*>(this), atr_id.key(), e.what());
+    }
     return stats;
 }
 
@@ -454,37 +529,73 @@ tx::transactions_cleanup::remove_client_record_from_all_buckets(const std::strin
 void
 tx::transactions_cleanup::lost_attempts_loop()
 {
-    lost_attempts_cleanup_log->info("{} starting lost attempts loop", static_cast<void*>(this));
+    auto num_workers = std::max<size_t>(1, config_.cleanup_lost_attempts_workers());
+    lost_attempts_cleanup_log->info("{} starting lost attempts loop with {} workers", static_cast<void*>(this), num_workers);
+    for (size_t i = 0; i < num_workers; i++) {
+        sweep_workers_.emplace_back(&transactions_cleanup::sweep_worker, this);
+    }
+    // Each bucket gets swept once per cleanup window, on its own schedule, by whichever worker is free.  All this
+    // thread does is look for buckets opened since the last time round, and schedule them.
     while (running_.load()) {
-        std::list<std::thread> workers;
         try {
             auto names = get_and_open_buckets(cluster_);
-            lost_attempts_cleanup_log->info("{} creating {} tasks to clean buckets", static_cast<void*>(this), names.size());
-            // TODO consider std::async here.
+            std::unique_lock<std::mutex> lock(mutex_);
+            size_t added = 0;
             for (const auto& name : names) {
-                workers.emplace_back([&]() {
-                    try {
-                        clean_lost_attempts_in_bucket(name);
-                    } catch (const std::runtime_error& e) {
-                        lost_attempts_cleanup_log->error(
-                          "{} got error {} attempting to clean {}", static_cast<void*>(this), e.what(), name);
-                    }
-                });
-            }
-            for (auto& thr : workers) {
-                if (thr.joinable()) {
-                    thr.join();
+                if (sweeps_->add(name)) {
+                    added++;
                 }
             }
+            if (added > 0) {
+                lost_attempts_cleanup_log->info(
+                  "{} scheduled {} new buckets for cleanup, {} in total", static_cast<void*>(this), added, sweeps_->size());
+                cv_.notify_all();
+            }
         } catch (const std::exception& e) {
             lost_attempts_cleanup_log->error(
               "{} got error {}, rescheduling in {}ms", static_cast<void*>(this), e.what(), config_.cleanup_window().count());
-            interruptable_wait(config_.cleanup_window());
         }
+        interruptable_wait(config_.cleanup_window());
     }
+    for (auto& thr : sweep_workers_) {
+        if (thr.joinable()) {
+            thr.join();
+        }
+    }
+    sweep_workers_.clear();
     remove_client_record_from_all_buckets(client_uuid_);
 }
 
+void
+tx::transactions_cleanup::sweep_worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_.load()) {
+        auto due = sweeps_->next_due();
+        if (!due) {
+            cv_.wait(lock, [&]() { return !running_.load() || sweeps_->next_due(); });
+            continue;
+        }
+        auto name = sweeps_->take();
+        if (!name) {
+            // woken early when a bucket is added, or we are stopped
+            cv_.wait_until(lock, *due);
+            continue;
+        }
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        try {
+            clean_lost_attempts_in_bucket(*name);
+        } catch (const std::exception& e) {
+            lost_attempts_cleanup_log->error("{} got error {} attempting to clean {}", static_cast<void*>(this), e.what(), *name);
+        }
+
+        lock.lock();
+        sweeps_->done(*name, start);
+    }
+}
+
 const tx::atr_cleanup_stats
 tx::transactions_cleanup::force_cleanup_atr(const core::document_id& atr_id, std::vector<transactions_cleanup_attempt>& results)
 {
@@ -530,22 +641,22 @@ tx::transactions_cleanup::attempts_loop()
 {
     try {
         attempt_cleanup_log->debug("cleanup attempts loop starting...");
-        while (interruptable_wait(cleanup_loop_delay_)) {
-            while (auto entry = atr_queue_.pop()) {
-                if (!running_.load()) {
-                    attempt_cleanup_log->debug("loop stopping - {} entries on queue", atr_queue_.size());
-                    return;
-                }
-                if (entry) {
-                    attempt_cleanup_log->trace("beginning cleanup on {}", *entry);
-                    try {
-                        entry->clean(attempt_cleanup_log);
-                    } catch (...) {
-                        // catch everything as we don't want to raise out of this thread
-                        attempt_cleanup_log->info("got error cleaning {}, leaving for lost txn cleanup", entry.value());
-                    }
+        // sleeps until the oldest entry is ready, or an earlier one is added, or we are closed
+        while (auto entry = atr_queue_.pop_when_ready()) {
+            if (!running_.load()) {
+                attempt_cleanup_log->debug("loop stopping - {} entries on queue", atr_queue_.size());
+                return;
+            }
+            // take whatever else is ready too, so entries in the same ATR share one read and their removal
+            std::vector<atr_cleanup_entry> batch{ std::move(*entry) };
+            while (batch.size() < max_cleanup_batch_) {
+                auto more = atr_queue_.pop();
+                if (!more) {
+                    break;
                 }
+                batch.push_back(std::move(*more));
             }
+            clean_attempts(batch);
         }
         attempt_cleanup_log->info("stopping - {} entries on queue", atr_queue_.size());
     } catch (const std::runtime_error& e) {
@@ -553,6 +664,67 @@ tx::transactions_cleanup::attempts_loop()
     }
 }
 
+void
+tx::transactions_cleanup::clean_attempts(std::vector<atr_cleanup_entry>& batch)
+{
+    std::vector<std::vector<atr_cleanup_entry*>> by_atr;
+    std::unordered_map<core::document_id, size_t, document_id_hash, document_id_equal> index;
+    for (auto& entry : batch) {
+        auto [it, inserted] = index.emplace(entry.atr_id(), by_atr.size());
+        if (inserted) {
+            by_atr.emplace_back();
+        }
+        by_atr[it->second].push_back(&entry);
+    }
+    for (auto& group : by_atr) {
+        if (group.size() == 1) {
+            // just this attempt's entry, rather than the whole ATR
+            auto& entry = *group.front();
+            attempt_cleanup_log->trace("beginning cleanup on {}", entry);
+            try {
+                entry.clean(attempt_cleanup_log);
+            } catch (...) {
+                // catch everything as we don't want to raise out of this thread
+                attempt_cleanup_log->info("got error cleaning {}, leaving for lost txn cleanup", entry);
+            }
+            continue;
+        }
+        const auto& atr_id = group.front()->atr_id();
+        attempt_cleanup_log->trace("beginning cleanup of {} attempts in atr {}", group.size(), atr_id);
+        atr_read_coalescer::atr_ptr atr;
+        try {
+            atr = atr_reads_->get(atr_id);
+        } catch (...) {
+            attempt_cleanup_log->info("got error reading atr {}, leaving {} attempts for lost txn cleanup", atr_id, group.size());
+            continue;
+        }
+        if (!atr) {
+            attempt_cleanup_log->trace("atr {} not found, nothing to clean", atr_id);
+            continue;
+        }
+        atr_entry_removals removals(atr_id, *this);
+        for (auto* queued : group) {
+            try {
+                auto entry = atr->find_entry(queued->attempt_id());
+                if (!entry) {
+                    attempt_cleanup_log->trace("could not find attempt {} in atr {}, nothing to clean", queued->attempt_id(), atr_id);
+                    continue;
+                }
+                atr_cleanup_entry cleanup_entry(*entry, atr_id, *this, false);
+                cleanup_entry.clean(attempt_cleanup_log, nullptr, &removals);
+            } catch (...) {
+                attempt_cleanup_log->info("got error cleaning {}, leaving for lost txn cleanup", *queued);
+            }
+        }
+        auto cleaned = removals.size();
+        try {
+            removals.remove(attempt_cleanup_log);
+        } catch (...) {
+            attempt_cleanup_log->info("got error removing {} attempts from atr {}, leaving for lost txn cleanup", cleaned, atr_id);
+        }
+    }
+}
+
 void
 tx::transactions_cleanup::add_attempt(attempt_context& ctx)
 {
@@ -581,14 +753,22 @@ tx::transactions_cleanup::close()
         running_ = false;
         cv_.notify_all();
     }
-    if (cleanup_thr_.joinable()) {
-        cleanup_thr_.join();
-        attempt_cleanup_log->info("cleanup attempt thread closed");
+    atr_queue_.close();
+    for (auto& thr : cleanup_workers_) {
+        if (thr.joinable()) {
+            thr.join();
+        }
+    }
+    if (!cleanup_workers_.empty()) {
+        attempt_cleanup_log->info(
+          "{} cleanup attempt threads closed, peak queue length {}", cleanup_workers_.size(), atr_queue_.peak_size());
+        cleanup_workers_.clear();
     }
     if (lost_attempts_thr_.joinable()) {
         lost_attempts_thr_.join();
         lost_attempts_cleanup_log->info("{} lost attempts thread closed", static_cast<void*>(this));
     }
+    document_pool_->stop();
 }
 
 tx::transactions_cleanup::~transactions_cleanup()
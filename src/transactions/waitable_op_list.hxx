@@ -17,6 +17,7 @@
 #pragma once
 #include "couchbase/transactions/internal/logging.hxx"
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 
 namespace couchbase::transactions
@@ -72,6 +73,18 @@ class waitable_op_list
         // we have the lock.  Block all further ops
         allow_ops_ = false;
     }
+    // Non-blocking version of the above - the handler is called (and further ops blocked) as soon
+    // as the count drops to 0, which may be right now, on this thread.
+    void wait_and_block_ops(std::function<void()>&& handler)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (0 == count_) {
+            allow_ops_ = false;
+            lock.unlock();
+            return handler();
+        }
+        ops_done_handler_ = std::move(handler);
+    }
     attempt_mode get_mode()
     {
         std::unique_lock<std::mutex> lock(mutex_);
@@ -149,7 +162,7 @@ class waitable_op_list
   private:
     void change_count(int32_t val)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_lock<std::mutex> lock(mutex_);
         if (allow_ops_) {
             count_ += val;
             if (val > 0) {
@@ -158,12 +171,19 @@ class waitable_op_list
             txn_log->trace("op count changed by {} to {}, {} in_flight", val, count_, in_flight_);
             assert(count_ >= 0);
             assert(in_flight_ >= 0);
-            if (0 == count_) {
-                cv_ops_.notify_all();
-            }
             if (0 == in_flight_) {
                 cv_in_flight_.notify_all();
             }
+            if (0 == count_) {
+                cv_ops_.notify_all();
+                if (ops_done_handler_) {
+                    allow_ops_ = false;
+                    auto handler = std::move(ops_done_handler_);
+                    ops_done_handler_ = nullptr;
+                    lock.unlock();
+                    handler();
+                }
+            }
         } else {
             txn_log->error("operation attempted after commit/rollback");
             throw async_operation_conflict("Operation attempted after commit or rollback");
@@ -178,6 +198,7 @@ class waitable_op_list
     std::condition_variable cv_ops_;
     std::condition_variable cv_query_;
     std::condition_variable cv_in_flight_;
+    std::function<void()> ops_done_handler_;
     std::mutex mutex_;
 };
 }; // namespace couchbase::transactions
@@ -0,0 +1,283 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "xattr_decoder.hxx"
+
+#include <couchbase/internal/nlohmann/json.hpp>
+
+#include <limits>
+#include <optional>
+
+namespace couchbase::transactions
+{
+namespace
+{
+bool
+is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// The contents of a quoted string which needs no unescaping, if it is one.
+std::optional<std::string_view>
+plain_string(std::string_view json)
+{
+    if (json.size() < 2 || json.front() != '"' || json.back() != '"') {
+        return {};
+    }
+    auto contents = json.substr(1, json.size() - 2);
+    for (char c : contents) {
+        // an escape, or a control character nlohmann would reject
+        if (c == '\\' || c == '"' || static_cast<unsigned char>(c) < 0x20) {
+            return {};
+        }
+    }
+    return contents;
+}
+
+std::optional<uint32_t>
+plain_uint32(std::string_view json)
+{
+    if (json.empty() || json.size() > 10) {
+        return {};
+    }
+    uint64_t value = 0;
+    for (char c : json) {
+        if (c < '0' || c > '9') {
+            return {};
+        }
+        value = value * 10 + static_cast<uint64_t>(c - '0');
+    }
+    if (value > std::numeric_limits<uint32_t>::max()) {
+        return {};
+    }
+    return static_cast<uint32_t>(value);
+}
+
+/**
+ * Walks the members of a JSON object, handing the key and the raw text of each value to fn, until fn returns false.
+ * Only keys without escapes are understood, nested values are skipped over rather than looked at.  Returns false if
+ * the input isn't an object it can walk, in which case the caller should parse it properly.
+ */
+class object_reader
+{
+  public:
+    explicit object_reader(std::string_view json)
+      : json_(json)
+    {
+    }
+
+    template<typename Fn>
+    bool each(Fn&& fn)
+    {
+        skip_space();
+        if (!consume('{')) {
+            return false;
+        }
+        skip_space();
+        if (consume('}')) {
+            return at_end();
+        }
+        while (true) {
+            auto key_start = pos_;
+            if (!skip_string()) {
+                return false;
+            }
+            auto key = plain_string(json_.substr(key_start, pos_ - key_start));
+            if (!key) {
+                return false;
+            }
+            skip_space();
+            if (!consume(':')) {
+                return false;
+            }
+            skip_space();
+            auto value_start = pos_;
+            if (!skip_value()) {
+                return false;
+            }
+            if (!fn(*key, json_.substr(value_start, pos_ - value_start))) {
+                return true;
+            }
+            skip_space();
+            if (consume(',')) {
+                skip_space();
+                continue;
+            }
+            return consume('}') && at_end();
+        }
+    }
+
+  private:
+    std::string_view json_;
+    size_t pos_{ 0 };
+
+    void skip_space()
+    {
+        while (pos_ < json_.size() && is_space(json_[pos_])) {
+            ++pos_;
+        }
+    }
+
+    bool consume(char c)
+    {
+        if (pos_ < json_.size() && json_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool at_end()
+    {
+        skip_space();
+        return pos_ == json_.size();
+    }
+
+    bool skip_string()
+    {
+        if (!consume('"')) {
+            return false;
+        }
+        while (pos_ < json_.size()) {
+            char c = json_[pos_++];
+            if (c == '"') {
+                return true;
+            }
+            if (c == '\\') {
+                ++pos_;
+            }
+        }
+        return false;
+    }
+
+    bool skip_value()
+    {
+        if (pos_ >= json_.size()) {
+            return false;
+        }
+        switch (json_[pos_]) {
+            case '"':
+                return skip_string();
+            case '{':
+            case '[': {
+                size_t depth = 0;
+                while (pos_ < json_.size()) {
+                    char c = json_[pos_];
+                    if (c == '"') {
+                        if (!skip_string()) {
+                            return false;
+                        }
+                        continue;
+                    }
+                    ++pos_;
+                    if (c == '{' || c == '[') {
+                        ++depth;
+                    } else if ((c == '}' || c == ']') && --depth == 0) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            default: {
+                // a number, or true/false/null
+                auto start = pos_;
+                while (pos_ < json_.size() && !is_space(json_[pos_]) && json_[pos_] != ',' && json_[pos_] != '}' && json_[pos_] != ']') {
+                    ++pos_;
+                }
+                return pos_ > start;
+            }
+        }
+    }
+};
+} // namespace
+
+bool
+for_each_json_member(std::string_view json, const std::function<bool(std::string_view, std::string_view)>& fn)
+{
+    return object_reader(json).each(fn);
+}
+
+std::string
+decode_json_string(std::string_view json)
+{
+    if (auto contents = plain_string(json)) {
+        return std::string(*contents);
+    }
+    return nlohmann::json::parse(json).get<std::string>();
+}
+
+uint32_t
+decode_json_uint32(std::string_view json)
+{
+    if (auto value = plain_uint32(json)) {
+        return *value;
+    }
+    return nlohmann::json::parse(json).get<uint32_t>();
+}
+
+restore_fields
+decode_restore(std::string_view json)
+{
+    std::optional<std::string_view> cas;
+    std::optional<std::string_view> revid;
+    std::optional<uint32_t> exptime;
+    bool simple = object_reader(json).each([&](std::string_view key, std::string_view value) {
+        if (key == "CAS") {
+            cas = plain_string(value);
+        } else if (key == "revid") {
+            revid = plain_string(value);
+        } else if (key == "exptime") {
+            exptime = plain_uint32(value);
+        }
+        return true;
+    });
+    if (simple && cas && revid && exptime) {
+        return { std::string(*cas), std::string(*revid), *exptime };
+    }
+    auto restore = nlohmann::json::parse(json);
+    return { restore["CAS"].get<std::string>(), restore["revid"].get<std::string>(), restore["exptime"].get<uint32_t>() };
+}
+
+document_vattr
+decode_document_vattr(std::string_view json)
+{
+    std::optional<std::string_view> cas;
+    std::optional<std::string_view> revid;
+    std::optional<uint32_t> exptime;
+    std::optional<std::string_view> crc32;
+    bool simple = object_reader(json).each([&](std::string_view key, std::string_view value) {
+        if (key == "CAS") {
+            cas = plain_string(value);
+        } else if (key == "revid") {
+            revid = plain_string(value);
+        } else if (key == "exptime") {
+            exptime = plain_uint32(value);
+        } else if (key == "value_crc32c") {
+            crc32 = plain_string(value);
+        }
+        return true;
+    });
+    if (simple && cas && revid && exptime && crc32) {
+        return { std::string(*cas), std::string(*revid), *exptime, std::string(*crc32) };
+    }
+    auto doc = nlohmann::json::parse(json);
+    return { doc["CAS"].get<std::string>(),
+             doc["revid"].get<std::string>(),
+             doc["exptime"].get<uint32_t>(),
+             doc["value_crc32c"].get<std::string>() };
+}
+} // namespace couchbase::transactions
@@ -0,0 +1,69 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * Decoders for the values of the txn xattrs and $document virtual xattr returned when reading a document, see
+ * transaction_get_result::create_from.  The values we read there are short JSON strings and two small flat
+ * objects, so rather than building a JSON tree for each we pick out what we need directly.  Anything which isn't
+ * in the simple form the server returns (escapes, unexpected types, missing keys) goes through nlohmann instead,
+ * so the results, and the errors, are the same as parsing it would give.
+ *
+ * The member walk is also used to find entries in an ATR without parsing the others, see
+ * active_transaction_record.
+ */
+namespace couchbase::transactions
+{
+// Calls fn with the key and the raw text of the value of each member of a JSON object, until it returns false.
+// Returns false, having stopped early, if json isn't in the simple form this reads (it has escaped keys, say).
+bool
+for_each_json_member(std::string_view json, const std::function<bool(std::string_view, std::string_view)>& fn);
+
+// The contents of a JSON string, e.g. the value of txn.id.atr
+std::string
+decode_json_string(std::string_view json);
+
+// A JSON number which fits an uint32_t, e.g. an exptime
+uint32_t
+decode_json_uint32(std::string_view json);
+
+// txn.restore, written by the replace/remove of a document which already existed
+struct restore_fields {
+    std::string cas;
+    std::string revid;
+    uint32_t exptime{ 0 };
+};
+
+restore_fields
+decode_restore(std::string_view json);
+
+// The fields we use from the $document virtual xattr
+struct document_vattr {
+    std::string cas;
+    std::string revid;
+    uint32_t exptime{ 0 };
+    std::string value_crc32c;
+};
+
+document_vattr
+decode_document_vattr(std::string_view json);
+} // namespace couchbase::transactions
@@ -0,0 +1,97 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+
+#include "../transactions/transactions_env.h"
+#include <couchbase/transactions.hxx>
+#include <couchbase/transactions/async_operations.hxx>
+#include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+
+#include <asio/co_spawn.hpp>
+#include <asio/use_future.hpp>
+
+#ifndef ASIO_HAS_CO_AWAIT
+#error "coroutine_tests needs a compiler and asio with co_await support"
+#endif
+
+using namespace couchbase::transactions;
+
+static const nlohmann::json awaitable_content = { { "some", "thing" } };
+
+TEST(AwaitableTxns, GetReplace)
+{
+    auto txns = TransactionsTestEnvironment::get_transactions();
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, awaitable_content.dump()));
+    nlohmann::json new_content = { { "some", "thing else" } };
+    auto f = asio::co_spawn(
+      txns.io_context(),
+      [&txns, id, new_content]() -> asio::awaitable<transaction_result> {
+          co_return co_await async_run(
+            txns,
+            [id, new_content](async_attempt_context& ctx) -> asio::awaitable<void> {
+                auto doc = co_await async_get(ctx, id, asio::use_awaitable);
+                co_await async_replace(ctx, doc, new_content, asio::use_awaitable);
+            },
+            asio::use_awaitable);
+      },
+      asio::use_future);
+    auto result = f.get();
+    ASSERT_TRUE(result.unstaging_complete);
+    ASSERT_EQ(TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>(), new_content);
+}
+
+TEST(AwaitableTxns, LazyTokenOutlivesArguments)
+{
+    auto txns = TransactionsTestEnvironment::get_transactions();
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, awaitable_content.dump()));
+    auto f = asio::co_spawn(
+      txns.io_context(),
+      [&txns, id]() -> asio::awaitable<transaction_result> {
+          co_return co_await async_run(
+            txns,
+            [id](async_attempt_context& ctx) -> asio::awaitable<void> {
+                // the operation only starts when it is awaited, after the ids and content it was given have gone
+                auto get = [&ctx, id]() {
+                    std::vector<couchbase::core::document_id> ids{ id };
+                    return async_get_multi(ctx, ids, asio::use_awaitable);
+                }();
+                auto docs = co_await std::move(get);
+                EXPECT_EQ(1, docs.size());
+                auto replace = [&ctx, &docs]() {
+                    nlohmann::json content = { { "some", "other thing" } };
+                    return async_replace(ctx, docs.front(), content, asio::use_awaitable);
+                }();
+                co_await std::move(replace);
+            },
+            asio::use_awaitable);
+      },
+      asio::use_future);
+    ASSERT_TRUE(f.get().unstaging_complete);
+    nlohmann::json expected = { { "some", "other thing" } };
+    ASSERT_EQ(TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>(), expected);
+}
+
+int
+main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+    testing::AddGlobalTestEnvironment(new TransactionsTestEnvironment());
+    spdlog::set_level(spdlog::level::trace);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,86 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/active_transaction_record.hxx"
+
+#include <couchbase/internal/nlohmann/json.hpp>
+#include <gtest/gtest.h>
+
+using namespace couchbase::transactions;
+
+static const couchbase::core::document_id atr_id("default", "_default", "_default", "_txn:atr-1-#1");
+
+static nlohmann::json
+make_attempts(size_t count)
+{
+    auto attempts = nlohmann::json::object();
+    for (size_t i = 0; i < count; i++) {
+        auto& entry = attempts["attempt-" + std::to_string(i)];
+        entry["st"] = i % 2 ? "COMMITTED" : "PENDING";
+        entry["exp"] = 15000;
+        auto doc = nlohmann::json{ { "bkt", "default" }, { "scp", "_default" }, { "col", "_default" }, { "id", "doc-" + std::to_string(i) } };
+        entry["ins"] = nlohmann::json::array({ doc });
+    }
+    return attempts;
+}
+
+TEST(ActiveTransactionRecord, FindsOneEntry)
+{
+    auto atr = active_transaction_record::from_attempts(atr_id, make_attempts(100).dump(), 0);
+    ASSERT_EQ(100, atr.size());
+    auto entry = atr.find_entry("attempt-43");
+    ASSERT_TRUE(entry);
+    ASSERT_EQ("attempt-43", entry->attempt_id());
+    ASSERT_EQ(attempt_state::COMMITTED, entry->state());
+    ASSERT_EQ(15000, entry->expires_after_ms().value());
+    ASSERT_EQ(1, entry->inserted_ids()->size());
+    ASSERT_EQ("doc-43", entry->inserted_ids()->front().id());
+    ASSERT_FALSE(entry->replaced_ids());
+    ASSERT_FALSE(atr.find_entry("attempt-100"));
+}
+
+TEST(ActiveTransactionRecord, DecodesAllEntriesOnce)
+{
+    auto atr = active_transaction_record::from_attempts(atr_id, make_attempts(10).dump(), 0);
+    auto copy = atr;
+    const auto& entries = atr.entries();
+    ASSERT_EQ(10, entries.size());
+    // copies share the decoded entries
+    ASSERT_EQ(&entries, &copy.entries());
+    ASSERT_EQ(attempt_state::PENDING, entries[4].state());
+}
+
+TEST(ActiveTransactionRecord, FallsBackToParsing)
+{
+    // an escaped key can't be indexed, so everything is parsed up front
+    auto attempts = make_attempts(3);
+    attempts["attempt-\"quoted\""] = attempts["attempt-0"];
+    auto atr = active_transaction_record::from_attempts(atr_id, attempts.dump(), 0);
+    ASSERT_EQ(4, atr.size());
+    ASSERT_TRUE(atr.find_entry("attempt-\"quoted\""));
+    ASSERT_TRUE(atr.find_entry("attempt-2"));
+    ASSERT_THROW(active_transaction_record::from_attempts(atr_id, "{\"attempt\\\"", 0), nlohmann::json::exception);
+}
+
+TEST(ActiveTransactionRecord, CorruptEntryThrowsWhenRead)
+{
+    auto atr = active_transaction_record::from_attempts(atr_id, R"({"good":{"st":"PENDING"},"bad":{"exp":1}})", 0);
+    ASSERT_TRUE(atr.find_entry("good"));
+    ASSERT_THROW(atr.find_entry("bad"), std::exception);
+    // a failed decode isn't remembered, so this throws again rather than handing back a partial list
+    ASSERT_THROW(atr.entries(), std::exception);
+    ASSERT_THROW(atr.entries(), std::exception);
+}
@@ -0,0 +1,168 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/admission_control.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+using namespace couchbase::transactions;
+
+static const std::chrono::seconds budget{ 10 };
+
+TEST(AdmissionControl, UnlimitedAdmitsEverything)
+{
+    admission_control admission(0, 0);
+    size_t admitted = 0;
+    for (int i = 0; i < 100; i++) {
+        admission.admit(budget, [&]() { admitted++; }, [](bool) { FAIL() << "unexpected reject"; });
+    }
+    ASSERT_EQ(100, admitted);
+    ASSERT_EQ(100, admission.stats().running);
+}
+
+TEST(AdmissionControl, QueuesOverLimitAndAdmitsOnRelease)
+{
+    admission_control admission(2, 10);
+    size_t admitted = 0;
+    for (int i = 0; i < 3; i++) {
+        admission.admit(budget, [&]() { admitted++; }, [](bool) { FAIL() << "unexpected reject"; });
+    }
+    ASSERT_EQ(2, admitted);
+    ASSERT_EQ(1, admission.stats().queued);
+    admission.release(std::chrono::milliseconds(1));
+    ASSERT_EQ(3, admitted);
+    ASSERT_EQ(0, admission.stats().queued);
+    ASSERT_EQ(2, admission.stats().running);
+}
+
+TEST(AdmissionControl, RejectsWhenQueueFull)
+{
+    admission_control admission(1, 1);
+    std::optional<bool> rejected;
+    admission.admit(budget, []() {}, [](bool) {});
+    admission.admit(budget, []() {}, [](bool) {});
+    admission.admit(budget, []() { FAIL() << "unexpected admit"; }, [&](bool shed) { rejected = shed; });
+    ASSERT_TRUE(rejected);
+    ASSERT_FALSE(*rejected);
+    ASSERT_EQ(1, admission.stats().rejected);
+}
+
+TEST(AdmissionControl, RejectsWhenPredictedWaitTooLong)
+{
+    admission_control admission(1, 10);
+    admission.admit(budget, []() {}, [](bool) {});
+    // one transaction has taken 10s, so anything queued behind the next one can't start within 1s
+    admission.release(std::chrono::seconds(10));
+    admission.admit(budget, []() {}, [](bool) {});
+    std::optional<bool> rejected;
+    admission.admit(std::chrono::seconds(1), []() { FAIL() << "unexpected admit"; }, [&](bool shed) { rejected = shed; });
+    ASSERT_TRUE(rejected);
+    ASSERT_FALSE(*rejected);
+}
+
+TEST(AdmissionControl, ShedsExpiredWaiters)
+{
+    admission_control admission(1, 10);
+    admission.admit(budget, []() {}, [](bool) {});
+    std::optional<bool> rejected;
+    admission.admit(std::chrono::milliseconds(1), []() { FAIL() << "unexpected admit"; }, [&](bool shed) { rejected = shed; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    admission.release(std::chrono::milliseconds(10));
+    ASSERT_TRUE(rejected);
+    ASSERT_TRUE(*rejected);
+    ASSERT_EQ(1, admission.stats().shed);
+    ASSERT_EQ(0, admission.stats().running);
+}
+
+TEST(AdmissionControl, ShedsExpiredWaitersWithoutRelease)
+{
+    asio::io_context io;
+    admission_control admission(io, 1, 10);
+    admission.admit(budget, []() {}, [](bool) {});
+    std::optional<bool> rejected;
+    admission.admit(std::chrono::milliseconds(10), []() { FAIL() << "unexpected admit"; }, [&](bool shed) { rejected = shed; });
+    // nothing releases, the timer alone has to shed it
+    io.run_for(std::chrono::seconds(1));
+    ASSERT_TRUE(rejected);
+    ASSERT_TRUE(*rejected);
+    ASSERT_EQ(1, admission.stats().shed);
+    ASSERT_EQ(0, admission.stats().queued);
+    ASSERT_EQ(1, admission.stats().running);
+}
+
+TEST(AdmissionControl, AdmittedWaiterIsNotShedByTimer)
+{
+    asio::io_context io;
+    admission_control admission(io, 1, 10);
+    admission.admit(budget, []() {}, [](bool) {});
+    bool admitted = false;
+    admission.admit(std::chrono::milliseconds(10), [&]() { admitted = true; }, [](bool) { FAIL() << "unexpected reject"; });
+    admission.release(std::chrono::milliseconds(1));
+    ASSERT_TRUE(admitted);
+    io.run_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(0, admission.stats().shed);
+    ASSERT_EQ(1, admission.stats().running);
+}
+
+TEST(AdmissionControl, CloseShedsQueued)
+{
+    asio::io_context io;
+    admission_control admission(io, 1, 10);
+    admission.admit(budget, []() {}, [](bool) {});
+    size_t shed = 0;
+    for (int i = 0; i < 3; i++) {
+        admission.admit(budget, []() { FAIL() << "unexpected admit"; }, [&](bool s) { shed += s ? 1 : 0; });
+    }
+    admission.close();
+    ASSERT_EQ(3, shed);
+    ASSERT_EQ(0, admission.stats().queued);
+    // the timers were cancelled, so this returns straight away rather than after the budget
+    auto start = std::chrono::steady_clock::now();
+    io.run();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, budget);
+}
+
+TEST(AdmissionControl, RejectsAfterClose)
+{
+    admission_control admission(0, 0);
+    admission.close();
+    std::optional<bool> rejected;
+    admission.admit(budget, []() { FAIL() << "unexpected admit"; }, [&](bool shed) { rejected = shed; });
+    ASSERT_TRUE(rejected);
+    ASSERT_FALSE(*rejected);
+    ASSERT_EQ(1, admission.stats().rejected);
+}
+
+TEST(AdmissionControl, WaitIdleWaitsForRunningTransactions)
+{
+    admission_control admission(0, 0);
+    admission.admit(budget, []() {}, [](bool) {});
+    admission.admit(budget, []() {}, [](bool) {});
+    std::atomic<bool> idle{ false };
+    std::thread waiter([&]() {
+        admission.wait_idle();
+        idle = true;
+    });
+    admission.release(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_FALSE(idle.load());
+    admission.release(std::chrono::milliseconds(1));
+    waiter.join();
+    ASSERT_TRUE(idle.load());
+}
@@ -0,0 +1,234 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "transactions_env.h"
+#include <couchbase/transactions.hxx>
+#include <couchbase/transactions/internal/atr_cleanup_entry.hxx>
+#include <couchbase/transactions/internal/transactions_cleanup.hxx>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace couchbase::transactions;
+
+// the queue never touches the cleanup an entry refers to, but the entries need one
+static transactions&
+queue_test_transactions()
+{
+    static transactions txns = []() {
+        transaction_config cfg;
+        cfg.cleanup_client_attempts(false);
+        cfg.cleanup_lost_attempts(false);
+        return transactions(TransactionsTestEnvironment::get_cluster(), cfg);
+    }();
+    return txns;
+}
+
+static atr_cleanup_entry
+make_entry(const std::string& attempt_id)
+{
+    static const auto atr_id = TransactionsTestEnvironment::get_document_id();
+    return atr_cleanup_entry(atr_id, attempt_id, queue_test_transactions().cleanup());
+}
+
+TEST(AtrCleanupQueue, CountsSizeAndPeak)
+{
+    atr_cleanup_queue queue;
+    for (size_t i = 0; i < 5; i++) {
+        queue.push(make_entry("attempt-" + std::to_string(i)));
+    }
+    ASSERT_EQ(5, queue.size());
+    ASSERT_EQ(5, queue.peak_size());
+    ASSERT_TRUE(queue.pop());
+    ASSERT_TRUE(queue.pop());
+    ASSERT_EQ(3, queue.size());
+    ASSERT_EQ(5, queue.peak_size());
+    queue.push(make_entry("attempt-5"));
+    ASSERT_EQ(4, queue.size());
+    ASSERT_EQ(5, queue.peak_size());
+}
+
+TEST(AtrCleanupQueue, OnlyPopsReadyEntries)
+{
+    atr_cleanup_queue queue;
+    auto entry = make_entry("attempt-0");
+    entry.min_start_time(std::chrono::steady_clock::now() + std::chrono::minutes(1));
+    queue.push(entry);
+    ASSERT_FALSE(queue.pop());
+    ASSERT_EQ(1, queue.size());
+    auto popped = queue.pop(false);
+    ASSERT_TRUE(popped);
+    ASSERT_EQ("attempt-0", popped->attempt_id());
+    ASSERT_EQ(0, queue.size());
+}
+
+TEST(AtrCleanupQueue, PopsOldestFirstWithinAShard)
+{
+    atr_cleanup_queue queue;
+    auto now = std::chrono::steady_clock::now();
+    // pushes go round the shards in turn, so every eighth one lands on the same shard
+    std::vector<std::string> expected;
+    for (size_t i = 0; i < 16; i++) {
+        auto entry = make_entry("attempt-" + std::to_string(i));
+        entry.min_start_time(now - std::chrono::seconds(i < 8 ? 1 : 2));
+        queue.push(entry);
+    }
+    // the second round is older, so each shard gives that entry up first
+    std::set<std::string> first;
+    for (size_t i = 0; i < 8; i++) {
+        auto popped = queue.pop();
+        ASSERT_TRUE(popped);
+        first.insert(popped->attempt_id());
+    }
+    for (size_t i = 8; i < 16; i++) {
+        ASSERT_EQ(1, first.count("attempt-" + std::to_string(i)));
+    }
+}
+
+TEST(AtrCleanupQueue, ConcurrentWorkersPopEveryEntryOnce)
+{
+    atr_cleanup_queue queue;
+    const size_t per_thread = 100;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < per_thread; i++) {
+                queue.push(make_entry("attempt-" + std::to_string(t) + "-" + std::to_string(i)));
+            }
+        });
+    }
+    std::mutex mutex;
+    std::multiset<std::string> popped;
+    std::atomic<size_t> count{ 0 };
+    for (size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&]() {
+            while (count.load() < 4 * per_thread) {
+                if (auto entry = queue.pop()) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    popped.insert(entry->attempt_id());
+                    count++;
+                }
+            }
+        });
+    }
+    for (auto& thr : threads) {
+        thr.join();
+    }
+    ASSERT_EQ(4 * per_thread, popped.size());
+    for (const auto& id : popped) {
+        ASSERT_EQ(1, popped.count(id));
+    }
+    ASSERT_EQ(0, queue.size());
+    ASSERT_LE(queue.peak_size(), 4 * per_thread);
+}
+
+// Workers that each take one entry, then stay busy until released, like a worker in the middle of a cleanup.
+struct busy_workers {
+    explicit busy_workers(atr_cleanup_queue& queue, size_t count)
+    {
+        for (size_t i = 0; i < count; i++) {
+            threads.emplace_back([this, &queue]() {
+                if (!queue.pop_when_ready()) {
+                    return;
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                popped++;
+                cv.notify_all();
+                cv.wait(lock, [this]() { return released; });
+            });
+        }
+    }
+
+    bool wait_for_popped(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return cv.wait_for(lock, std::chrono::seconds(5), [&]() { return popped >= count; });
+    }
+
+    void release(atr_cleanup_queue& queue)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released = true;
+            cv.notify_all();
+        }
+        queue.close();
+        for (auto& thr : threads) {
+            thr.join();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t popped{ 0 };
+    bool released{ false };
+    std::vector<std::thread> threads;
+};
+
+TEST(AtrCleanupQueue, PopWhenReadyWaitsUntilEntryIsDue)
+{
+    atr_cleanup_queue queue;
+    auto entry = make_entry("attempt-0");
+    auto due = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    entry.min_start_time(due);
+    queue.push(entry);
+    auto popped = queue.pop_when_ready();
+    ASSERT_TRUE(popped);
+    ASSERT_GE(std::chrono::steady_clock::now(), due);
+}
+
+TEST(AtrCleanupQueue, CloseWakesWaiters)
+{
+    atr_cleanup_queue queue;
+    busy_workers workers(queue, 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // returns once they have all seen the queue close
+    workers.release(queue);
+    ASSERT_EQ(0, workers.popped);
+}
+
+TEST(AtrCleanupQueue, IdleWorkerTakesEntryWhileAnotherIsBusy)
+{
+    atr_cleanup_queue queue;
+    busy_workers workers(queue, 3);
+    // give them time to go to sleep on the empty queue
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (size_t i = 0; i < 3; i++) {
+        queue.push(make_entry("attempt-" + std::to_string(i)));
+        // each entry is taken by an idle worker, even though those taken before are still being worked on
+        ASSERT_TRUE(workers.wait_for_popped(i + 1));
+    }
+    workers.release(queue);
+    ASSERT_EQ(0, queue.size());
+}
+
+TEST(AtrCleanupQueue, EntriesPushedTogetherAreSpreadOverWorkers)
+{
+    atr_cleanup_queue queue;
+    busy_workers workers(queue, 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (size_t i = 0; i < 4; i++) {
+        queue.push(make_entry("attempt-" + std::to_string(i)));
+    }
+    ASSERT_TRUE(workers.wait_for_popped(4));
+    workers.release(queue);
+}
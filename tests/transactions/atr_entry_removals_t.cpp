@@ -0,0 +1,233 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/active_transaction_record.hxx"
+#include "../../src/transactions/cleanup_testing_hooks.hxx"
+#include "transactions_env.h"
+#include <couchbase/internal/nlohmann/json.hpp>
+#include <couchbase/transactions/internal/atr_cleanup_entry.hxx>
+#include <couchbase/transactions/internal/exceptions_internal.hxx>
+#include <couchbase/transactions/internal/transactions_cleanup.hxx>
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace couchbase::transactions;
+
+static const couchbase::core::document_id atr_id("default", "_default", "_default", "_txn:atr-1-#1");
+
+// Records the batches it is asked to send, failing any that fail_batch says should fail.
+struct recording_executor {
+    std::vector<std::vector<atr_entry_removals::removal>> batches;
+    std::function<void(const std::vector<atr_entry_removals::removal>&)> fail_batch = [](const auto&) {};
+
+    atr_entry_removals::executor executor()
+    {
+        return [this](const couchbase::core::document_id&, const std::vector<atr_entry_removals::removal>& batch) {
+            batches.push_back(batch);
+            fail_batch(batch);
+        };
+    }
+};
+
+class AtrEntryRemovals : public ::testing::Test
+{
+  protected:
+    AtrEntryRemovals()
+    {
+        cfg_.cleanup_client_attempts(false);
+        cfg_.cleanup_lost_attempts(false);
+        cleanup_ = std::make_unique<transactions_cleanup>(TransactionsTestEnvironment::get_cluster(), cfg_);
+        cfg_.cleanup_hooks().on_cleanup_completed = [this]() -> std::optional<error_class> {
+            completed_++;
+            return {};
+        };
+    }
+
+    // entries named attempt-<i>, PENDING when pending(i)
+    void add_entries(atr_entry_removals& removals, size_t count, const std::function<bool(size_t)>& pending, durability_level dl)
+    {
+        auto attempts = nlohmann::json::object();
+        for (size_t i = 0; i < count; i++) {
+            attempts[std::string("attempt-") + std::to_string(next_++)]["st"] = pending(i) ? "PENDING" : "COMMITTED";
+        }
+        atrs_.push_back(active_transaction_record::from_attempts(atr_id, attempts.dump(), 0));
+        for (const auto& entry : atrs_.back().entries()) {
+            removals.add(entry, dl);
+        }
+    }
+
+    static bool never(size_t)
+    {
+        return false;
+    }
+
+    transaction_config cfg_;
+    std::unique_ptr<transactions_cleanup> cleanup_;
+    std::vector<active_transaction_record> atrs_;
+    size_t next_{ 0 };
+    size_t completed_{ 0 };
+};
+
+static size_t
+spec_count(const std::vector<atr_entry_removals::removal>& batch)
+{
+    size_t specs = 0;
+    for (const auto& r : batch) {
+        specs += r.pending ? 2 : 1;
+    }
+    return specs;
+}
+
+TEST_F(AtrEntryRemovals, GroupsByDurability)
+{
+    recording_executor exec;
+    atr_entry_removals removals(atr_id, *cleanup_, exec.executor());
+    add_entries(removals, 2, never, durability_level::MAJORITY);
+    add_entries(removals, 3, never, durability_level::NONE);
+    add_entries(removals, 1, never, durability_level::MAJORITY);
+    removals.remove(spdlog::default_logger());
+    ASSERT_EQ(2, exec.batches.size());
+    std::set<size_t> sizes;
+    for (const auto& batch : exec.batches) {
+        for (const auto& r : batch) {
+            ASSERT_EQ(batch.front().dl, r.dl);
+        }
+        sizes.insert(batch.size());
+    }
+    ASSERT_EQ(std::set<size_t>({ 3 }), sizes);
+    ASSERT_EQ(6, completed_);
+}
+
+TEST_F(AtrEntryRemovals, SplitsAtSixteenSpecs)
+{
+    recording_executor exec;
+    atr_entry_removals removals(atr_id, *cleanup_, exec.executor());
+    add_entries(removals, 20, never, durability_level::MAJORITY);
+    removals.remove(spdlog::default_logger());
+    ASSERT_EQ(2, exec.batches.size());
+    ASSERT_EQ(16, exec.batches[0].size());
+    ASSERT_EQ(4, exec.batches[1].size());
+    ASSERT_EQ(20, completed_);
+}
+
+TEST_F(AtrEntryRemovals, PendingEntriesCountAsTwoSpecs)
+{
+    recording_executor exec;
+    atr_entry_removals removals(atr_id, *cleanup_, exec.executor());
+    // alternately pending, so 3 specs per pair
+    add_entries(removals, 12, [](size_t i) { return i % 2 == 0; }, durability_level::MAJORITY);
+    removals.remove(spdlog::default_logger());
+    size_t total = 0;
+    for (const auto& batch : exec.batches) {
+        ASSERT_LE(spec_count(batch), 16);
+        total += batch.size();
+    }
+    ASSERT_EQ(12, total);
+    ASSERT_EQ(2, exec.batches.size());
+    ASSERT_EQ(18, spec_count(exec.batches[0]) + spec_count(exec.batches[1]));
+}
+
+TEST_F(AtrEntryRemovals, FallsBackToOneAtATimeAndCarriesOnAfterAFailure)
+{
+    recording_executor exec;
+    exec.fail_batch = [](const std::vector<atr_entry_removals::removal>& batch) {
+        if (batch.size() > 1) {
+            throw client_error(FAIL_PATH_NOT_FOUND, "one of them is already gone");
+        }
+        if (batch.front().attempt_id == "attempt-1") {
+            // colliding with its attempt: fails just this one
+            throw client_error(FAIL_PATH_ALREADY_EXISTS, "p already exists");
+        }
+        if (batch.front().attempt_id == "attempt-2") {
+            // already gone, which is fine
+            throw client_error(FAIL_PATH_NOT_FOUND, "already gone");
+        }
+    };
+    atr_entry_removals removals(atr_id, *cleanup_, exec.executor());
+    add_entries(removals, 5, never, durability_level::MAJORITY);
+    try {
+        removals.remove(spdlog::default_logger());
+        FAIL() << "expected the PATH_EXISTS to be rethrown";
+    } catch (const client_error& e) {
+        ASSERT_EQ(FAIL_PATH_ALREADY_EXISTS, e.ec());
+    }
+    // the batch, then each of the five, including those after the failure
+    ASSERT_EQ(6, exec.batches.size());
+    ASSERT_EQ("attempt-4", exec.batches.back().front().attempt_id);
+    ASSERT_EQ(4, completed_);
+}
+
+TEST_F(AtrEntryRemovals, OtherBatchErrorFailsOnlyThatBatch)
+{
+    recording_executor exec;
+    exec.fail_batch = [](const std::vector<atr_entry_removals::removal>& batch) {
+        if (batch.front().dl == durability_level::NONE) {
+            throw client_error(FAIL_TRANSIENT, "try again");
+        }
+    };
+    atr_entry_removals removals(atr_id, *cleanup_, exec.executor());
+    add_entries(removals, 3, never, durability_level::NONE);
+    add_entries(removals, 3, never, durability_level::MAJORITY);
+    ASSERT_THROW(removals.remove(spdlog::default_logger()), client_error);
+    ASSERT_EQ(2, exec.batches.size());
+    ASSERT_EQ(3, completed_);
+}
+
+TEST_F(AtrEntryRemovals, BeforeRemoveHookFailureLeavesOutOnlyThatEntry)
+{
+    size_t calls = 0;
+    cfg_.cleanup_hooks().before_atr_remove = [&calls]() -> std::optional<error_class> {
+        if (calls++ == 1) {
+            return FAIL_HARD;
+        }
+        return {};
+    };
+    recording_executor exec;
+    atr_entry_removals removals(atr_id, *cleanup_, exec.executor());
+    add_entries(removals, 5, never, durability_level::MAJORITY);
+    try {
+        removals.remove(spdlog::default_logger());
+        FAIL() << "expected the hook error to be rethrown";
+    } catch (const client_error& e) {
+        ASSERT_EQ(FAIL_HARD, e.ec());
+    }
+    ASSERT_EQ(5, calls);
+    ASSERT_EQ(1, exec.batches.size());
+    ASSERT_EQ(4, exec.batches[0].size());
+    for (const auto& r : exec.batches[0]) {
+        ASSERT_NE("attempt-1", r.attempt_id);
+    }
+    ASSERT_EQ(4, completed_);
+}
+
+TEST_F(AtrEntryRemovals, CompletedHookFailureDoesNotStopTheOthers)
+{
+    cfg_.cleanup_hooks().on_cleanup_completed = [this]() -> std::optional<error_class> {
+        if (completed_++ == 0) {
+            return FAIL_HARD;
+        }
+        return {};
+    };
+    recording_executor exec;
+    atr_entry_removals removals(atr_id, *cleanup_, exec.executor());
+    add_entries(removals, 3, never, durability_level::MAJORITY);
+    ASSERT_THROW(removals.remove(spdlog::default_logger()), client_error);
+    ASSERT_EQ(1, exec.batches.size());
+    ASSERT_EQ(3, completed_);
+}
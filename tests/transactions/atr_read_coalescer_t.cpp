@@ -0,0 +1,164 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/atr_read_coalescer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace couchbase::transactions;
+
+namespace
+{
+struct fake_fetch {
+    std::vector<std::pair<couchbase::core::document_id, atr_read_coalescer::FetchCallback>> pending;
+
+    atr_read_coalescer::Fetch fn()
+    {
+        return [this](const couchbase::core::document_id& id, atr_read_coalescer::FetchCallback&& cb) {
+            pending.emplace_back(id, std::move(cb));
+        };
+    }
+
+    void complete(size_t index)
+    {
+        auto& [id, cb] = pending[index];
+        cb({}, active_transaction_record(id, 0, {}));
+    }
+};
+} // namespace
+
+TEST(AtrReadCoalescer, SharesReadInFlight)
+{
+    fake_fetch fetch;
+    atr_read_coalescer reads(fetch.fn());
+    couchbase::core::document_id atr_id("default", "_default", "_default", "_txn:atr-1-#1");
+    std::vector<atr_read_coalescer::atr_ptr> results;
+    for (int i = 0; i < 3; i++) {
+        reads.get(atr_id, [&](std::error_code ec, atr_read_coalescer::atr_ptr atr) {
+            ASSERT_FALSE(ec);
+            results.push_back(atr);
+        });
+    }
+    ASSERT_EQ(1, fetch.pending.size());
+    fetch.complete(0);
+    ASSERT_EQ(3, results.size());
+    ASSERT_TRUE(results[0]);
+    // one parse, shared by all of them
+    ASSERT_EQ(results[0], results[1]);
+    ASSERT_EQ(results[0], results[2]);
+    ASSERT_EQ(3, reads.stats().reads);
+    ASSERT_EQ(2, reads.stats().coalesced);
+}
+
+TEST(AtrReadCoalescer, DifferentAtrsReadSeparately)
+{
+    fake_fetch fetch;
+    atr_read_coalescer reads(fetch.fn());
+    reads.get({ "default", "_default", "_default", "_txn:atr-1-#1" }, [](std::error_code, atr_read_coalescer::atr_ptr) {});
+    reads.get({ "default", "_default", "_default", "_txn:atr-2-#2" }, [](std::error_code, atr_read_coalescer::atr_ptr) {});
+    ASSERT_EQ(2, fetch.pending.size());
+    ASSERT_EQ(0, reads.stats().coalesced);
+}
+
+TEST(AtrReadCoalescer, DoesNotCacheCompletedReads)
+{
+    fake_fetch fetch;
+    atr_read_coalescer reads(fetch.fn());
+    couchbase::core::document_id atr_id("default", "_default", "_default", "_txn:atr-1-#1");
+    reads.get(atr_id, [](std::error_code, atr_read_coalescer::atr_ptr) {});
+    fetch.complete(0);
+    reads.get(atr_id, [](std::error_code, atr_read_coalescer::atr_ptr) {});
+    ASSERT_EQ(2, fetch.pending.size());
+    ASSERT_DOUBLE_EQ(0.0, reads.stats().hit_rate());
+}
+
+namespace
+{
+struct fake_entry_fetch {
+    std::vector<std::pair<std::string, atr_read_coalescer::EntryCallback>> pending;
+
+    atr_read_coalescer::EntryFetch fn()
+    {
+        return [this](const couchbase::core::document_id&, const std::string& attempt_id, atr_read_coalescer::EntryCallback&& cb) {
+            pending.emplace_back(attempt_id, std::move(cb));
+        };
+    }
+};
+
+active_transaction_record
+atr_with_entry(const couchbase::core::document_id& id, const std::string& attempt_id)
+{
+    return active_transaction_record::from_attempts(id, "{\"" + attempt_id + "\":{\"st\":\"PENDING\"}}", 0);
+}
+} // namespace
+
+TEST(AtrReadCoalescer, ReadsSingleEntries)
+{
+    fake_fetch fetch;
+    fake_entry_fetch fetch_entry;
+    atr_read_coalescer reads(fetch.fn(), fetch_entry.fn());
+    couchbase::core::document_id atr_id("default", "_default", "_default", "_txn:atr-1-#1");
+    std::vector<std::optional<atr_entry>> results;
+    auto cb = [&](std::error_code ec, std::optional<atr_entry> entry) {
+        ASSERT_FALSE(ec);
+        results.push_back(entry);
+    };
+    reads.get_entry(atr_id, "a", cb);
+    reads.get_entry(atr_id, "a", cb);
+    reads.get_entry(atr_id, "b", cb);
+    // one lookup per entry, and none of the whole atr
+    ASSERT_EQ(0, fetch.pending.size());
+    ASSERT_EQ(2, fetch_entry.pending.size());
+    ASSERT_EQ(1, reads.stats().coalesced);
+    fetch_entry.pending[0].second({}, atr_with_entry(atr_id, "a").find_entry("a"));
+    fetch_entry.pending[1].second({}, std::nullopt);
+    ASSERT_EQ(3, results.size());
+    ASSERT_EQ("a", results[0]->attempt_id());
+    ASSERT_EQ("a", results[1]->attempt_id());
+    ASSERT_FALSE(results[2]);
+}
+
+TEST(AtrReadCoalescer, EntryReadsJoinWholeAtrRead)
+{
+    fake_fetch fetch;
+    fake_entry_fetch fetch_entry;
+    atr_read_coalescer reads(fetch.fn(), fetch_entry.fn());
+    couchbase::core::document_id atr_id("default", "_default", "_default", "_txn:atr-1-#1");
+    std::optional<atr_entry> result;
+    reads.get(atr_id, [](std::error_code, atr_read_coalescer::atr_ptr) {});
+    reads.get_entry(atr_id, "a", [&](std::error_code, std::optional<atr_entry> entry) { result = entry; });
+    ASSERT_EQ(1, fetch.pending.size());
+    ASSERT_EQ(0, fetch_entry.pending.size());
+    auto& [id, cb] = fetch.pending[0];
+    cb({}, atr_with_entry(id, "a"));
+    ASSERT_TRUE(result);
+    ASSERT_EQ(attempt_state::PENDING, result->state());
+}
+
+TEST(AtrReadCoalescer, EntriesFromWholeAtrWithoutEntryFetch)
+{
+    fake_fetch fetch;
+    atr_read_coalescer reads(fetch.fn());
+    couchbase::core::document_id atr_id("default", "_default", "_default", "_txn:atr-1-#1");
+    std::optional<atr_entry> result;
+    reads.get_entry(atr_id, "a", [&](std::error_code, std::optional<atr_entry> entry) { result = entry; });
+    ASSERT_EQ(1, fetch.pending.size());
+    auto& [id, cb] = fetch.pending[0];
+    cb({}, atr_with_entry(id, "a"));
+    ASSERT_TRUE(result);
+}
@@ -0,0 +1,109 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/cleanup_pool.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+using namespace couchbase::transactions;
+
+TEST(CleanupPool, RunsEveryIndexOnce)
+{
+    cleanup_pool pool(3);
+    std::mutex mutex;
+    std::multiset<size_t> seen;
+    pool.for_each(100, [&](size_t i) {
+        std::lock_guard<std::mutex> lock(mutex);
+        seen.insert(i);
+    });
+    ASSERT_EQ(100, seen.size());
+    for (size_t i = 0; i < 100; i++) {
+        ASSERT_EQ(1, seen.count(i));
+    }
+}
+
+TEST(CleanupPool, BoundsConcurrency)
+{
+    cleanup_pool pool(3);
+    std::atomic<size_t> running{ 0 };
+    std::atomic<size_t> peak{ 0 };
+    pool.for_each(20, [&](size_t) {
+        auto now = ++running;
+        auto prev = peak.load();
+        while (now > prev && !peak.compare_exchange_weak(prev, now)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        --running;
+    });
+    // the pool's three threads and the caller
+    ASSERT_LE(peak.load(), 4);
+    ASSERT_GT(peak.load(), 1);
+}
+
+TEST(CleanupPool, RethrowsFirstErrorAndStopsStartingWork)
+{
+    cleanup_pool pool(3);
+    std::atomic<size_t> calls{ 0 };
+    ASSERT_THROW(pool.for_each(1000,
+                               [&](size_t i) {
+                                   ++calls;
+                                   if (i == 0) {
+                                       throw std::runtime_error("doc failed");
+                                   }
+                                   std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                               }),
+                 std::runtime_error);
+    ASSERT_LT(calls.load(), 1000);
+    // and the pool is still usable afterwards
+    std::atomic<size_t> after{ 0 };
+    pool.for_each(10, [&](size_t) { ++after; });
+    ASSERT_EQ(10, after.load());
+}
+
+TEST(CleanupPool, SharedByConcurrentCallers)
+{
+    cleanup_pool pool(2);
+    std::atomic<size_t> calls{ 0 };
+    std::vector<std::thread> callers;
+    for (int c = 0; c < 4; c++) {
+        callers.emplace_back([&]() {
+            pool.for_each(50, [&](size_t) {
+                ++calls;
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            });
+        });
+    }
+    for (auto& thr : callers) {
+        thr.join();
+    }
+    ASSERT_EQ(200, calls.load());
+}
+
+TEST(CleanupPool, RunsOnCallerAfterStop)
+{
+    cleanup_pool pool(3);
+    pool.stop();
+    std::set<std::thread::id> threads;
+    pool.for_each(10, [&](size_t) { threads.insert(std::this_thread::get_id()); });
+    ASSERT_EQ(1, threads.size());
+    ASSERT_EQ(std::this_thread::get_id(), *threads.begin());
+}
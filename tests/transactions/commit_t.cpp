@@ -0,0 +1,189 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/attempt_context_testing_hooks.hxx"
+#include "transactions_env.h"
+#include <couchbase/transactions.hxx>
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+using namespace couchbase::transactions;
+
+static const nlohmann::json initial = nlohmann::json::parse(R"({"some number": 0})");
+static const nlohmann::json updated = nlohmann::json::parse(R"({"some number": 100})");
+
+static transaction_config
+commit_test_config()
+{
+    transaction_config cfg;
+    cfg.cleanup_client_attempts(false);
+    cfg.cleanup_lost_attempts(false);
+    return cfg;
+}
+
+// fails the first n calls with ec
+static std::function<std::optional<error_class>(attempt_context*)>
+fail_first(std::atomic<int>& calls, int n, error_class ec)
+{
+    return [&calls, n, ec](attempt_context*) -> std::optional<error_class> {
+        if (calls++ < n) {
+            return ec;
+        }
+        return {};
+    };
+}
+
+static void
+replace_doc(couchbase::transactions::transactions& txn, const couchbase::core::document_id& id)
+{
+    txn.run([&](attempt_context& ctx) {
+        auto doc = ctx.get(id);
+        ctx.replace(doc, updated);
+    });
+}
+
+TEST(CommitTransactions, AmbiguousAtrCommitResolvesToCommitted)
+{
+    auto cfg = commit_test_config();
+    std::atomic<int> after_commit{ 0 };
+    std::atomic<int> resolutions{ 0 };
+    // the ATR write lands, but we are told it may not have
+    cfg.attempt_context_hooks().after_atr_commit = fail_first(after_commit, 1, FAIL_AMBIGUOUS);
+    cfg.attempt_context_hooks().before_atr_commit_ambiguity_resolution = fail_first(resolutions, 0, FAIL_OTHER);
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, initial.dump()));
+    ASSERT_NO_THROW(replace_doc(txn, id));
+    // the retried write finds the commit already there, and looks it up
+    ASSERT_EQ(1, resolutions.load());
+    ASSERT_EQ(updated, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
+}
+
+TEST(CommitTransactions, AmbiguityResolutionRetriesAfterTransientErrors)
+{
+    auto cfg = commit_test_config();
+    std::atomic<int> after_commit{ 0 };
+    std::atomic<int> resolutions{ 0 };
+    cfg.attempt_context_hooks().after_atr_commit = fail_first(after_commit, 1, FAIL_AMBIGUOUS);
+    cfg.attempt_context_hooks().before_atr_commit_ambiguity_resolution = fail_first(resolutions, 2, FAIL_TRANSIENT);
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, initial.dump()));
+    ASSERT_NO_THROW(replace_doc(txn, id));
+    ASSERT_EQ(3, resolutions.load());
+    ASSERT_EQ(updated, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
+}
+
+TEST(CommitTransactions, AmbiguityResolutionFindingNoEntryIsAmbiguous)
+{
+    auto cfg = commit_test_config();
+    std::atomic<int> after_commit{ 0 };
+    std::atomic<int> resolutions{ 0 };
+    cfg.attempt_context_hooks().after_atr_commit = fail_first(after_commit, 1, FAIL_AMBIGUOUS);
+    cfg.attempt_context_hooks().before_atr_commit_ambiguity_resolution = fail_first(resolutions, 1, FAIL_PATH_NOT_FOUND);
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, initial.dump()));
+    try {
+        replace_doc(txn, id);
+        FAIL() << "expected the commit to be ambiguous";
+    } catch (const transaction_exception& e) {
+        ASSERT_EQ(failure_type::COMMIT_AMBIGUOUS, e.type());
+        ASSERT_EQ(ACTIVE_TRANSACTION_RECORD_ENTRY_NOT_FOUND, e.cause());
+    }
+    ASSERT_EQ(1, resolutions.load());
+}
+
+TEST(CommitTransactions, TransientErrorWhileResolvingAtrCommitIsRetried)
+{
+    auto cfg = commit_test_config();
+    std::atomic<int> before_commit{ 0 };
+    std::atomic<int> after_commit{ 0 };
+    // the first write is ambiguous, and the one that follows up on it fails, so it is retried again
+    cfg.attempt_context_hooks().before_atr_commit = [&before_commit](attempt_context*) -> std::optional<error_class> {
+        if (before_commit++ == 1) {
+            return FAIL_TRANSIENT;
+        }
+        return {};
+    };
+    cfg.attempt_context_hooks().after_atr_commit = fail_first(after_commit, 1, FAIL_AMBIGUOUS);
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, initial.dump()));
+    ASSERT_NO_THROW(replace_doc(txn, id));
+    ASSERT_EQ(3, before_commit.load());
+    ASSERT_EQ(updated, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
+}
+
+TEST(CommitTransactions, AmbiguousDocCommitIsRetried)
+{
+    auto cfg = commit_test_config();
+    std::atomic<int> commits{ 0 };
+    cfg.attempt_context_hooks().before_doc_committed = [&commits](attempt_context*, const std::string&) -> std::optional<error_class> {
+        if (commits++ == 0) {
+            return FAIL_AMBIGUOUS;
+        }
+        return {};
+    };
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, initial.dump()));
+    ASSERT_NO_THROW(replace_doc(txn, id));
+    ASSERT_EQ(2, commits.load());
+    ASSERT_EQ(updated, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
+}
+
+TEST(CommitTransactions, AmbiguousDocRemoveIsRetried)
+{
+    auto cfg = commit_test_config();
+    std::atomic<int> removes{ 0 };
+    cfg.attempt_context_hooks().before_doc_removed = [&removes](attempt_context*, const std::string&) -> std::optional<error_class> {
+        if (removes++ == 0) {
+            return FAIL_AMBIGUOUS;
+        }
+        return {};
+    };
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, initial.dump()));
+    ASSERT_NO_THROW(txn.run([&](attempt_context& ctx) {
+        auto doc = ctx.get(id);
+        ctx.remove(doc);
+    }));
+    ASSERT_EQ(2, removes.load());
+    ASSERT_THROW(TransactionsTestEnvironment::get_doc(id), client_error);
+}
+
+TEST(CommitTransactions, AtrCompleteErrorDoesNotFailTheTransaction)
+{
+    auto cfg = commit_test_config();
+    std::atomic<int> completes{ 0 };
+    cfg.attempt_context_hooks().before_atr_complete = fail_first(completes, 1, FAIL_OTHER);
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, initial.dump()));
+    ASSERT_NO_THROW(replace_doc(txn, id));
+    ASSERT_EQ(1, completes.load());
+    ASSERT_EQ(updated, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
+}
@@ -0,0 +1,55 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/forward_compat.hxx"
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+using namespace couchbase::transactions;
+
+TEST(ForwardCompat, ContinuesWhenExtensionIsSupported)
+{
+    auto err = forward_compat::check(forward_compat_stage::GETS, nlohmann::json::parse(R"({"G":[{"e":"TI","b":"f"}]})"));
+    ASSERT_FALSE(err);
+}
+
+TEST(ForwardCompat, FailsFastForUnknownExtension)
+{
+    auto err = forward_compat::check(forward_compat_stage::GETS, nlohmann::json::parse(R"({"G":[{"e":"XX","b":"f"}]})"));
+    ASSERT_TRUE(err);
+    ASSERT_FALSE(err->should_retry());
+    ASSERT_EQ(FORWARD_COMPATIBILITY_FAILURE, err->cause());
+}
+
+TEST(ForwardCompat, RetryWithoutDelay)
+{
+    auto err = forward_compat::check(forward_compat_stage::WWC_READING_ATR, nlohmann::json::parse(R"({"WW_R":[{"e":"XX","b":"r"}]})"));
+    ASSERT_TRUE(err);
+    ASSERT_TRUE(err->should_retry());
+    ASSERT_FALSE(err->retry_delay());
+}
+
+TEST(ForwardCompat, RetryDelayIsReturnedRatherThanWaitedOut)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto err = forward_compat::check(forward_compat_stage::GETS, nlohmann::json::parse(R"({"G":[{"e":"XX","b":"r","ra":2000}]})"));
+    // the check may be made on an io thread, so it must leave the waiting to the caller
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    ASSERT_TRUE(err);
+    ASSERT_TRUE(err->should_retry());
+    ASSERT_EQ(std::chrono::milliseconds(2000), err->retry_delay());
+}
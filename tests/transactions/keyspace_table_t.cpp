@@ -0,0 +1,62 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <couchbase/transactions/internal/doc_record.hxx>
+#include <couchbase/transactions/internal/keyspace_table.hxx>
+
+#include <gtest/gtest.h>
+
+using namespace couchbase::transactions;
+
+TEST(KeyspaceTable, InternsOncePerKeyspace)
+{
+    auto& table = keyspace_table::instance();
+    auto a = table.intern("bucket", "scope", "collection");
+    auto size = table.size();
+    std::string bucket("bucket");
+    ASSERT_EQ(a, table.intern(bucket, "scope", "collection"));
+    ASSERT_EQ(a, table.intern(couchbase::core::document_id("bucket", "scope", "collection", "key")));
+    ASSERT_EQ(size, table.size());
+    ASSERT_EQ("bucket", a->bucket());
+    ASSERT_EQ("scope", a->scope());
+    ASSERT_EQ("collection", a->collection());
+}
+
+TEST(KeyspaceTable, DistinguishesKeyspaces)
+{
+    auto& table = keyspace_table::instance();
+    auto a = table.intern("bucket", "scope", "collection");
+    ASSERT_NE(a, table.intern("bucket", "scope", "other"));
+    ASSERT_NE(a, table.intern("bucket", "other", "collection"));
+    ASSERT_NE(a, table.intern("other", "scope", "collection"));
+    // the parts are compared separately, not concatenated
+    ASSERT_NE(table.intern("ab", "c", "d"), table.intern("a", "bc", "d"));
+}
+
+TEST(KeyspaceTable, DocRecordsShareKeyspace)
+{
+    nlohmann::json obj{ { ATR_FIELD_PER_DOC_BUCKET, "default" },
+                        { ATR_FIELD_PER_DOC_SCOPE, "_default" },
+                        { ATR_FIELD_PER_DOC_COLLECTION, "_default" },
+                        { ATR_FIELD_PER_DOC_ID, "doc" } };
+    auto first = doc_record::create_from(obj);
+    obj[ATR_FIELD_PER_DOC_ID] = "other doc";
+    auto second = doc_record::create_from(obj);
+    ASSERT_EQ(first.keyspace(), second.keyspace());
+    ASSERT_EQ("default", first.bucket_name());
+    ASSERT_EQ("doc", first.id());
+    ASSERT_EQ("other doc", second.document_id().key());
+}
@@ -0,0 +1,84 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/request_templates.hxx"
+
+#include <couchbase/internal/nlohmann/json.hpp>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace couchbase::transactions;
+
+static nlohmann::json
+expected_txn(const std::string& type)
+{
+    auto txn = nlohmann::json::object();
+    txn["id"]["txn"] = "txn-id";
+    txn["id"]["atmpt"] = "attempt-id";
+    txn["atr"]["id"] = "_txn:atr-42-#4a";
+    txn["atr"]["bkt"] = "default";
+    txn["atr"]["scp"] = "_default";
+    txn["atr"]["coll"] = "_default";
+    txn["op"]["type"] = type;
+    return txn;
+}
+
+static const couchbase::core::document_id atr_id("default", "_default", "_default", "_txn:atr-42-#4a");
+
+TEST(TxnXattrWriter, MatchesJsonDump)
+{
+    txn_xattr_writer writer("txn-id", "attempt-id", atr_id);
+    ASSERT_EQ(expected_txn("insert").dump(), writer.write("insert", std::nullopt));
+}
+
+TEST(TxnXattrWriter, WritesRestoreFields)
+{
+    txn_xattr_writer writer("txn-id", "attempt-id", atr_id);
+    document_metadata md(std::string("1234"), std::string("5"), 60, std::nullopt);
+    auto txn = expected_txn("replace");
+    txn["restore"]["CAS"] = "1234";
+    txn["restore"]["revid"] = "5";
+    txn["restore"]["exptime"] = 60;
+    ASSERT_EQ(txn.dump(), writer.write("replace", md));
+
+    document_metadata cas_only(std::string("1234"), std::nullopt, std::nullopt, std::nullopt);
+    auto txn_cas_only = expected_txn("remove");
+    txn_cas_only["restore"]["CAS"] = "1234";
+    ASSERT_EQ(txn_cas_only.dump(), writer.write("remove", cas_only));
+}
+
+TEST(TxnXattrWriter, EscapesStrings)
+{
+    std::vector<std::string> values{
+        "plain", "with \"quotes\"", "back\\slash", "new\nline\ttab", std::string("nul\0byte", 8), "caf\xc3\xa9",
+    };
+    for (const auto& value : values) {
+        std::string out;
+        append_json_string(out, value);
+        ASSERT_EQ(nlohmann::json(value).dump(), out);
+        ASSERT_EQ(value, nlohmann::json::parse(out).get<std::string>());
+    }
+}
+
+TEST(AtrEntryPaths, PrefixesFields)
+{
+    atr_entry_paths paths("attempt-id");
+    ASSERT_EQ("attempts.attempt-id", paths.entry);
+    ASSERT_EQ("attempts.attempt-id.st", paths.status);
+    ASSERT_EQ("attempts.attempt-id.ins", paths.docs_inserted);
+    ASSERT_EQ("attempts.attempt-id.p", paths.prevent_collision);
+}
@@ -0,0 +1,167 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/attempt_context_testing_hooks.hxx"
+#include "transactions_env.h"
+#include <couchbase/transactions.hxx>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+using namespace couchbase::transactions;
+
+static const nlohmann::json initial = nlohmann::json::parse(R"({"some number": 0})");
+static const nlohmann::json updated = nlohmann::json::parse(R"({"some number": 100})");
+
+static transaction_config
+rollback_test_config()
+{
+    transaction_config cfg;
+    cfg.cleanup_client_attempts(false);
+    cfg.cleanup_lost_attempts(false);
+    cfg.max_concurrent_unstaging(4);
+    return cfg;
+}
+
+static std::vector<couchbase::core::document_id>
+existing_docs(size_t n)
+{
+    std::vector<couchbase::core::document_id> ids;
+    for (size_t i = 0; i < n; i++) {
+        ids.push_back(TransactionsTestEnvironment::get_document_id());
+        EXPECT_TRUE(TransactionsTestEnvironment::upsert_doc(ids.back(), initial.dump()));
+    }
+    return ids;
+}
+
+// stages a replace of each doc, then fails so they are rolled back
+static void
+replace_then_fail(couchbase::transactions::transactions& txn, const std::vector<couchbase::core::document_id>& ids)
+{
+    txn.run([&](attempt_context& ctx) {
+        for (const auto& id : ids) {
+            ctx.replace(ctx.get(id), updated);
+        }
+        throw 3;
+    });
+}
+
+TEST(RollbackTransactions, RollsBackEveryDocumentWithinTheWindow)
+{
+    auto cfg = rollback_test_config();
+    std::atomic<int> in_flight{ 0 };
+    std::atomic<int> max_in_flight{ 0 };
+    cfg.attempt_context_hooks().before_doc_rolled_back = [&](attempt_context*, const std::string&) -> std::optional<error_class> {
+        auto now = ++in_flight;
+        auto max = max_in_flight.load();
+        while (now > max && !max_in_flight.compare_exchange_weak(max, now)) {
+        }
+        return {};
+    };
+    cfg.attempt_context_hooks().after_rollback_replace_or_remove = [&](attempt_context*, const std::string&) -> std::optional<error_class> {
+        --in_flight;
+        return {};
+    };
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    auto replaced = existing_docs(10);
+    auto removed = existing_docs(5);
+    std::vector<couchbase::core::document_id> inserted;
+    for (size_t i = 0; i < 5; i++) {
+        inserted.push_back(TransactionsTestEnvironment::get_document_id());
+    }
+    auto stage_then_fail = [&](attempt_context& ctx) {
+        for (const auto& id : replaced) {
+            ctx.replace(ctx.get(id), updated);
+        }
+        for (const auto& id : removed) {
+            ctx.remove(ctx.get(id));
+        }
+        for (const auto& id : inserted) {
+            ctx.insert(id, updated);
+        }
+        throw 3;
+    };
+    EXPECT_THROW(txn.run(stage_then_fail), transaction_exception);
+
+    // the undo writes overlap, but no more than the unstaging window allows
+    ASSERT_GT(max_in_flight.load(), 1);
+    ASSERT_LE(max_in_flight.load(), 4);
+    for (const auto& id : replaced) {
+        ASSERT_EQ(initial, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
+    }
+    for (const auto& id : removed) {
+        ASSERT_EQ(initial, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
+    }
+    for (const auto& id : inserted) {
+        ASSERT_THROW(TransactionsTestEnvironment::get_doc(id), client_error);
+    }
+}
+
+TEST(RollbackTransactions, FailedUndoDoesNotStopTheRest)
+{
+    auto cfg = rollback_test_config();
+    auto ids = existing_docs(8);
+    auto failing = ids[2].key();
+    std::atomic<int> attempted{ 0 };
+    std::atomic<int> rolled_back{ 0 };
+    cfg.attempt_context_hooks().before_doc_rolled_back = [&](attempt_context*, const std::string& key) -> std::optional<error_class> {
+        ++attempted;
+        if (key == failing) {
+            return FAIL_HARD;
+        }
+        return {};
+    };
+    cfg.attempt_context_hooks().after_rollback_replace_or_remove = [&](attempt_context*, const std::string&) -> std::optional<error_class> {
+        ++rolled_back;
+        return {};
+    };
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    EXPECT_THROW(replace_then_fail(txn, ids), transaction_exception);
+    // every document is tried once, and all but the failing one are rolled back
+    ASSERT_EQ(8, attempted.load());
+    ASSERT_EQ(7, rolled_back.load());
+}
+
+TEST(RollbackTransactions, TransientUndoErrorIsRetried)
+{
+    auto cfg = rollback_test_config();
+    auto ids = existing_docs(4);
+    auto flaky = ids[1].key();
+    std::atomic<int> flaky_tries{ 0 };
+    cfg.attempt_context_hooks().before_doc_rolled_back = [&](attempt_context*, const std::string& key) -> std::optional<error_class> {
+        if (key == flaky && flaky_tries++ < 2) {
+            return FAIL_TRANSIENT;
+        }
+        return {};
+    };
+    couchbase::transactions::transactions txn(TransactionsTestEnvironment::get_cluster(), cfg);
+
+    EXPECT_THROW(replace_then_fail(txn, ids), transaction_exception);
+    ASSERT_EQ(3, flaky_tries.load());
+    // rolled back, so a transaction can now replace them all
+    ASSERT_NO_THROW(txn.run([&](attempt_context& ctx) {
+        for (const auto& id : ids) {
+            ctx.replace(ctx.get(id), updated);
+        }
+    }));
+    for (const auto& id : ids) {
+        ASSERT_EQ(updated, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
+    }
+}
@@ -20,9 +20,12 @@
 #include "transactions_env.h"
 #include <couchbase/error_codes.hxx>
 #include <couchbase/transactions.hxx>
+#include <couchbase/transactions/async_operations.hxx>
 #include <gtest/gtest.h>
 #include <spdlog/spdlog.h>
 
+#include <asio/use_future.hpp>
+
 #include <future>
 #include <list>
 #include <stdexcept>
@@ -68,6 +71,99 @@ TEST(SimpleAsyncTxns, AsyncGet)
       });
     f.get();
 }
+TEST(SimpleAsyncTxns, CompletionTokenGetReplace)
+{
+    auto txns = TransactionsTestEnvironment::get_transactions();
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, async_content.dump()));
+    nlohmann::json new_content = { { "some", "thing else" } };
+    // the attempt is only committed once the replace has completed and we call done
+    auto f = async_run(
+      txns,
+      [id, new_content](async_attempt_context& ctx, async_attempt_context::VoidCallback&& done) {
+          async_get(ctx, id, [&ctx, new_content, done](std::exception_ptr err, transaction_get_result doc) {
+              if (err) {
+                  return done(err);
+              }
+              async_replace(ctx, doc, new_content, [done](std::exception_ptr err, transaction_get_result) { done(err); });
+          });
+      },
+      asio::use_future);
+    auto result = f.get();
+    ASSERT_TRUE(result.unstaging_complete);
+    auto doc = TransactionsTestEnvironment::get_doc(id);
+    ASSERT_EQ(doc.content_as<nlohmann::json>(), new_content);
+}
+
+TEST(SimpleAsyncTxns, RunAfterCloseFails)
+{
+    auto txns = TransactionsTestEnvironment::get_transactions();
+    txns.close();
+    auto barrier = std::make_shared<std::promise<void>>();
+    auto f = barrier->get_future();
+    txns.run([](async_attempt_context&) { FAIL() << "logic ran after close"; },
+             [barrier](std::optional<transaction_exception> err, std::optional<transaction_result> res) {
+                 txn_completed(std::move(err), res, barrier);
+             });
+    ASSERT_THROW(f.get(), transaction_exception);
+    ASSERT_THROW(txns.run([](attempt_context&) { FAIL() << "logic ran after close"; }), transaction_exception);
+}
+
+TEST(SimpleAsyncTxns, CloseFromCompletionCallback)
+{
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, async_content.dump()));
+    transaction_config cfg;
+    cfg.expiration_time(std::chrono::seconds(5));
+    auto txns = std::make_unique<transactions>(TransactionsTestEnvironment::get_cluster(), cfg);
+    auto barrier = std::make_shared<std::promise<void>>();
+    auto f = barrier->get_future();
+    txns->run([id](async_attempt_context& ctx) { ctx.get(id, [](std::exception_ptr, std::optional<transaction_get_result>) {}); },
+              [&txns, barrier](std::optional<transaction_exception> err, std::optional<transaction_result> res) {
+                  // runs on one of the transactions' own io threads, which mustn't try to join itself
+                  txns->close();
+                  txn_completed(std::move(err), res, barrier);
+              });
+    ASSERT_NO_THROW(f.get());
+    txns.reset();
+}
+
+TEST(SimpleAsyncTxns, DestroyFromCompletionCallback)
+{
+    auto id = TransactionsTestEnvironment::get_document_id();
+    ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(id, async_content.dump()));
+    transaction_config cfg;
+    cfg.expiration_time(std::chrono::seconds(5));
+    auto txns = std::make_unique<transactions>(TransactionsTestEnvironment::get_cluster(), cfg);
+    // hold both transactions back until both have been started, so the first to finish can't destroy txns under
+    // the second run() call
+    std::promise<void> go;
+    auto go_future = go.get_future().share();
+    std::atomic<int> completed{ 0 };
+    auto destroyed = std::make_shared<std::promise<void>>();
+    auto other_done = std::make_shared<std::promise<void>>();
+    for (int i = 0; i < 2; i++) {
+        txns->run(
+          [id, go_future](async_attempt_context& ctx) {
+              go_future.wait();
+              ctx.get(id, [](std::exception_ptr, std::optional<transaction_get_result>) {});
+          },
+          [&txns, &completed, destroyed, other_done](std::optional<transaction_exception> err, std::optional<transaction_result> res) {
+              if (++completed == 1) {
+                  // destroyed on one of its own io threads, while the other transaction may still be running
+                  txns.reset();
+                  txn_completed(std::move(err), res, destroyed);
+              } else {
+                  txn_completed(std::move(err), res, other_done);
+              }
+          });
+    }
+    go.set_value();
+    ASSERT_NO_THROW(destroyed->get_future().get());
+    ASSERT_NO_THROW(other_done->get_future().get());
+    ASSERT_FALSE(txns);
+}
+
 TEST(SimpleAsyncTxns, CantGetFromUnknownBucket)
 {
     auto txns = TransactionsTestEnvironment::get_transactions();
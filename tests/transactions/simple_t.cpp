@@ -18,6 +18,7 @@
 #include "transactions_env.h"
 #include <couchbase/error_codes.hxx>
 #include <couchbase/transactions.hxx>
+#include <couchbase/transactions/internal/transactions_cleanup.hxx>
 #include <gtest/gtest.h>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
@@ -100,6 +101,75 @@ TEST(SimpleTransactions, CanGetReplace)
     ASSERT_EQ(c, TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>());
 }
 
+TEST(SimpleTransactions, CanGetMulti)
+{
+    auto& cluster = TransactionsTestEnvironment::get_cluster();
+    transaction_config cfg;
+    cfg.cleanup_client_attempts(false);
+    cfg.cleanup_lost_attempts(false);
+    couchbase::transactions::transactions txn(cluster, cfg);
+
+    std::vector<couchbase::core::document_id> ids;
+    for (int i = 0; i < 5; i++) {
+        ids.push_back(TransactionsTestEnvironment::get_document_id());
+        ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(ids.back(), nlohmann::json{ { "number", i } }.dump()));
+    }
+    auto missing = TransactionsTestEnvironment::get_document_id();
+    txn.run([&](attempt_context& ctx) {
+        auto docs = ctx.get_multi(ids);
+        ASSERT_EQ(ids.size(), docs.size());
+        for (size_t i = 0; i < docs.size(); i++) {
+            ASSERT_EQ(ids[i].key(), docs[i].id().key());
+            ASSERT_EQ(i, docs[i].content<nlohmann::json>()["number"].get<size_t>());
+        }
+        auto maybe_docs = ctx.get_optional_multi({ ids[0], missing, ids[1] });
+        ASSERT_EQ(3, maybe_docs.size());
+        ASSERT_TRUE(maybe_docs[0]);
+        ASSERT_FALSE(maybe_docs[1]);
+        ASSERT_TRUE(maybe_docs[2]);
+    });
+}
+
+TEST(SimpleTransactions, CanStageBatch)
+{
+    auto& cluster = TransactionsTestEnvironment::get_cluster();
+    transaction_config cfg;
+    cfg.cleanup_client_attempts(false);
+    cfg.cleanup_lost_attempts(false);
+    couchbase::transactions::transactions txn(cluster, cfg);
+
+    std::vector<couchbase::core::document_id> existing;
+    for (int i = 0; i < 4; i++) {
+        existing.push_back(TransactionsTestEnvironment::get_document_id());
+        ASSERT_TRUE(TransactionsTestEnvironment::upsert_doc(existing.back(), nlohmann::json{ { "number", i } }.dump()));
+    }
+    std::vector<couchbase::core::document_id> inserted;
+    for (int i = 0; i < 3; i++) {
+        inserted.push_back(TransactionsTestEnvironment::get_document_id());
+    }
+    txn.run([&](attempt_context& ctx) {
+        auto docs = ctx.get_multi(existing);
+        staged_write_batch batch;
+        for (const auto& id : inserted) {
+            batch.insert(id, nlohmann::json{ { "inserted", true } });
+        }
+        batch.replace(docs[0], nlohmann::json{ { "number", 10 } }).replace(docs[1], nlohmann::json{ { "number", 11 } });
+        batch.remove(docs[2]).remove(docs[3]);
+        auto results = ctx.stage_batch(batch);
+        ASSERT_EQ(batch.size(), results.size());
+        for (const auto& res : results) {
+            ASSERT_TRUE(res.success());
+        }
+        ASSERT_TRUE(results[0].document);
+        ASSERT_FALSE(results.back().document);
+    });
+    for (const auto& id : inserted) {
+        ASSERT_TRUE(TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>()["inserted"].get<bool>());
+    }
+    ASSERT_EQ(10, TransactionsTestEnvironment::get_doc(existing[0]).content_as<nlohmann::json>()["number"].get<int>());
+    ASSERT_EQ(11, TransactionsTestEnvironment::get_doc(existing[1]).content_as<nlohmann::json>()["number"].get<int>());
+}
+
 TEST(SimpleTransactions, CanUseCustomMetadataCollectionsPerTransaction)
 {
     nlohmann::json c = nlohmann::json::parse("{\"some number\": 0}");
@@ -482,6 +552,38 @@ TEST(SimpleTransactions, CanRollbackReplace)
     ASSERT_EQ(TransactionsTestEnvironment::get_doc(id).content_as<nlohmann::json>(), c);
 }
 
+TEST(SimpleTransactions, CleanupSkipsAtrWithCorruptEntry)
+{
+    auto& cluster = TransactionsTestEnvironment::get_cluster();
+    transaction_config cfg;
+    cfg.cleanup_client_attempts(false);
+    cfg.cleanup_lost_attempts(false);
+    couchbase::transactions::transactions txn(cluster, cfg);
+
+    // an ATR whose attempts index fine, but one of them has no status, so decoding it throws
+    auto atr_id = TransactionsTestEnvironment::get_document_id();
+    couchbase::core::operations::mutate_in_request req{ atr_id };
+    req.store_semantics = couchbase::store_semantics::upsert;
+    std::string attempts = R"({"good":{"st":"PENDING"},"bad":{"exp":1}})";
+    req.specs =
+      couchbase::mutate_in_specs{
+          couchbase::mutate_in_specs::upsert_raw("attempts", couchbase::core::utils::to_binary(attempts)).xattr().create_path(),
+          couchbase::mutate_in_specs::replace({}, std::string({ 0x00 })),
+      }
+        .specs();
+    auto barrier = std::make_shared<std::promise<std::error_code>>();
+    auto f = barrier->get_future();
+    cluster.execute(req, [barrier](couchbase::core::operations::mutate_in_response resp) { barrier->set_value(resp.ctx.ec()); });
+    ASSERT_FALSE(f.get());
+
+    std::vector<transactions_cleanup_attempt> results;
+    atr_cleanup_stats stats;
+    ASSERT_NO_THROW(stats = txn.cleanup().force_cleanup_atr(atr_id, results));
+    ASSERT_TRUE(stats.exists);
+    ASSERT_EQ(0, stats.num_entries);
+    ASSERT_TRUE(results.empty());
+}
+
 TEST(SimpleQueryTransactions, CanHaveTrivialQueryInTxn)
 {
     auto& cluster = TransactionsTestEnvironment::get_cluster();
@@ -0,0 +1,127 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/attempt_arena.hxx"
+#include "../../src/transactions/staged_mutation.hxx"
+
+#include <gtest/gtest.h>
+
+using namespace couchbase::transactions;
+
+TEST(UnstagingWindow, StartsAtMax)
+{
+    unstaging_window window(16);
+    ASSERT_EQ(window.size(), 16);
+}
+
+TEST(UnstagingWindow, NeverZero)
+{
+    unstaging_window window(0);
+    ASSERT_EQ(window.size(), 1);
+    window.transient_error();
+    ASSERT_EQ(window.size(), 1);
+}
+
+TEST(UnstagingWindow, HalvesOnTransientError)
+{
+    unstaging_window window(16);
+    window.transient_error();
+    ASSERT_EQ(window.size(), 8);
+    window.transient_error();
+    window.transient_error();
+    window.transient_error();
+    window.transient_error();
+    ASSERT_EQ(window.size(), 1);
+}
+
+TEST(UnstagingWindow, GrowsBackToMax)
+{
+    unstaging_window window(4);
+    window.transient_error();
+    ASSERT_EQ(window.size(), 2);
+    window.success();
+    ASSERT_EQ(window.size(), 3);
+    window.success();
+    window.success();
+    window.success();
+    ASSERT_EQ(window.size(), 4);
+}
+
+static staged_mutation
+make_mutation(const std::string& key, staged_mutation_type type)
+{
+    transaction_get_result doc(couchbase::core::document_id("default", "_default", "_default", key), nlohmann::json::object());
+    return staged_mutation(doc, std::string("{}"), type);
+}
+
+TEST(StagedMutationQueue, FindsByIdAndType)
+{
+    staged_mutation_queue queue;
+    for (int i = 0; i < 100; i++) {
+        queue.add(make_mutation(std::to_string(i), i % 2 ? staged_mutation_type::REPLACE : staged_mutation_type::INSERT));
+    }
+    couchbase::core::document_id even("default", "_default", "_default", "42");
+    couchbase::core::document_id odd("default", "_default", "_default", "43");
+    couchbase::core::document_id other_collection("default", "_default", "other", "42");
+    ASSERT_NE(nullptr, queue.find_any(even));
+    ASSERT_NE(nullptr, queue.find_insert(even));
+    ASSERT_EQ(nullptr, queue.find_replace(even));
+    ASSERT_NE(nullptr, queue.find_replace(odd));
+    ASSERT_EQ(nullptr, queue.find_remove(odd));
+    ASSERT_EQ(nullptr, queue.find_any(other_collection));
+}
+
+TEST(StagedMutationQueue, KeepsStagingOrder)
+{
+    staged_mutation_queue queue;
+    for (const auto* key : { "a", "b", "c", "d" }) {
+        queue.add(make_mutation(key, staged_mutation_type::INSERT));
+    }
+    // staging a document again moves it to the end, removing one closes the gap
+    queue.add(make_mutation("b", staged_mutation_type::REMOVE));
+    queue.remove_any(couchbase::core::document_id("default", "_default", "_default", "a"));
+    std::vector<std::string> keys;
+    queue.iterate([&keys](staged_mutation& item) { keys.push_back(item.id().key()); });
+    ASSERT_EQ((std::vector<std::string>{ "c", "d", "b" }), keys);
+    ASSERT_NE(nullptr, queue.find_remove(couchbase::core::document_id("default", "_default", "_default", "b")));
+    ASSERT_NE(nullptr, queue.find_insert(couchbase::core::document_id("default", "_default", "_default", "d")));
+    ASSERT_EQ(nullptr, queue.find_any(couchbase::core::document_id("default", "_default", "_default", "a")));
+}
+
+TEST(StagedMutation, SharesContentBuffers)
+{
+    auto body = std::make_shared<const std::string>(std::string(200 * 1024, 'x'));
+    transaction_get_result doc(couchbase::core::document_id("default", "_default", "_default", "big"), body, 0, {}, std::nullopt);
+    staged_mutation mutation(doc, body, staged_mutation_type::REPLACE);
+    auto copy = doc;
+    auto own_write = transaction_get_result::create_from(mutation.doc(), mutation.content_buffer());
+    ASSERT_EQ(body.get(), copy.content_buffer().get());
+    ASSERT_EQ(body.get(), mutation.doc().content_buffer().get());
+    ASSERT_EQ(body.get(), own_write.content_buffer().get());
+    ASSERT_EQ(*body, own_write.content<std::string>());
+}
+
+TEST(StagedMutationQueue, WorksInArena)
+{
+    attempt_arena arena;
+    staged_mutation_queue queue(&arena);
+    for (int i = 0; i < 1000; i++) {
+        queue.add(make_mutation(std::to_string(i), staged_mutation_type::INSERT));
+    }
+    queue.remove_any(couchbase::core::document_id("default", "_default", "_default", "500"));
+    ASSERT_EQ(nullptr, queue.find_any(couchbase::core::document_id("default", "_default", "_default", "500")));
+    ASSERT_NE(nullptr, queue.find_insert(couchbase::core::document_id("default", "_default", "_default", "999")));
+}
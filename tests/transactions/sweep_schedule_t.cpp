@@ -0,0 +1,116 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/sweep_schedule.hxx"
+
+#include <gtest/gtest.h>
+
+using namespace couchbase::transactions;
+using namespace std::chrono_literals;
+
+TEST(SweepSchedule, NewBucketIsDueStraightAway)
+{
+    auto start = sweep_schedule::clock::now();
+    sweep_schedule sweeps(1000ms);
+    ASSERT_FALSE(sweeps.next_due());
+    ASSERT_TRUE(sweeps.add("a", start));
+    ASSERT_FALSE(sweeps.add("a", start + 1ms));
+    ASSERT_EQ(1, sweeps.size());
+    ASSERT_EQ(start, sweeps.next_due());
+    ASSERT_EQ("a", sweeps.take(start));
+    // still known while it is being swept, but not due
+    ASSERT_FALSE(sweeps.take(start + 1h));
+    ASSERT_FALSE(sweeps.next_due());
+    ASSERT_FALSE(sweeps.add("a", start + 1ms));
+}
+
+TEST(SweepSchedule, DueAgainAWindowAfterTheSweepStarted)
+{
+    auto start = sweep_schedule::clock::now();
+    sweep_schedule sweeps(1000ms);
+    sweeps.add("a", start);
+    ASSERT_EQ("a", sweeps.take(start));
+    sweeps.done("a", start, start + 100ms);
+    ASSERT_EQ(start + 1000ms, sweeps.next_due());
+    ASSERT_FALSE(sweeps.take(start + 999ms));
+    ASSERT_EQ("a", sweeps.take(start + 1000ms));
+}
+
+TEST(SweepSchedule, OverrunSweepIsDueStraightAway)
+{
+    auto start = sweep_schedule::clock::now();
+    sweep_schedule sweeps(1000ms);
+    sweeps.add("a", start);
+    ASSERT_EQ("a", sweeps.take(start));
+    sweeps.done("a", start, start + 1500ms);
+    ASSERT_EQ(start + 1500ms, sweeps.next_due());
+    ASSERT_EQ("a", sweeps.take(start + 1500ms));
+}
+
+TEST(SweepSchedule, EachBucketKeepsItsOwnCadence)
+{
+    auto start = sweep_schedule::clock::now();
+    sweep_schedule sweeps(1000ms);
+    sweeps.add("slow", start);
+    sweeps.add("fast", start + 10ms);
+    ASSERT_EQ("slow", sweeps.take(start + 10ms));
+    ASSERT_EQ("fast", sweeps.take(start + 10ms));
+    sweeps.done("fast", start + 10ms, start + 20ms);
+    // fast comes round again while slow is still being swept
+    ASSERT_EQ("fast", sweeps.take(start + 1010ms));
+    sweeps.done("fast", start + 1010ms, start + 1020ms);
+    sweeps.done("slow", start + 10ms, start + 1500ms);
+    ASSERT_EQ(start + 1500ms, sweeps.next_due());
+    ASSERT_EQ("slow", sweeps.take(start + 1500ms));
+    ASSERT_EQ(start + 2010ms, sweeps.next_due());
+}
+
+TEST(SweepSchedule, PacerSpreadsReadsOverTheWindow)
+{
+    auto start = sweep_schedule::clock::now();
+    auto pacer = sweep_schedule::pacer(1024, 60000ms, 16, start);
+    size_t acquired = 0;
+    size_t by_half_window = 0;
+    auto finished = start;
+    for (auto now = start; now < start + 120s && acquired < 1024; now += 1ms) {
+        while (acquired < 1024 && pacer.try_acquire(now).count() == 0) {
+            acquired++;
+            finished = now;
+        }
+        // never ahead of the rate by more than the burst
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+        ASSERT_LE(acquired, static_cast<size_t>(1024 * elapsed / 60000) + 16);
+        if (now - start < 30s) {
+            by_half_window = acquired;
+        }
+    }
+    ASSERT_EQ(1024, acquired);
+    ASSERT_LE(finished - start, 60s);
+    ASSERT_NEAR(512, by_half_window, 16);
+}
+
+TEST(SweepSchedule, PacerAllowsABurstOfReadsInFlight)
+{
+    auto start = sweep_schedule::clock::now();
+    auto pacer = sweep_schedule::pacer(1024, 60000ms, 16, start);
+    // a slow read holds up the rest, which can then catch up with up to the burst at once
+    auto later = start + 10s;
+    size_t caught_up = 0;
+    while (pacer.try_acquire(later).count() == 0) {
+        caught_up++;
+    }
+    ASSERT_EQ(16, caught_up);
+}
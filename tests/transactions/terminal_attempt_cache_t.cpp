@@ -0,0 +1,71 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/terminal_attempt_cache.hxx"
+
+#include <gtest/gtest.h>
+
+using namespace couchbase::transactions;
+
+static atr_entry
+make_entry(const std::string& attempt_id, attempt_state state, std::optional<nlohmann::json> forward_compat = std::nullopt)
+{
+    return { "default", "_txn:atr-1-#1", attempt_id, state, {}, {}, {}, {}, {}, 15000, {}, {}, {}, std::move(forward_compat), 0, {} };
+}
+
+TEST(TerminalAttemptCache, RemembersOnlyTerminalStates)
+{
+    terminal_attempt_cache cache;
+    cache.add(make_entry("completed", attempt_state::COMPLETED));
+    cache.add(make_entry("rolled-back", attempt_state::ROLLED_BACK));
+    cache.add(make_entry("committed", attempt_state::COMMITTED));
+    cache.add(make_entry("pending", attempt_state::PENDING));
+    cache.add(make_entry("forward-compat", attempt_state::COMPLETED, nlohmann::json::object()));
+    ASSERT_EQ(attempt_state::COMPLETED, cache.find("completed"));
+    ASSERT_EQ(attempt_state::ROLLED_BACK, cache.find("rolled-back"));
+    ASSERT_FALSE(cache.find("committed"));
+    ASSERT_FALSE(cache.find("pending"));
+    ASSERT_FALSE(cache.find("forward-compat"));
+    auto stats = cache.stats();
+    ASSERT_EQ(2, stats.entries);
+    ASSERT_EQ(5, stats.lookups);
+    ASSERT_EQ(2, stats.hits);
+    ASSERT_DOUBLE_EQ(0.4, stats.hit_rate());
+    ASSERT_GT(stats.memory_bytes, 0);
+}
+
+TEST(TerminalAttemptCache, StaysBounded)
+{
+    terminal_attempt_cache cache(1024);
+    for (int i = 0; i < 100000; i++) {
+        cache.add(make_entry("attempt-" + std::to_string(i), attempt_state::COMPLETED));
+    }
+    ASSERT_LE(cache.stats().entries, 1024);
+    ASSERT_TRUE(cache.find("attempt-99999"));
+    ASSERT_FALSE(cache.find("attempt-0"));
+}
+
+TEST(TerminalAttemptCache, KeepsAttemptsStillInUse)
+{
+    terminal_attempt_cache cache(1024);
+    cache.add(make_entry("hot", attempt_state::COMPLETED));
+    for (int i = 0; i < 100000; i++) {
+        cache.add(make_entry("attempt-" + std::to_string(i), attempt_state::COMPLETED));
+        if (i % 16 == 0) {
+            ASSERT_TRUE(cache.find("hot"));
+        }
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/token_bucket.hxx"
+
+#include <gtest/gtest.h>
+
+using namespace couchbase::transactions;
+using namespace std::chrono_literals;
+
+TEST(TokenBucket, StartsWithOneToken)
+{
+    auto start = token_bucket::clock::now();
+    token_bucket bucket(10, 4, start);
+    ASSERT_EQ(0us, bucket.try_acquire(start));
+    // 10 per second is one every 100ms
+    ASSERT_EQ(100000us, bucket.try_acquire(start));
+    ASSERT_EQ(0us, bucket.try_acquire(start + 100ms));
+}
+
+TEST(TokenBucket, PacesToRate)
+{
+    auto start = token_bucket::clock::now();
+    token_bucket bucket(1000, 1, start);
+    size_t acquired = 0;
+    for (auto now = start; now < start + 1s; now += 100us) {
+        if (bucket.try_acquire(now).count() == 0) {
+            acquired++;
+        }
+    }
+    ASSERT_NEAR(1000, acquired, 1);
+}
+
+TEST(TokenBucket, BurstIsBounded)
+{
+    auto start = token_bucket::clock::now();
+    token_bucket bucket(10, 4, start);
+    auto later = start + 1h;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(0us, bucket.try_acquire(later));
+    }
+    ASSERT_GT(bucket.try_acquire(later).count(), 0);
+}
@@ -223,6 +223,65 @@ TEST(RetryableOp, CanHaveConstantDelay)
     }
 }
 
+TEST(ExpBackoff, WillStopAtMax)
+{
+    exp_backoff policy(one_ms, 3);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(next_delay(policy));
+    }
+    ASSERT_FALSE(next_delay(policy));
+}
+
+TEST(DecorrelatedJitterBackoff, DelaysWithinBounds)
+{
+    decorrelated_jitter_backoff policy(one_ms, ten_ms, hundred_ms);
+    // first call just starts the clock
+    ASSERT_EQ(0, policy.next().count());
+    for (int i = 0; i < 20; i++) {
+        auto delay = policy.next();
+        ASSERT_GE(delay, std::chrono::nanoseconds(0));
+        ASSERT_LE(delay, ten_ms);
+    }
+}
+
+TEST(AsyncRetry, RetriesOnTimerUntilSuccess)
+{
+    asio::io_context io;
+    size_t calls = 0;
+    std::exception_ptr result = std::make_exception_ptr(std::runtime_error("not called"));
+    async_retry(
+      io,
+      std::make_shared<exp_backoff>(one_ms, 10),
+      [&calls](async_retry_handler handler) {
+          if (++calls < 3) {
+              return handler(std::make_exception_ptr(retry_operation("again")));
+          }
+          handler({});
+      },
+      [&result](std::exception_ptr err) { result = err; });
+    io.run();
+    ASSERT_EQ(3, calls);
+    ASSERT_FALSE(result);
+}
+
+TEST(AsyncRetry, ReportsRetriesExhausted)
+{
+    asio::io_context io;
+    size_t calls = 0;
+    std::exception_ptr result;
+    async_retry(
+      io,
+      std::make_shared<exp_backoff>(one_ms, 2),
+      [&calls](async_retry_handler handler) {
+          calls++;
+          handler(std::make_exception_ptr(retry_operation("again")));
+      },
+      [&result](std::exception_ptr err) { result = err; });
+    io.run();
+    ASSERT_EQ(3, calls);
+    ASSERT_THROW(std::rethrow_exception(result), retry_operation_retries_exhausted);
+}
+
 TEST(GetBuckets, CanGetBuckets)
 {
     auto& c = TransactionsTestEnvironment::get_cluster();
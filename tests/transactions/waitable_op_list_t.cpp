@@ -131,3 +131,27 @@ TEST(WaitableOpList, GetModeWaits)
     ASSERT_EQ(mode.query_node, NODE);
     ASSERT_EQ(mode.mode, couchbase::transactions::attempt_mode::modes::QUERY);
 }
+
+TEST(WaitableOpList, AsyncWaitCallsHandlerImmediatelyWhenNoOps)
+{
+    couchbase::transactions::waitable_op_list op_list;
+    bool handler_called{ false };
+    op_list.wait_and_block_ops([&handler_called]() { handler_called = true; });
+    ASSERT_TRUE(handler_called);
+    ASSERT_THROW(op_list.increment_ops(), couchbase::transactions::async_operation_conflict);
+}
+
+TEST(WaitableOpList, AsyncWaitCallsHandlerWhenOpsDone)
+{
+    couchbase::transactions::waitable_op_list op_list;
+    std::atomic<bool> handler_called{ false };
+    op_list.increment_ops();
+    op_list.increment_ops();
+    op_list.wait_and_block_ops([&handler_called]() { handler_called = true; });
+    ASSERT_FALSE(handler_called.load());
+    op_list.decrement_ops();
+    ASSERT_FALSE(handler_called.load());
+    op_list.decrement_ops();
+    ASSERT_TRUE(handler_called.load());
+    ASSERT_THROW(op_list.increment_ops(), couchbase::transactions::async_operation_conflict);
+}
@@ -0,0 +1,78 @@
+/*
+ *     Copyright 2021 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "../../src/transactions/xattr_decoder.hxx"
+
+#include <couchbase/internal/nlohmann/json.hpp>
+#include <gtest/gtest.h>
+
+using namespace couchbase::transactions;
+
+// as returned by the server for the $document virtual xattr
+static const std::string document_vattr_json =
+  R"({"CAS":"0x16a1ba5e7bd20000","vbucket_uuid":"0x0000d1b6ec88d9b4","seqno":"0x0000000000000040","revid":"7","exptime":0,)"
+  R"("value_bytes":17,"value_crc32c":"0x4b4c4e5c","flags":0,"deleted":false,"datatype":["json","xattr"],)"
+  R"("last_modified":"1653578113"})";
+
+TEST(XattrDecoder, DecodesStrings)
+{
+    ASSERT_EQ("_txn:atr-42-#4a", decode_json_string(R"("_txn:atr-42-#4a")"));
+    ASSERT_EQ("", decode_json_string(R"("")"));
+    // escapes take the slow path, and come out the same as nlohmann would give
+    ASSERT_EQ("a\"b\\cé", decode_json_string(R"("a\"b\\cé")"));
+    ASSERT_EQ("padded", decode_json_string(R"(  "padded" )"));
+    ASSERT_THROW(decode_json_string("42"), nlohmann::json::exception);
+    ASSERT_THROW(decode_json_string(R"("unterminated)"), nlohmann::json::exception);
+}
+
+TEST(XattrDecoder, DecodesNumbers)
+{
+    ASSERT_EQ(0, decode_json_uint32("0"));
+    ASSERT_EQ(4294967295u, decode_json_uint32("4294967295"));
+    ASSERT_EQ(nlohmann::json::parse("4294967296").get<uint32_t>(), decode_json_uint32("4294967296"));
+}
+
+TEST(XattrDecoder, DecodesDocumentVattr)
+{
+    auto doc = decode_document_vattr(document_vattr_json);
+    ASSERT_EQ("0x16a1ba5e7bd20000", doc.cas);
+    ASSERT_EQ("7", doc.revid);
+    ASSERT_EQ(0, doc.exptime);
+    ASSERT_EQ("0x4b4c4e5c", doc.value_crc32c);
+}
+
+TEST(XattrDecoder, DecodesRestore)
+{
+    auto restore = decode_restore(R"({"CAS":"1234","exptime":60,"revid":"5"})");
+    ASSERT_EQ("1234", restore.cas);
+    ASSERT_EQ("5", restore.revid);
+    ASSERT_EQ(60, restore.exptime);
+
+    // not the form we write, but still JSON
+    auto spaced = decode_restore(R"( { "revid" : "5" , "CAS" : "1234", "exptime" : 60, "extra": {"a": [1, "}"]} } )");
+    ASSERT_EQ("1234", spaced.cas);
+    ASSERT_EQ("5", spaced.revid);
+    ASSERT_EQ(60, spaced.exptime);
+}
+
+TEST(XattrDecoder, MissingFieldsFailAsBefore)
+{
+    // missing or mistyped fields throw the same as reading them from a parsed object did
+    ASSERT_THROW(decode_restore(R"({"CAS":"1234","exptime":60})"), nlohmann::json::exception);
+    ASSERT_THROW(decode_restore(R"({"CAS":1234,"revid":"5","exptime":60})"), nlohmann::json::exception);
+    ASSERT_THROW(decode_document_vattr(R"({"CAS":"1234"})"), nlohmann::json::exception);
+    ASSERT_THROW(decode_document_vattr("not json"), nlohmann::json::exception);
+}